@@ -1,53 +1,87 @@
+-- 实时数据表、小时和天聚合表按时间 RANGE 分区（实时表按天，聚合表按月），
+-- 服务启动和每次维护时从 pmax 切出未来的分区，保留期清理直接删除过期分区
+
 -- 实时数据表（保存最近24小时的原始数据）
 CREATE TABLE IF NOT EXISTS sensor_data_realtime (
-    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+    id BIGINT AUTO_INCREMENT,
     device_id VARCHAR(50) NOT NULL,
     timestamp TIMESTAMP NOT NULL,
-    temperature FLOAT NOT NULL,
-    humidity FLOAT NOT NULL,
-    co2 FLOAT NOT NULL,
-    pm25 FLOAT NOT NULL,
-    noise FLOAT NOT NULL,
-    light FLOAT NOT NULL,
+    temperature DOUBLE NOT NULL,
+    humidity DOUBLE NOT NULL,
+    co2 DOUBLE NOT NULL,
+    pm25 DOUBLE NOT NULL,
+    noise DOUBLE NOT NULL,
+    light DOUBLE NOT NULL,
     area VARCHAR(50) NOT NULL,
-    area_type TINYINT NOT NULL,
-    INDEX idx_device_time (device_id, timestamp)
+    area_type INT NOT NULL,
+    INDEX idx_device_time (device_id, timestamp),
+    INDEX idx_time (timestamp),
+    PRIMARY KEY (id, timestamp)
+) PARTITION BY RANGE (UNIX_TIMESTAMP(timestamp)) (
+    PARTITION pmax VALUES LESS THAN MAXVALUE
 );
 
--- 小时聚合表（保存最近30天的小时平均值）
+-- 小时聚合表（保存最近30天的小时平均值和各通道的 DDSketch 分位数草图）
 CREATE TABLE IF NOT EXISTS sensor_data_hourly (
-    id BIGINT AUTO_INCREMENT PRIMARY KEY,
+    id BIGINT AUTO_INCREMENT,
     device_id VARCHAR(50) NOT NULL,
     hour_timestamp TIMESTAMP NOT NULL,
-    avg_temperature FLOAT NOT NULL,
-    avg_humidity FLOAT NOT NULL,
-    avg_co2 FLOAT NOT NULL,
-    avg_pm25 FLOAT NOT NULL,
-    avg_noise FLOAT NOT NULL,
-    avg_light FLOAT NOT NULL,
-    max_temperature FLOAT NOT NULL,
-    min_temperature FLOAT NOT NULL,
+    avg_temperature DOUBLE NOT NULL,
+    avg_humidity DOUBLE NOT NULL,
+    avg_co2 DOUBLE NOT NULL,
+    avg_pm25 DOUBLE NOT NULL,
+    avg_noise DOUBLE NOT NULL,
+    avg_light DOUBLE NOT NULL,
+    max_temperature DOUBLE NOT NULL,
+    min_temperature DOUBLE NOT NULL,
     samples_count INT NOT NULL,
     area VARCHAR(50) NOT NULL,
-    area_type TINYINT NOT NULL,
-    INDEX idx_device_hour (device_id, hour_timestamp)
+    area_type INT NOT NULL,
+    sketches MEDIUMBLOB NULL,
+    UNIQUE KEY uk_device_hour (device_id, hour_timestamp),
+    PRIMARY KEY (id, hour_timestamp)
+) PARTITION BY RANGE (UNIX_TIMESTAMP(hour_timestamp)) (
+    PARTITION pmax VALUES LESS THAN MAXVALUE
 );
 
 -- 天聚合表（保存历史数据的天平均值）
 CREATE TABLE IF NOT EXISTS sensor_data_daily (
+    id BIGINT AUTO_INCREMENT,
+    device_id VARCHAR(50) NOT NULL,
+    date_timestamp TIMESTAMP NOT NULL,
+    avg_temperature DOUBLE NOT NULL,
+    avg_humidity DOUBLE NOT NULL,
+    avg_co2 DOUBLE NOT NULL,
+    avg_pm25 DOUBLE NOT NULL,
+    avg_noise DOUBLE NOT NULL,
+    avg_light DOUBLE NOT NULL,
+    max_temperature DOUBLE NOT NULL,
+    min_temperature DOUBLE NOT NULL,
+    samples_count INT NOT NULL,
+    area VARCHAR(50) NOT NULL,
+    area_type INT NOT NULL,
+    sketches MEDIUMBLOB NULL,
+    UNIQUE KEY uk_device_date (device_id, date_timestamp),
+    PRIMARY KEY (id, date_timestamp)
+) PARTITION BY RANGE (UNIX_TIMESTAMP(date_timestamp)) (
+    PARTITION pmax VALUES LESS THAN MAXVALUE
+);
+
+-- 原始数据压缩块表（每个设备每小时一块，时间戳 delta-of-delta 编码，数值 XOR 压缩）
+CREATE TABLE IF NOT EXISTS sensor_data_blocks (
     id BIGINT AUTO_INCREMENT PRIMARY KEY,
     device_id VARCHAR(50) NOT NULL,
-    date_timestamp DATE NOT NULL,
-    avg_temperature FLOAT NOT NULL,
-    avg_humidity FLOAT NOT NULL,
-    avg_co2 FLOAT NOT NULL,
-    avg_pm25 FLOAT NOT NULL,
-    avg_noise FLOAT NOT NULL,
-    avg_light FLOAT NOT NULL,
-    max_temperature FLOAT NOT NULL,
-    min_temperature FLOAT NOT NULL,
+    start_timestamp BIGINT NOT NULL,
+    end_timestamp BIGINT NOT NULL,
     samples_count INT NOT NULL,
     area VARCHAR(50) NOT NULL,
-    area_type TINYINT NOT NULL,
-    INDEX idx_device_date (device_id, date_timestamp)
-); 
\ No newline at end of file
+    area_type INT NOT NULL,
+    payload MEDIUMBLOB NOT NULL,
+    UNIQUE KEY uk_device_block (device_id, start_timestamp)
+);
+
+-- 维护任务水位表：记录每个任务已完成到的窗口终点，重启后从这里补做
+CREATE TABLE IF NOT EXISTS maintenance_watermarks (
+    task VARCHAR(50) PRIMARY KEY,
+    watermark BIGINT NOT NULL
+);
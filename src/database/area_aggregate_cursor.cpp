@@ -0,0 +1,102 @@
+#include "area_aggregate_cursor.h"
+#include <algorithm>
+
+AreaAggregateCursor::AreaAggregateCursor(std::unique_ptr<RowCursor> source, std::string label,
+                                         time_t bucket_seconds, Mode mode)
+    : source_(std::move(source))
+    , label_(std::move(label))
+    , bucket_seconds_(std::max<time_t>(bucket_seconds, 1))
+    , mode_(mode) {
+}
+
+bool AreaAggregateCursor::parseMode(const std::string& name, Mode& mode) {
+    if (name == "mean") {
+        mode = Mode::MEAN;
+    } else if (name == "min") {
+        mode = Mode::MIN;
+    } else if (name == "max") {
+        mode = Mode::MAX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool AreaAggregateCursor::next(SensorData& row) {
+    SensorData input;
+    while (!source_done_) {
+        if (!source_->next(input)) {
+            source_done_ = true;
+            break;
+        }
+
+        time_t bucket = input.timestamp - input.timestamp % bucket_seconds_;
+        bool emitted = false;
+        if (!devices_.empty() && bucket != bucket_start_) {
+            flush(row);
+            emitted = true;
+        }
+        if (devices_.empty()) {
+            bucket_start_ = bucket;
+        }
+
+        auto& acc = devices_[input.device_id];
+        const double values[6] = {input.temperature, input.humidity, input.co2,
+                                  input.pm25, input.noise, input.light};
+        for (int i = 0; i < 6; ++i) {
+            acc.sums[i] += values[i];
+        }
+        ++acc.count;
+        area_ = input.area;
+        area_type_ = input.area_type;
+
+        if (emitted) {
+            return true;
+        }
+    }
+    if (devices_.empty()) {
+        return false;
+    }
+    flush(row);
+    return true;
+}
+
+void AreaAggregateCursor::flush(SensorData& row) {
+    double result[6];
+    bool first = true;
+    for (const auto& [_, acc] : devices_) {
+        for (int i = 0; i < 6; ++i) {
+            double mean = acc.sums[i] / acc.count;
+            if (first) {
+                result[i] = mean;
+            } else if (mode_ == Mode::MEAN) {
+                result[i] += mean;
+            } else if (mode_ == Mode::MIN) {
+                result[i] = std::min(result[i], mean);
+            } else {
+                result[i] = std::max(result[i], mean);
+            }
+        }
+        first = false;
+    }
+    if (mode_ == Mode::MEAN) {
+        for (double& value : result) {
+            value /= static_cast<double>(devices_.size());
+        }
+    }
+
+    row = SensorData();
+    row.device_id = label_;
+    row.timestamp = bucket_start_;
+    row.temperature = result[0];
+    row.humidity = result[1];
+    row.co2 = result[2];
+    row.pm25 = result[3];
+    row.noise = result[4];
+    row.light = result[5];
+    row.area = area_;
+    row.area_type = area_type_;
+    row.has_aggregated_data = true;
+    row.samples_count = static_cast<int>(devices_.size());  // 参与聚合的设备数
+    devices_.clear();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include "row_cursor.h"
+
+// 跨设备聚合：把按时间升序的多设备行按时间桶分组，
+// 先求每个设备在桶内的均值，再对各设备取平均/最小/最大值，每个桶输出一行
+class AreaAggregateCursor : public RowCursor {
+public:
+    enum class Mode { MEAN, MIN, MAX };
+
+    AreaAggregateCursor(std::unique_ptr<RowCursor> source, std::string label,
+                        time_t bucket_seconds, Mode mode);
+
+    bool next(SensorData& row) override;
+    bool failed() const override { return source_->failed(); }
+
+    // 解析 mean/min/max，未知名称返回 false
+    static bool parseMode(const std::string& name, Mode& mode);
+
+private:
+    struct DeviceAccumulator {
+        double sums[6] = {};
+        int count = 0;
+    };
+
+    void flush(SensorData& row);
+
+    std::unique_ptr<RowCursor> source_;
+    std::string label_;
+    time_t bucket_seconds_;
+    Mode mode_;
+
+    time_t bucket_start_ = 0;
+    std::map<std::string, DeviceAccumulator> devices_;
+    std::string area_;
+    AreaType area_type_ = AreaType::LIVING;
+    bool source_done_ = false;
+};
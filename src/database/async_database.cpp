@@ -0,0 +1,402 @@
+#include "async_database.h"
+#include <poll.h>
+#include <unistd.h>
+#include <charconv>
+#include <cmath>
+#include <iostream>
+
+namespace net = boost::asio;
+
+namespace {
+
+void appendNumber(std::string& out, double value) {
+    // inf/nan 不是合法的 SQL 数字字面量，写 NULL 由服务端按列约束拒绝，而不是整条语句语法错误
+    if (!std::isfinite(value)) {
+        out += "NULL";
+        return;
+    }
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void appendNumber(std::string& out, long long value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void appendEscaped(std::string& out, MYSQL* conn, const std::string& value) {
+    std::string escaped(value.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(conn, escaped.data(), value.data(), value.size());
+    out += '\'';
+    out.append(escaped.data(), len);
+    out += '\'';
+}
+
+} // namespace
+
+AsyncDatabase::AsyncDatabase(net::io_context& ioc, const ConnectionInfo& info, size_t connections)
+    : ioc_(ioc)
+    , strand_(net::make_strand(ioc))
+    , info_(info) {
+    for (size_t i = 0; i < connections; ++i) {
+        connections_.push_back(std::make_unique<Connection>(ioc_));
+    }
+}
+
+AsyncDatabase::~AsyncDatabase() {
+    connect_pool_.join();
+    for (auto& conn : connections_) {
+        disconnect(*conn);
+    }
+}
+
+void AsyncDatabase::start() {
+    net::post(strand_, [this]() {
+        for (auto& conn : connections_) {
+            connect(*conn);
+        }
+    });
+}
+
+void AsyncDatabase::stop() {
+    net::post(strand_, [this]() {
+        stopped_ = true;
+        for (auto& conn : connections_) {
+            conn->retry_timer.cancel();
+            if (conn->phase == Phase::CONNECTING) {
+                continue;  // 由 onConnected 关闭
+            }
+            if (conn->phase != Phase::DISCONNECTED && conn->phase != Phase::IDLE) {
+                finish(*conn, false);
+            }
+            disconnect(*conn);
+        }
+        dispatch();
+    });
+}
+
+void AsyncDatabase::asyncQuery(std::string sql, RowHandler on_row, DoneHandler on_done) {
+    asyncQuery([sql = std::move(sql)](MYSQL*) { return sql; },
+               std::move(on_row), std::move(on_done));
+}
+
+void AsyncDatabase::asyncQuery(SqlBuilder build_sql, RowHandler on_row, DoneHandler on_done) {
+    ++in_flight_;
+    net::post(strand_, [this, request = Request{std::move(build_sql), std::move(on_row), std::move(on_done)}]() mutable {
+        pending_.push_back(std::move(request));
+        dispatch();
+    });
+}
+
+void AsyncDatabase::asyncInsertSensorData(const SensorData& data, DoneHandler on_done) {
+    asyncQuery(
+        [data](MYSQL* conn) {
+            std::string sql;
+            sql.reserve(256);
+            sql += "INSERT INTO sensor_data_realtime "
+                   "(device_id, timestamp, temperature, humidity, co2, pm25, noise, light, area, area_type) "
+                   "VALUES (";
+            appendEscaped(sql, conn, data.device_id);
+            sql += ", FROM_UNIXTIME(";
+            appendNumber(sql, static_cast<long long>(data.timestamp));
+            sql += ")";
+            for (double value : {data.temperature, data.humidity, data.co2,
+                                 data.pm25, data.noise, data.light}) {
+                sql += ", ";
+                appendNumber(sql, value);
+            }
+            sql += ", ";
+            appendEscaped(sql, conn, data.area);
+            sql += ", ";
+            appendNumber(sql, static_cast<long long>(data.area_type));
+            sql += ")";
+            return sql;
+        },
+        nullptr, std::move(on_done));
+}
+
+void AsyncDatabase::connect(Connection& conn) {
+    // 建立连接是低频操作，使用阻塞调用并设置较短的超时，在连接线程上执行以免阻塞 strand
+    conn.phase = Phase::CONNECTING;
+    net::post(connect_pool_, [this, &conn]() {
+        MYSQL* mysql = mysql_init(nullptr);
+        if (mysql) {
+            unsigned int timeout = CONNECT_TIMEOUT_SECONDS;
+            mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+#ifdef LIBMARIADB
+            mysql_options(mysql, MYSQL_OPT_NONBLOCK, 0);
+#endif
+        }
+
+        if (!mysql || !mysql_real_connect(mysql, info_.host.c_str(), info_.user.c_str(),
+                                          info_.password.c_str(), info_.database.c_str(),
+                                          0, nullptr, 0)) {
+            std::cerr << "[AsyncDB] Connect failed: "
+                      << (mysql ? mysql_error(mysql) : "mysql_init() failed") << std::endl;
+            if (mysql) {
+                mysql_close(mysql);
+                mysql = nullptr;
+            }
+        }
+        net::post(strand_, [this, &conn, mysql]() {
+            onConnected(conn, mysql);
+        });
+    });
+}
+
+void AsyncDatabase::onConnected(Connection& conn, MYSQL* mysql) {
+    if (stopped_) {
+        if (mysql) {
+            mysql_close(mysql);
+        }
+        conn.phase = Phase::DISCONNECTED;
+        return;
+    }
+
+    if (!mysql) {
+        conn.phase = Phase::DISCONNECTED;
+        // 稍后重试，期间没有其他可用连接的请求立即失败
+        conn.retry_timer.expires_after(std::chrono::seconds(RECONNECT_DELAY_SECONDS));
+        conn.retry_timer.async_wait(net::bind_executor(strand_, [this, &conn](boost::system::error_code ec) {
+            if (!ec && !stopped_) {
+                connect(conn);
+            }
+        }));
+        dispatch();
+        return;
+    }
+
+    // 复制一份描述符交给 asio 等待可读/可写，关闭时不影响客户端库持有的 socket
+    conn.mysql = mysql;
+    conn.socket.assign(::dup(mysql_get_socket(conn.mysql)));
+    conn.phase = Phase::IDLE;
+    dispatch();
+}
+
+void AsyncDatabase::disconnect(Connection& conn) {
+    boost::system::error_code ec;
+    conn.socket.close(ec);
+    if (conn.result) {
+        mysql_free_result(conn.result);
+        conn.result = nullptr;
+    }
+    if (conn.mysql) {
+        mysql_close(conn.mysql);
+        conn.mysql = nullptr;
+    }
+    conn.phase = Phase::DISCONNECTED;
+}
+
+void AsyncDatabase::dispatch() {
+    bool any_connected = false;
+    for (auto& conn : connections_) {
+        if (conn->phase != Phase::DISCONNECTED) {
+            any_connected = true;
+        }
+        if (conn->phase != Phase::IDLE || pending_.empty()) {
+            continue;
+        }
+        conn->request = std::move(pending_.front());
+        pending_.pop_front();
+        conn->sql = conn->request.build_sql(conn->mysql);
+        conn->phase = Phase::QUERYING;
+        conn->request_sent = false;
+        advance(*conn, startQuery(*conn));
+    }
+
+    // 没有任何可用或正在建立的连接时立即失败，避免请求无限堆积
+    if (!any_connected || stopped_) {
+        while (!pending_.empty()) {
+            Request request = std::move(pending_.front());
+            pending_.pop_front();
+            --in_flight_;
+            if (request.on_done) {
+                request.on_done(false);
+            }
+        }
+    }
+}
+
+void AsyncDatabase::advance(Connection& conn, StepResult result) {
+    if (result == StepResult::WAIT) {
+        wait(conn);
+        return;
+    }
+    if (result == StepResult::FAILED) {
+        std::cerr << "[AsyncDB] Query error: " << mysql_error(conn.mysql) << std::endl;
+        unsigned int err = mysql_errno(conn.mysql);
+        finish(conn, false);
+        if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST) {
+            disconnect(conn);
+            connect(conn);
+        }
+        net::post(strand_, [this]() { dispatch(); });
+        return;
+    }
+
+    if (conn.phase == Phase::QUERYING) {
+        conn.phase = Phase::STORING;
+        advance(conn, startStore(conn));
+        return;
+    }
+
+    // 结果已全部读入客户端内存，逐行回调不会阻塞
+    if (conn.result) {
+        unsigned int num_fields = mysql_num_fields(conn.result);
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(conn.result))) {
+            if (conn.request.on_row) {
+                conn.request.on_row(row, mysql_fetch_lengths(conn.result), num_fields);
+            }
+        }
+        mysql_free_result(conn.result);
+        conn.result = nullptr;
+    }
+    finish(conn, true);
+    // 通过 post 继续派发，避免同步完成的查询层层递归
+    net::post(strand_, [this]() { dispatch(); });
+}
+
+void AsyncDatabase::wait(Connection& conn) {
+#ifdef LIBMARIADB
+    bool want_read = conn.wait_status & MYSQL_WAIT_READ;
+    bool want_write = conn.wait_status & MYSQL_WAIT_WRITE;
+#else
+    // MySQL 8 的 NET_ASYNC_NOT_READY 不区分读写，请求发出之前两者都可能在等待
+    bool want_read = true;
+    bool want_write = conn.phase == Phase::QUERYING && !conn.request_sent;
+#endif
+    if (!want_read && !want_write) {
+        want_read = true;
+    }
+
+    unsigned generation = ++conn.wait_generation;
+    if (want_read) {
+        conn.socket.async_wait(net::posix::stream_descriptor::wait_read, net::bind_executor(strand_,
+            [this, &conn, generation](boost::system::error_code ec) {
+                if (!ec) {
+                    onReady(conn, generation, false);
+                }
+            }));
+    }
+    if (want_write) {
+        conn.socket.async_wait(net::posix::stream_descriptor::wait_write, net::bind_executor(strand_,
+            [this, &conn, generation](boost::system::error_code ec) {
+                if (!ec) {
+                    onReady(conn, generation, true);
+                }
+            }));
+    }
+}
+
+void AsyncDatabase::onReady(Connection& conn, unsigned generation, bool writable) {
+    // 先就绪的一方推进，另一方的等待作废
+    if (generation != conn.wait_generation ||
+        conn.phase == Phase::DISCONNECTED || conn.phase == Phase::IDLE) {
+        return;
+    }
+    ++conn.wait_generation;
+    boost::system::error_code ec;
+    conn.socket.cancel(ec);
+
+#ifdef LIBMARIADB
+    conn.wait_status = writable ? MYSQL_WAIT_WRITE : MYSQL_WAIT_READ;
+#endif
+    StepResult result = conn.phase == Phase::QUERYING ? continueQuery(conn) : continueStore(conn);
+#ifndef LIBMARIADB
+    // 可写时继续仍未完成，且 socket 依然可写：请求已全部发出，之后只等待响应，
+    // 否则一直可写的 socket 会让等待立即返回而空转
+    if (result == StepResult::WAIT && writable && conn.phase == Phase::QUERYING) {
+        pollfd pfd{conn.socket.native_handle(), POLLOUT, 0};
+        if (::poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT)) {
+            conn.request_sent = true;
+        }
+    }
+#endif
+    advance(conn, result);
+}
+
+void AsyncDatabase::finish(Connection& conn, bool ok) {
+    Request request = std::move(conn.request);
+    conn.request = Request{};
+    conn.phase = Phase::IDLE;
+    --in_flight_;
+    if (request.on_done) {
+        request.on_done(ok);
+    }
+}
+
+#ifdef LIBMARIADB
+
+// MariaDB Connector/C: *_start 发起操作，返回需要等待的事件，socket 就绪后调用 *_cont
+AsyncDatabase::StepResult AsyncDatabase::startQuery(Connection& conn) {
+    int err = 0;
+    conn.wait_status = mysql_real_query_start(&err, conn.mysql, conn.sql.data(), conn.sql.size());
+    if (conn.wait_status) {
+        return StepResult::WAIT;
+    }
+    return err ? StepResult::FAILED : StepResult::DONE;
+}
+
+AsyncDatabase::StepResult AsyncDatabase::continueQuery(Connection& conn) {
+    int err = 0;
+    conn.wait_status = mysql_real_query_cont(&err, conn.mysql, conn.wait_status);
+    if (conn.wait_status) {
+        return StepResult::WAIT;
+    }
+    return err ? StepResult::FAILED : StepResult::DONE;
+}
+
+AsyncDatabase::StepResult AsyncDatabase::startStore(Connection& conn) {
+    conn.wait_status = mysql_store_result_start(&conn.result, conn.mysql);
+    if (conn.wait_status) {
+        return StepResult::WAIT;
+    }
+    return (!conn.result && mysql_field_count(conn.mysql) != 0) ? StepResult::FAILED : StepResult::DONE;
+}
+
+AsyncDatabase::StepResult AsyncDatabase::continueStore(Connection& conn) {
+    conn.wait_status = mysql_store_result_cont(&conn.result, conn.mysql, conn.wait_status);
+    if (conn.wait_status) {
+        return StepResult::WAIT;
+    }
+    return (!conn.result && mysql_field_count(conn.mysql) != 0) ? StepResult::FAILED : StepResult::DONE;
+}
+
+#else
+
+// MySQL 8: 以相同参数重复调用 *_nonblocking 直到完成
+AsyncDatabase::StepResult AsyncDatabase::startQuery(Connection& conn) {
+    switch (mysql_real_query_nonblocking(conn.mysql, conn.sql.data(), conn.sql.size())) {
+        case NET_ASYNC_NOT_READY:
+            return StepResult::WAIT;
+        case NET_ASYNC_ERROR:
+            return StepResult::FAILED;
+        default:
+            return StepResult::DONE;
+    }
+}
+
+AsyncDatabase::StepResult AsyncDatabase::continueQuery(Connection& conn) {
+    return startQuery(conn);
+}
+
+AsyncDatabase::StepResult AsyncDatabase::startStore(Connection& conn) {
+    switch (mysql_store_result_nonblocking(conn.mysql, &conn.result)) {
+        case NET_ASYNC_NOT_READY:
+            return StepResult::WAIT;
+        case NET_ASYNC_ERROR:
+            return StepResult::FAILED;
+        default:
+            return (!conn.result && mysql_field_count(conn.mysql) != 0) ? StepResult::FAILED
+                                                                         : StepResult::DONE;
+    }
+}
+
+AsyncDatabase::StepResult AsyncDatabase::continueStore(Connection& conn) {
+    return startStore(conn);
+}
+
+#endif
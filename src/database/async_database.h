@@ -0,0 +1,92 @@
+#pragma once
+#include <mysql/mysql.h>
+#include <boost/asio.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../models/sensor_data.h"
+#include "mysql_connection.h"
+
+// 基于 MySQL 非阻塞 API 的异步数据库客户端。
+// 每个连接的 socket 注册到 io_context 上，等待期间不占用线程，
+// 少量线程即可同时保持大量查询在途。所有回调都在内部 strand 上执行，不应阻塞；
+// 建立连接使用阻塞调用，在单独的线程上执行，完成后回到 strand。
+class AsyncDatabase {
+public:
+    // 每返回一行调用一次，row/lengths 仅在回调期间有效
+    using RowHandler = std::function<void(MYSQL_ROW row, unsigned long* lengths, unsigned int num_fields)>;
+    using DoneHandler = std::function<void(bool ok)>;
+    // 在分配到的连接上生成 SQL，可借助该连接转义字符串
+    using SqlBuilder = std::function<std::string(MYSQL* conn)>;
+
+    AsyncDatabase(boost::asio::io_context& ioc, const ConnectionInfo& info, size_t connections);
+    ~AsyncDatabase();
+
+    // 禁止拷贝
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    void start();
+    void stop();
+
+    void asyncQuery(std::string sql, RowHandler on_row, DoneHandler on_done);
+    void asyncQuery(SqlBuilder build_sql, RowHandler on_row, DoneHandler on_done);
+    void asyncInsertSensorData(const SensorData& data, DoneHandler on_done);
+
+    // 排队和执行中的请求数
+    size_t inFlight() const { return in_flight_.load(); }
+
+private:
+    struct Request {
+        SqlBuilder build_sql;
+        RowHandler on_row;
+        DoneHandler on_done;
+    };
+
+    enum class Phase { DISCONNECTED, CONNECTING, IDLE, QUERYING, STORING };
+    enum class StepResult { DONE, WAIT, FAILED };
+
+    struct Connection {
+        explicit Connection(boost::asio::io_context& ioc) : socket(ioc), retry_timer(ioc) {}
+
+        MYSQL* mysql = nullptr;
+        boost::asio::posix::stream_descriptor socket;
+        boost::asio::steady_timer retry_timer;
+        Phase phase = Phase::DISCONNECTED;
+        Request request;
+        std::string sql;
+        MYSQL_RES* result = nullptr;
+        int wait_status = 0;  // MariaDB 返回的等待事件
+        unsigned wait_generation = 0;  // 同时等待读写时只有先就绪的一方继续推进
+        bool request_sent = false;     // MySQL 8：请求已完整发出，之后只需等待可读
+    };
+
+    void connect(Connection& conn);
+    void onConnected(Connection& conn, MYSQL* mysql);
+    void disconnect(Connection& conn);
+    void dispatch();
+    void advance(Connection& conn, StepResult result);
+    void wait(Connection& conn);
+    void onReady(Connection& conn, unsigned generation, bool writable);
+    void finish(Connection& conn, bool ok);
+
+    StepResult startQuery(Connection& conn);
+    StepResult continueQuery(Connection& conn);
+    StepResult startStore(Connection& conn);
+    StepResult continueStore(Connection& conn);
+
+    boost::asio::io_context& ioc_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    boost::asio::thread_pool connect_pool_{1};  // 执行阻塞的 mysql_real_connect
+    ConnectionInfo info_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    std::deque<Request> pending_;
+    std::atomic<size_t> in_flight_{0};
+    bool stopped_ = false;
+
+    static constexpr int RECONNECT_DELAY_SECONDS = 5;
+    static constexpr unsigned int CONNECT_TIMEOUT_SECONDS = 2;
+};
@@ -4,6 +4,778 @@
 #include <cstring>
 #include <ctime>
 #include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include "../utils/ddsketch.h"
+#include "../utils/gorilla.h"
+
+namespace {
+
+const char* INSERT_REALTIME_SQL =
+    "INSERT INTO sensor_data_realtime "
+    "(device_id, timestamp, temperature, humidity, co2, pm25, noise, light, area, area_type) "
+    "VALUES (?, FROM_UNIXTIME(?), ?, ?, ?, ?, ?, ?, ?, ?)";
+
+const char* SELECT_REALTIME_SQL =
+    "SELECT UNIX_TIMESTAMP(timestamp), device_id, "
+    "temperature, humidity, co2, pm25, noise, light, area, area_type "
+    "FROM sensor_data_realtime "
+    "WHERE device_id = ? AND timestamp BETWEEN FROM_UNIXTIME(?) AND FROM_UNIXTIME(?) "
+    "ORDER BY timestamp ASC";
+
+const char* SELECT_HOURLY_SQL =
+    "SELECT UNIX_TIMESTAMP(hour_timestamp), device_id, "
+    "avg_temperature, avg_humidity, avg_co2, avg_pm25, avg_noise, avg_light, "
+    "max_temperature, min_temperature, samples_count, area, area_type "
+    "FROM sensor_data_hourly "
+    "WHERE device_id = ? AND hour_timestamp BETWEEN FROM_UNIXTIME(?) AND FROM_UNIXTIME(?) "
+    "ORDER BY hour_timestamp ASC";
+
+const char* SELECT_DAILY_SQL =
+    "SELECT UNIX_TIMESTAMP(date_timestamp), device_id, "
+    "avg_temperature, avg_humidity, avg_co2, avg_pm25, avg_noise, avg_light, "
+    "max_temperature, min_temperature, samples_count, area, area_type "
+    "FROM sensor_data_daily "
+    "WHERE device_id = ? AND date_timestamp BETWEEN FROM_UNIXTIME(?) AND FROM_UNIXTIME(?) "
+    "ORDER BY date_timestamp ASC";
+
+// 封存某个时间窗口内所有设备的原始数据，按设备分组
+const char* SELECT_WINDOW_SQL =
+    "SELECT UNIX_TIMESTAMP(timestamp), device_id, "
+    "temperature, humidity, co2, pm25, noise, light, area, area_type "
+    "FROM sensor_data_realtime "
+    "WHERE timestamp >= FROM_UNIXTIME(?) AND timestamp < FROM_UNIXTIME(?) "
+    "ORDER BY device_id, timestamp";
+
+const char* INSERT_BLOCK_SQL =
+    "INSERT IGNORE INTO sensor_data_blocks "
+    "(device_id, start_timestamp, end_timestamp, samples_count, area, area_type, payload) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?)";
+
+// 重新封存时覆盖已有的块，新块由旧块与实时表中的行合并而成
+const char* UPSERT_BLOCK_SQL =
+    "INSERT INTO sensor_data_blocks "
+    "(device_id, start_timestamp, end_timestamp, samples_count, area, area_type, payload) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?) "
+    "ON DUPLICATE KEY UPDATE end_timestamp = VALUES(end_timestamp), "
+    "samples_count = VALUES(samples_count), area = VALUES(area), "
+    "area_type = VALUES(area_type), payload = VALUES(payload)";
+
+const char* SELECT_WINDOW_BLOCKS_SQL =
+    "SELECT device_id, payload FROM sensor_data_blocks WHERE start_timestamp = ?";
+
+const char* SELECT_BLOCKS_SQL =
+    "SELECT device_id, start_timestamp, area, area_type, payload "
+    "FROM sensor_data_blocks "
+    "WHERE device_id = ? AND end_timestamp >= ? AND start_timestamp <= ? "
+    "ORDER BY start_timestamp ASC, device_id ASC";
+
+const char* SELECT_SEALED_UNTIL_SQL =
+    "SELECT COALESCE(MAX(start_timestamp), 0) FROM sensor_data_blocks";
+
+// 维护任务水位
+const char* SELECT_WATERMARK_SQL =
+    "SELECT watermark FROM maintenance_watermarks WHERE task = ?";
+
+const char* UPSERT_WATERMARK_SQL =
+    "INSERT INTO maintenance_watermarks (task, watermark) VALUES (?, ?) "
+    "ON DUPLICATE KEY UPDATE watermark = VALUES(watermark)";
+
+const char* SELECT_COLUMN_EXISTS_SQL =
+    "SELECT COUNT(*) FROM information_schema.COLUMNS "
+    "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ? AND COLUMN_NAME = ?";
+
+const char* SELECT_INDEX_EXISTS_SQL =
+    "SELECT COUNT(*) FROM information_schema.STATISTICS "
+    "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ? AND INDEX_NAME = ?";
+
+// 聚合结果按 (设备, 桶) 唯一键覆盖写入，重复聚合同一窗口是幂等的；
+// 草图置空后由本次聚合重新生成
+const char* UPSERT_AGGREGATE_SUFFIX =
+    " ON DUPLICATE KEY UPDATE "
+    "avg_temperature = VALUES(avg_temperature), avg_humidity = VALUES(avg_humidity), "
+    "avg_co2 = VALUES(avg_co2), avg_pm25 = VALUES(avg_pm25), "
+    "avg_noise = VALUES(avg_noise), avg_light = VALUES(avg_light), "
+    "max_temperature = VALUES(max_temperature), min_temperature = VALUES(min_temperature), "
+    "samples_count = VALUES(samples_count), area = VALUES(area), area_type = VALUES(area_type), "
+    "sketches = NULL";
+
+// 分位数草图：草图行统一为 (设备ID, 桶起点, 草图)
+const char* UPDATE_HOURLY_SKETCHES_SQL =
+    "UPDATE sensor_data_hourly SET sketches = ? "
+    "WHERE device_id = ? AND hour_timestamp = FROM_UNIXTIME(?)";
+
+const char* UPDATE_DAILY_SKETCHES_SQL =
+    "UPDATE sensor_data_daily SET sketches = ? "
+    "WHERE device_id = ? AND date_timestamp = FROM_UNIXTIME(?)";
+
+// 每日草图由当天的小时草图合并而成，按日期分组与每日聚合保持一致
+const char* SELECT_DAY_SKETCHES_SQL =
+    "SELECT device_id, UNIX_TIMESTAMP(DATE(hour_timestamp)), sketches "
+    "FROM sensor_data_hourly "
+    "WHERE hour_timestamp >= FROM_UNIXTIME(?) AND hour_timestamp < FROM_UNIXTIME(?) "
+    "AND sketches IS NOT NULL";
+
+const char* SELECT_HOURLY_SKETCHES_SQL =
+    "SELECT device_id, UNIX_TIMESTAMP(hour_timestamp), sketches "
+    "FROM sensor_data_hourly "
+    "WHERE device_id = ? AND hour_timestamp BETWEEN FROM_UNIXTIME(?) AND FROM_UNIXTIME(?) "
+    "AND sketches IS NOT NULL";
+
+const char* SELECT_DAILY_SKETCHES_SQL =
+    "SELECT device_id, UNIX_TIMESTAMP(date_timestamp), sketches "
+    "FROM sensor_data_daily "
+    "WHERE device_id = ? AND date_timestamp BETWEEN FROM_UNIXTIME(?) AND FROM_UNIXTIME(?) "
+    "AND sketches IS NOT NULL";
+
+constexpr unsigned long STRING_BUFFER_SIZE = 256;  // VARCHAR(50) 在 utf8mb4 下最多 200 字节
+constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;   // 压缩块负载的初始缓冲区，超出时扩容
+
+// 实时数据查询的结果缓冲区
+struct RealtimeRow {
+    long long timestamp = 0;
+    char device_id[STRING_BUFFER_SIZE];
+    unsigned long device_id_length = 0;
+    double values[6] = {};  // temperature, humidity, co2, pm25, noise, light
+    char area[STRING_BUFFER_SIZE];
+    unsigned long area_length = 0;
+    int area_type = 0;
+    MYSQL_BIND binds[10];
+
+    RealtimeRow() {
+        bindLongLong(binds[0], &timestamp);
+        bindString(binds[1], device_id, STRING_BUFFER_SIZE, &device_id_length);
+        for (int i = 0; i < 6; ++i) {
+            bindDouble(binds[2 + i], &values[i]);
+        }
+        bindString(binds[8], area, STRING_BUFFER_SIZE, &area_length);
+        bindInt(binds[9], &area_type);
+    }
+
+    void toSensorData(SensorData& data) const {
+        data.timestamp = timestamp;
+        data.device_id.assign(device_id, std::min(device_id_length, STRING_BUFFER_SIZE));
+        data.temperature = values[0];
+        data.humidity = values[1];
+        data.co2 = values[2];
+        data.pm25 = values[3];
+        data.noise = values[4];
+        data.light = values[5];
+        data.area.assign(area, std::min(area_length, STRING_BUFFER_SIZE));
+        data.area_type = static_cast<AreaType>(area_type);
+    }
+};
+
+// 小时/每日聚合数据查询的结果缓冲区
+struct AggregateRow {
+    long long timestamp = 0;
+    char device_id[STRING_BUFFER_SIZE];
+    unsigned long device_id_length = 0;
+    double values[6] = {};  // avg_temperature ... avg_light
+    double max_temperature = 0;
+    double min_temperature = 0;
+    int samples_count = 0;
+    char area[STRING_BUFFER_SIZE];
+    unsigned long area_length = 0;
+    int area_type = 0;
+    bool is_hourly;
+    MYSQL_BIND binds[13];
+
+    explicit AggregateRow(bool hourly) : is_hourly(hourly) {
+        bindLongLong(binds[0], &timestamp);
+        bindString(binds[1], device_id, STRING_BUFFER_SIZE, &device_id_length);
+        for (int i = 0; i < 6; ++i) {
+            bindDouble(binds[2 + i], &values[i]);
+        }
+        bindDouble(binds[8], &max_temperature);
+        bindDouble(binds[9], &min_temperature);
+        bindInt(binds[10], &samples_count);
+        bindString(binds[11], area, STRING_BUFFER_SIZE, &area_length);
+        bindInt(binds[12], &area_type);
+    }
+
+    void toSensorData(SensorData& data) const {
+        data.timestamp = timestamp;
+        data.device_id.assign(device_id, std::min(device_id_length, STRING_BUFFER_SIZE));
+        data.temperature = values[0];
+        data.humidity = values[1];
+        data.co2 = values[2];
+        data.pm25 = values[3];
+        data.noise = values[4];
+        data.light = values[5];
+        data.area.assign(area, std::min(area_length, STRING_BUFFER_SIZE));
+        data.area_type = static_cast<AreaType>(area_type);
+        
+        // 设置聚合数据标记
+        data.has_aggregated_data = true;
+        data.is_hourly = is_hourly;
+        data.has_min_max = true;
+        data.max_temperature = max_temperature;
+        data.min_temperature = min_temperature;
+        data.samples_count = samples_count;
+    }
+};
+
+bool executeInsert(MySQLConnection& conn, const SensorData& data) {
+    MYSQL_STMT* stmt = conn.statement(INSERT_REALTIME_SQL);
+    if (!stmt) {
+        return false;
+    }
+    
+    long long timestamp = data.timestamp;
+    double values[6] = {data.temperature, data.humidity, data.co2,
+                        data.pm25, data.noise, data.light};
+    int area_type = static_cast<int>(data.area_type);
+    
+    MYSQL_BIND params[10];
+    bindString(params[0], data.device_id);
+    bindLongLong(params[1], &timestamp);
+    for (int i = 0; i < 6; ++i) {
+        bindDouble(params[2 + i], &values[i]);
+    }
+    bindString(params[8], data.area);
+    bindInt(params[9], &area_type);
+    
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+        conn.checkError(stmt);
+        return false;
+    }
+    return true;
+}
+
+// 执行带参数的查询并绑定结果缓冲区，之后由调用方逐行 fetch
+bool executeQuery(MySQLConnection& conn, const char* sql, MYSQL_BIND* params, MYSQL_BIND* results) {
+    MYSQL_STMT* stmt = conn.statement(sql);
+    if (!stmt) {
+        return false;
+    }
+    
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, results)) {
+        conn.checkError(stmt);
+        return false;
+    }
+    return true;
+}
+
+// IN 列表的占位符个数向上取整到 2 的幂，多出的位置重复最后一个设备，
+// 每个连接为每条语句缓存的预处理变体只有对数级个数
+size_t paddedDeviceCount(size_t device_count) {
+    size_t padded = 1;
+    while (padded < device_count) {
+        padded <<= 1;
+    }
+    return padded;
+}
+
+// 多设备查询复用单设备语句，把设备条件替换为 IN 列表
+std::string withDeviceList(const char* sql, size_t device_count) {
+    std::string result(sql);
+    size_t padded = paddedDeviceCount(device_count);
+    if (padded <= 1) {
+        return result;
+    }
+    std::string list = "device_id IN (?";
+    for (size_t i = 1; i < padded; ++i) {
+        list += ", ?";
+    }
+    list += ")";
+    result.replace(result.find("device_id = ?"), std::strlen("device_id = ?"), list);
+    return result;
+}
+
+// 执行设备 + 时间范围查询，sql 需由 withDeviceList 按设备数生成
+bool executeRangeQuery(MySQLConnection& conn, const std::string& sql,
+                       const std::vector<std::string>& device_ids,
+                       time_t start_time, time_t end_time, MYSQL_BIND* results) {
+    long long start = start_time;
+    long long end = end_time;
+    size_t padded = paddedDeviceCount(device_ids.size());
+    std::vector<MYSQL_BIND> params(padded + 2);
+    for (size_t i = 0; i < padded; ++i) {
+        bindString(params[i], device_ids[std::min(i, device_ids.size() - 1)]);
+    }
+    bindLongLong(params[padded], &start);
+    bindLongLong(params[padded + 1], &end);
+    return executeQuery(conn, sql.c_str(), params.data(), results);
+}
+
+// 无法取得连接时返回的游标
+class FailedCursor : public RowCursor {
+public:
+    bool next(SensorData&) override { return false; }
+    bool failed() const override { return true; }
+};
+
+// 预处理语句上的非缓冲游标：不调用 mysql_stmt_store_result，
+// 每次 fetch 从服务端流式读取一行，游标存活期间独占该连接
+template <typename Row>
+class StatementCursor : public RowCursor {
+public:
+    template <typename... RowArgs>
+    StatementCursor(ConnectionPool::Lease conn, const char* sql,
+                    const std::vector<std::string>& device_ids,
+                    time_t start_time, time_t end_time, RowArgs... row_args)
+        : conn_(std::move(conn))
+        , row_(row_args...) {
+        std::string query = withDeviceList(sql, device_ids.size());
+        if (conn_ && executeRangeQuery(*conn_, query, device_ids, start_time, end_time, row_.binds)) {
+            stmt_ = conn_->statement(query);
+        } else {
+            failed_ = true;
+        }
+    }
+
+    ~StatementCursor() override {
+        if (stmt_) {
+            mysql_stmt_free_result(stmt_);
+        }
+    }
+
+    bool next(SensorData& data) override {
+        if (!stmt_) {
+            return false;
+        }
+        int status = mysql_stmt_fetch(stmt_);
+        if (status == 0 || status == MYSQL_DATA_TRUNCATED) {
+            row_.toSensorData(data);
+            return true;
+        }
+        if (status != MYSQL_NO_DATA) {
+            conn_->checkError(stmt_);
+            failed_ = true;
+        }
+        mysql_stmt_free_result(stmt_);
+        stmt_ = nullptr;
+        return false;
+    }
+
+    bool failed() const override { return failed_; }
+
+private:
+    ConnectionPool::Lease conn_;
+    MYSQL_STMT* stmt_ = nullptr;
+    bool failed_ = false;
+    Row row_;
+};
+
+// 解码一个压缩块，落在 [start_time, end_time] 内的行以 proto 的设备和区域信息追加到 out
+void decodeBlock(const char* payload, size_t size, const SensorData& proto,
+                 time_t start_time, time_t end_time, std::vector<SensorData>& out) {
+    GorillaDecoder decoder(payload, size);
+    SensorData row = proto;
+    int64_t timestamp;
+    double values[GorillaDecoder::CHANNELS];
+    while (decoder.next(timestamp, values)) {
+        if (timestamp < start_time || timestamp > end_time) {
+            continue;
+        }
+        row.timestamp = timestamp;
+        row.temperature = values[0];
+        row.humidity = values[1];
+        row.co2 = values[2];
+        row.pm25 = values[3];
+        row.noise = values[4];
+        row.light = values[5];
+        out.push_back(row);
+    }
+}
+
+// 压缩块游标：按时间窗口读取块，同一窗口内所有设备的块解码后按时间排序输出，
+// 只返回落在 [start_time, end_time] 内的行
+class BlockCursor : public RowCursor {
+public:
+    BlockCursor(ConnectionPool::Lease conn, const std::vector<std::string>& device_ids,
+                time_t start_time, time_t end_time)
+        : conn_(std::move(conn))
+        , start_time_(start_time)
+        , end_time_(end_time)
+        , payload_(INITIAL_BLOCK_SIZE, '\0') {
+        bindString(binds_[0], device_id_, STRING_BUFFER_SIZE, &device_id_length_);
+        bindLongLong(binds_[1], &block_start_);
+        bindString(binds_[2], area_, STRING_BUFFER_SIZE, &area_length_);
+        bindInt(binds_[3], &area_type_);
+        bindPayload();
+        std::string query = withDeviceList(SELECT_BLOCKS_SQL, device_ids.size());
+        if (conn_ && executeRangeQuery(*conn_, query, device_ids, start_time, end_time, binds_)) {
+            stmt_ = conn_->statement(query);
+        } else {
+            failed_ = true;
+        }
+    }
+
+    ~BlockCursor() override {
+        if (stmt_) {
+            mysql_stmt_free_result(stmt_);
+        }
+    }
+
+    bool failed() const override { return failed_; }
+
+    bool next(SensorData& data) override {
+        while (index_ >= window_.size()) {
+            if (!loadWindow()) {
+                return false;
+            }
+        }
+        data = std::move(window_[index_++]);
+        return true;
+    }
+
+private:
+    void bindPayload() {
+        std::memset(&binds_[4], 0, sizeof(binds_[4]));
+        binds_[4].buffer_type = MYSQL_TYPE_BLOB;
+        binds_[4].buffer = payload_.data();
+        binds_[4].buffer_length = payload_.size();
+        binds_[4].length = &payload_length_;
+    }
+
+    // 读取同一时间窗口的全部块
+    bool loadWindow() {
+        window_.clear();
+        index_ = 0;
+        if (!has_staged_ && !fetchBlock()) {
+            return false;
+        }
+        long long window_start = staged_start_;
+        do {
+            if (staged_start_ != window_start) {
+                break;
+            }
+            window_.insert(window_.end(), std::make_move_iterator(staged_.begin()),
+                           std::make_move_iterator(staged_.end()));
+            has_staged_ = false;
+        } while (fetchBlock());
+
+        std::stable_sort(window_.begin(), window_.end(), [](const SensorData& a, const SensorData& b) {
+            return a.timestamp < b.timestamp;
+        });
+        return true;
+    }
+
+    // 读取并解码下一个块到 staged_
+    bool fetchBlock() {
+        staged_.clear();
+        if (!stmt_) {
+            return false;
+        }
+        int status = mysql_stmt_fetch(stmt_);
+        if (status == MYSQL_DATA_TRUNCATED && payload_length_ > payload_.size()) {
+            // 块比缓冲区大：扩容后单独取回该列，并重新绑定供后续行使用
+            payload_.resize(payload_length_);
+            bindPayload();
+            if (mysql_stmt_fetch_column(stmt_, &binds_[4], 4, 0) ||
+                mysql_stmt_bind_result(stmt_, binds_)) {
+                conn_->checkError(stmt_);
+                status = 1;
+            } else {
+                status = 0;
+            }
+        }
+        if (status != 0 && status != MYSQL_DATA_TRUNCATED) {
+            if (status != MYSQL_NO_DATA) {
+                conn_->checkError(stmt_);
+                failed_ = true;
+            }
+            mysql_stmt_free_result(stmt_);
+            stmt_ = nullptr;
+            return false;
+        }
+
+        SensorData row;
+        row.device_id.assign(device_id_, std::min(device_id_length_, STRING_BUFFER_SIZE));
+        row.area.assign(area_, std::min(area_length_, STRING_BUFFER_SIZE));
+        row.area_type = static_cast<AreaType>(area_type_);
+
+        decodeBlock(payload_.data(), payload_length_, row, start_time_, end_time_, staged_);
+        staged_start_ = block_start_;
+        has_staged_ = true;
+        return true;
+    }
+
+    ConnectionPool::Lease conn_;
+    MYSQL_STMT* stmt_ = nullptr;
+    bool failed_ = false;
+    time_t start_time_;
+    time_t end_time_;
+
+    char device_id_[STRING_BUFFER_SIZE];
+    unsigned long device_id_length_ = 0;
+    long long block_start_ = 0;
+    char area_[STRING_BUFFER_SIZE];
+    unsigned long area_length_ = 0;
+    int area_type_ = 0;
+    std::string payload_;
+    unsigned long payload_length_ = 0;
+    MYSQL_BIND binds_[5];
+
+    std::vector<SensorData> staged_;   // 已读取但属于下一个窗口的块
+    long long staged_start_ = 0;
+    bool has_staged_ = false;
+    std::vector<SensorData> window_;   // 当前窗口解码后的行
+    size_t index_ = 0;
+};
+
+// 封存过程中已编码完成、等待写入的块
+struct PendingBlock {
+    std::string device_id;
+    std::string area;
+    int area_type = 0;
+    long long start_timestamp = 0;
+    long long end_timestamp = 0;
+    int samples_count = 0;
+    std::string payload;
+};
+
+bool insertBlock(MySQLConnection& conn, const char* sql, PendingBlock& block) {
+    MYSQL_STMT* stmt = conn.statement(sql);
+    if (!stmt) {
+        return false;
+    }
+    
+    MYSQL_BIND params[7];
+    bindString(params[0], block.device_id);
+    bindLongLong(params[1], &block.start_timestamp);
+    bindLongLong(params[2], &block.end_timestamp);
+    bindInt(params[3], &block.samples_count);
+    bindString(params[4], block.area);
+    bindInt(params[5], &block.area_type);
+    bindString(params[6], block.payload);
+    params[6].buffer_type = MYSQL_TYPE_BLOB;
+    
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+        conn.checkError(stmt);
+        return false;
+    }
+    return true;
+}
+
+// 读取某个窗口已有的全部块，按设备保存未解码的负载
+bool loadWindowBlocks(MySQLConnection& conn, long long window_start,
+                      std::map<std::string, std::string>& payloads) {
+    char device_id[STRING_BUFFER_SIZE];
+    unsigned long device_id_length = 0;
+    std::string payload(INITIAL_BLOCK_SIZE, '\0');
+    unsigned long payload_length = 0;
+    MYSQL_BIND binds[2];
+    bindString(binds[0], device_id, STRING_BUFFER_SIZE, &device_id_length);
+    auto bind_payload = [&]() {
+        std::memset(&binds[1], 0, sizeof(binds[1]));
+        binds[1].buffer_type = MYSQL_TYPE_BLOB;
+        binds[1].buffer = payload.data();
+        binds[1].buffer_length = payload.size();
+        binds[1].length = &payload_length;
+    };
+    bind_payload();
+    
+    MYSQL_BIND params[1];
+    bindLongLong(params[0], &window_start);
+    if (!executeQuery(conn, SELECT_WINDOW_BLOCKS_SQL, params, binds)) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn.statement(SELECT_WINDOW_BLOCKS_SQL);
+    
+    int status;
+    while ((status = mysql_stmt_fetch(stmt)) == 0 || status == MYSQL_DATA_TRUNCATED) {
+        if (status == MYSQL_DATA_TRUNCATED && payload_length > payload.size()) {
+            payload.resize(payload_length);
+            bind_payload();
+            if (mysql_stmt_fetch_column(stmt, &binds[1], 1, 0) ||
+                mysql_stmt_bind_result(stmt, binds)) {
+                break;
+            }
+        }
+        payloads[std::string(device_id, std::min(device_id_length, STRING_BUFFER_SIZE))]
+            .assign(payload.data(), payload_length);
+    }
+    if (status != MYSQL_NO_DATA) {
+        conn.checkError(stmt);
+        mysql_stmt_free_result(stmt);
+        return false;
+    }
+    mysql_stmt_free_result(stmt);
+    return true;
+}
+
+// 草图查询的结果缓冲区，草图超过缓冲区时扩容后单独取回该列
+struct SketchRow {
+    char device_id[STRING_BUFFER_SIZE];
+    unsigned long device_id_length = 0;
+    long long bucket = 0;
+    std::string payload = std::string(INITIAL_SKETCH_SIZE, '\0');
+    unsigned long payload_length = 0;
+    MYSQL_BIND binds[3];
+
+    static constexpr size_t INITIAL_SKETCH_SIZE = 16 * 1024;
+
+    SketchRow() {
+        bindString(binds[0], device_id, STRING_BUFFER_SIZE, &device_id_length);
+        bindLongLong(binds[1], &bucket);
+        bindPayload();
+    }
+
+    void bindPayload() {
+        std::memset(&binds[2], 0, sizeof(binds[2]));
+        binds[2].buffer_type = MYSQL_TYPE_BLOB;
+        binds[2].buffer = payload.data();
+        binds[2].buffer_length = payload.size();
+        binds[2].length = &payload_length;
+    }
+
+    // 读取下一行，返回 1 表示有数据，0 表示结束，-1 表示出错
+    int fetch(MySQLConnection& conn, MYSQL_STMT* stmt) {
+        int status = mysql_stmt_fetch(stmt);
+        if (status == MYSQL_DATA_TRUNCATED && payload_length > payload.size()) {
+            payload.resize(payload_length);
+            bindPayload();
+            if (mysql_stmt_fetch_column(stmt, &binds[2], 2, 0) ||
+                mysql_stmt_bind_result(stmt, binds)) {
+                status = 1;
+            } else {
+                status = 0;
+            }
+        }
+        if (status == 0 || status == MYSQL_DATA_TRUNCATED) {
+            return 1;
+        }
+        if (status != MYSQL_NO_DATA) {
+            conn.checkError(stmt);
+            mysql_stmt_free_result(stmt);
+            return -1;
+        }
+        mysql_stmt_free_result(stmt);
+        return 0;
+    }
+
+    std::string deviceId() const {
+        return std::string(device_id, std::min(device_id_length, STRING_BUFFER_SIZE));
+    }
+};
+
+using SketchKey = std::pair<std::string, long long>;  // (设备ID, 桶起点)
+
+// 把按 (设备, 桶) 分组的草图写回聚合表中对应的行
+bool updateSketches(MySQLConnection& conn, const char* sql,
+                    const std::map<SketchKey, ChannelSketches>& groups) {
+    MYSQL_STMT* stmt = conn.statement(sql);
+    if (!stmt) {
+        return false;
+    }
+    for (const auto& [key, sketches] : groups) {
+        std::string payload = sketches.serialize();
+        long long bucket = key.second;
+        MYSQL_BIND params[3];
+        bindString(params[0], payload);
+        params[0].buffer_type = MYSQL_TYPE_BLOB;
+        bindString(params[1], key.first);
+        bindLongLong(params[2], &bucket);
+        if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+            conn.checkError(stmt);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 旧版本创建的聚合表没有 sketches 列，启动时补上
+bool ensureSketchColumn(MySQLConnection& conn, const std::string& table) {
+    MYSQL_STMT* stmt = conn.statement(SELECT_COLUMN_EXISTS_SQL);
+    if (!stmt) {
+        return false;
+    }
+    std::string column = "sketches";
+    long long exists = 0;
+    MYSQL_BIND params[2];
+    bindString(params[0], table);
+    bindString(params[1], column);
+    MYSQL_BIND result;
+    bindLongLong(result, &exists);
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, &result)) {
+        conn.checkError(stmt);
+        return false;
+    }
+    mysql_stmt_fetch(stmt);
+    mysql_stmt_free_result(stmt);
+    return exists > 0 || conn.query("ALTER TABLE " + table + " ADD COLUMN sketches MEDIUMBLOB NULL");
+}
+
+bool indexExists(MySQLConnection& conn, const std::string& table, const std::string& index,
+                 bool& exists) {
+    MYSQL_STMT* stmt = conn.statement(SELECT_INDEX_EXISTS_SQL);
+    if (!stmt) {
+        return false;
+    }
+    long long count = 0;
+    MYSQL_BIND params[2];
+    bindString(params[0], table);
+    bindString(params[1], index);
+    MYSQL_BIND result;
+    bindLongLong(result, &count);
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, &result)) {
+        conn.checkError(stmt);
+        return false;
+    }
+    mysql_stmt_fetch(stmt);
+    mysql_stmt_free_result(stmt);
+    exists = count > 0;
+    return true;
+}
+
+// 旧版本创建的聚合表没有 (设备, 桶) 唯一键：先删除重复聚合的行（保留最新的一行），
+// 再用唯一键替换原来的普通索引
+bool ensureBucketKey(MySQLConnection& conn, const std::string& table, const std::string& column,
+                     const std::string& key, const std::string& old_index) {
+    bool exists = false;
+    if (!indexExists(conn, table, key, exists)) {
+        return false;
+    }
+    if (exists) {
+        return true;
+    }
+    
+    std::cout << "[Database] Adding unique key " << key << " to " << table << std::endl;
+    bool has_old_index = false;
+    return conn.query("DELETE a FROM " + table + " a JOIN " + table + " b "
+                      "ON a.device_id = b.device_id AND a." + column + " = b." + column +
+                      " AND a.id < b.id") &&
+           indexExists(conn, table, old_index, has_old_index) &&
+           conn.query("ALTER TABLE " + table + " ADD UNIQUE KEY " + key +
+                      " (device_id, " + column + ")" +
+                      (has_old_index ? ", DROP INDEX " + old_index : std::string()));
+}
+
+// 满足条件的行的主键范围，没有满足条件的行时 lo > hi
+// condition 中的 ? 绑定为 bound，语句文本固定，每个连接只缓存一条
+bool selectIdRange(MySQLConnection& conn, const std::string& table,
+                   const std::string& condition, long long bound, long long& lo, long long& hi) {
+    std::string sql = "SELECT COALESCE(MIN(id), 1), COALESCE(MAX(id), 0) FROM " + table +
+                      " WHERE " + condition;
+    MYSQL_STMT* stmt = conn.statement(sql);
+    if (!stmt) {
+        return false;
+    }
+    MYSQL_BIND params[1];
+    bindLongLong(params[0], &bound);
+    MYSQL_BIND results[2];
+    bindLongLong(results[0], &lo);
+    bindLongLong(results[1], &hi);
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, results) || mysql_stmt_fetch(stmt)) {
+        conn.checkError(stmt);
+        mysql_stmt_free_result(stmt);
+        return false;
+    }
+    mysql_stmt_free_result(stmt);
+    return true;
+}
+
+} // namespace
 
 Database& Database::getInstance() {
     static Database instance("localhost", "monitor", "123456", "evm_db");
@@ -15,32 +787,28 @@ Database::Database(const std::string& host, const std::string& user,
     : host_(host)
     , user_(user)
     , password_(password)
-    , database_(database)
-    , conn_(nullptr) {
-    conn_ = mysql_init(nullptr);
-    if (!conn_) {
-        throw std::runtime_error("mysql_init() failed");
+    , database_(database) {
+    // 只读打开时只查询，写连接池保留一个连接即可
+    pool_ = std::make_unique<ConnectionPool>(host, user, password, database,
+                                             readOnly() ? 1 : CONNECTION_POOL_SIZE);
+    read_pool_ = std::make_unique<ConnectionPool>(host, user, password, database, READ_POOL_SIZE);
+    if (!readOnly()) {
+        initTables();
+        return;
     }
-
-    if (!mysql_real_connect(conn_, host.c_str(), user.c_str(),
-                          password.c_str(), database.c_str(), 0, nullptr, 0)) {
-        throw std::runtime_error(mysql_error(conn_));
+    auto conn = read_pool_->acquire();
+    if (conn) {
+        loadSealProgress(*conn);
     }
-
-    initTables();
 }
 
-Database::~Database() {
-    if (conn_) {
-        mysql_close(conn_);
-    }
-}
+Database::~Database() = default;
 
 bool Database::initTables() {
-    // 实时数据表
-    const char* create_realtime_table = R"(
+    // 实时数据表（与两张聚合表一样按时间 RANGE 分区，主键需包含分区列）
+    std::string create_realtime_table = R"(
         CREATE TABLE IF NOT EXISTS sensor_data_realtime (
-            id BIGINT AUTO_INCREMENT PRIMARY KEY,
+            id BIGINT AUTO_INCREMENT,
             device_id VARCHAR(50) NOT NULL,
             timestamp TIMESTAMP NOT NULL,
             temperature DOUBLE NOT NULL,
@@ -51,14 +819,15 @@ bool Database::initTables() {
             light DOUBLE NOT NULL,
             area VARCHAR(50) NOT NULL,
             area_type INT NOT NULL,
-            INDEX idx_device_time (device_id, timestamp)
-        )
-    )";
+            INDEX idx_device_time (device_id, timestamp),
+            INDEX idx_time (timestamp),
+            PRIMARY KEY (id, timestamp)
+        ) )" + realtime_partitions_.createClause();
 
     // 小时聚合数据表
-    const char* create_hourly_table = R"(
+    std::string create_hourly_table = R"(
         CREATE TABLE IF NOT EXISTS sensor_data_hourly (
-            id BIGINT AUTO_INCREMENT PRIMARY KEY,
+            id BIGINT AUTO_INCREMENT,
             device_id VARCHAR(50) NOT NULL,
             hour_timestamp TIMESTAMP NOT NULL,
             avg_temperature DOUBLE NOT NULL,
@@ -72,14 +841,15 @@ bool Database::initTables() {
             samples_count INT NOT NULL,
             area VARCHAR(50) NOT NULL,
             area_type INT NOT NULL,
-            INDEX idx_device_hour (device_id, hour_timestamp)
-        )
-    )";
+            sketches MEDIUMBLOB NULL,
+            UNIQUE KEY uk_device_hour (device_id, hour_timestamp),
+            PRIMARY KEY (id, hour_timestamp)
+        ) )" + hourly_partitions_.createClause();
 
     // 每日聚合数据表
-    const char* create_daily_table = R"(
+    std::string create_daily_table = R"(
         CREATE TABLE IF NOT EXISTS sensor_data_daily (
-            id BIGINT AUTO_INCREMENT PRIMARY KEY,
+            id BIGINT AUTO_INCREMENT,
             device_id VARCHAR(50) NOT NULL,
             date_timestamp TIMESTAMP NOT NULL,
             avg_temperature DOUBLE NOT NULL,
@@ -93,84 +863,112 @@ bool Database::initTables() {
             samples_count INT NOT NULL,
             area VARCHAR(50) NOT NULL,
             area_type INT NOT NULL,
-            INDEX idx_device_date (device_id, date_timestamp)
+            sketches MEDIUMBLOB NULL,
+            UNIQUE KEY uk_device_date (device_id, date_timestamp),
+            PRIMARY KEY (id, date_timestamp)
+        ) )" + daily_partitions_.createClause();
+
+    // 原始数据压缩块表：每个设备每小时一块，负载为 Gorilla 编码的时间戳和 6 个通道
+    const char* create_blocks_table = R"(
+        CREATE TABLE IF NOT EXISTS sensor_data_blocks (
+            id BIGINT AUTO_INCREMENT PRIMARY KEY,
+            device_id VARCHAR(50) NOT NULL,
+            start_timestamp BIGINT NOT NULL,
+            end_timestamp BIGINT NOT NULL,
+            samples_count INT NOT NULL,
+            area VARCHAR(50) NOT NULL,
+            area_type INT NOT NULL,
+            payload MEDIUMBLOB NOT NULL,
+            UNIQUE KEY uk_device_block (device_id, start_timestamp)
         )
     )";
 
-    return mysql_query(conn_, create_realtime_table) == 0 &&
-           mysql_query(conn_, create_hourly_table) == 0 &&
-           mysql_query(conn_, create_daily_table) == 0;
-}
+    // 维护任务水位表：记录每个任务已完成到的窗口终点
+    const char* create_watermarks_table = R"(
+        CREATE TABLE IF NOT EXISTS maintenance_watermarks (
+            task VARCHAR(50) PRIMARY KEY,
+            watermark BIGINT NOT NULL
+        )
+    )";
 
-bool Database::insertSensorData(const SensorData& data) {
-    std::stringstream sql;
-    sql << "INSERT INTO sensor_data_realtime "
-        << "(device_id, timestamp, temperature, humidity, co2, pm25, noise, light, area, area_type) "
-        << "VALUES ('" << data.device_id << "', "
-        << "FROM_UNIXTIME(" << data.timestamp << "), "
-        << data.temperature << ", "
-        << data.humidity << ", "
-        << data.co2 << ", "
-        << data.pm25 << ", "
-        << data.noise << ", "
-        << data.light << ", '"
-        << data.area << "', "
-        << static_cast<int>(data.area_type) << ")";
-        
-    bool success = mysql_query(conn_, sql.str().c_str()) == 0;
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    if (!conn->query(create_realtime_table) ||
+        !conn->query(create_hourly_table) ||
+        !conn->query(create_daily_table) ||
+        !conn->query(create_blocks_table) ||
+        !conn->query(create_watermarks_table) ||
+        !ensureSketchColumn(*conn, "sensor_data_hourly") ||
+        !ensureSketchColumn(*conn, "sensor_data_daily") ||
+        !ensureBucketKey(*conn, "sensor_data_hourly", "hour_timestamp", "uk_device_hour", "idx_device_hour") ||
+        !ensureBucketKey(*conn, "sensor_data_daily", "date_timestamp", "uk_device_date", "idx_device_date")) {
+        return false;
+    }
     
-    // 如果插入成功，检查是否需要进行数据聚合
-    if (success) {
-        time_t now = time(nullptr);
-        static time_t last_hourly_aggregate = 0;
-        static time_t last_daily_aggregate = 0;
-        
-        // 每小时聚合一次数据
-        if (now - last_hourly_aggregate >= 3600) {
-            aggregateHourlyData();
-            last_hourly_aggregate = now;
+    time_t now = time(nullptr);
+    for (PartitionManager* partitions : {&realtime_partitions_, &hourly_partitions_, &daily_partitions_}) {
+        if (!partitions->ensurePartitioned(*conn, now) || !partitions->precreate(*conn, now)) {
+            return false;
         }
-        
-        // 每天凌晨聚合一次数据
-        struct tm* tm = localtime(&now);
-        if (tm->tm_hour == 0 && tm->tm_min == 0 && now - last_daily_aggregate >= 86400) {
-            aggregateDailyData();
-            last_daily_aggregate = now;
+    }
+    return loadSealProgress(*conn);
+}
+
+bool Database::loadSealProgress(MySQLConnection& conn) {
+    // 恢复封存进度：最后一个块所在窗口之前的数据均已封存
+    long long last_block = 0;
+    MYSQL_BIND result;
+    bindLongLong(result, &last_block);
+    MYSQL_STMT* stmt = conn.statement(SELECT_SEALED_UNTIL_SQL);
+    if (!stmt || mysql_stmt_execute(stmt) || mysql_stmt_bind_result(stmt, &result)) {
+        if (stmt) {
+            conn.checkError(stmt);
         }
+        return false;
     }
-    
-    return success;
+    if (mysql_stmt_fetch(stmt) == 0 && last_block > 0) {
+        sealed_until_ = static_cast<time_t>(last_block) + BLOCK_SPAN_SECONDS;
+    }
+    mysql_stmt_free_result(stmt);
+    return true;
 }
 
-std::vector<SensorData> Database::getHistoryData(const std::string& device_id, 
-                                               time_t start_time, 
-                                               time_t end_time) {
-    time_t now = time(nullptr);
-    time_t oneDay = 24 * 3600;
-    time_t thirtyDays = 30 * oneDay;
-    
-    std::vector<SensorData> result;
-    
-    if (now - start_time <= oneDay) {
-        result = queryRealtimeData(device_id, start_time, end_time);
-    } else if (now - start_time <= thirtyDays) {
-        result = queryHourlyData(device_id, start_time, end_time);
-    } else {
-        result = queryDailyData(device_id, start_time, end_time);
+bool Database::insertSensorData(const SensorData& data) {
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
     }
-    
-    std::sort(result.begin(), result.end(), 
-        [](const SensorData& a, const SensorData& b) {
-            return a.timestamp < b.timestamp;
-        });
-    
-    return result;
+    return executeInsert(*conn, data);
 }
 
-bool Database::aggregateHourlyData() {
-    time_t now = time(nullptr);
-    time_t oneHourAgo = now - 3600;
+bool Database::batchInsertSensorData(const std::vector<SensorData>& data) {
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
     
+    // 每 MAX_BATCH_SIZE 条提交一次事务，复用同一条预处理语句
+    for (size_t offset = 0; offset < data.size(); offset += MAX_BATCH_SIZE) {
+        size_t end = std::min(data.size(), offset + static_cast<size_t>(MAX_BATCH_SIZE));
+        if (!conn->query("START TRANSACTION")) {
+            return false;
+        }
+        for (size_t i = offset; i < end; ++i) {
+            if (!executeInsert(*conn, data[i])) {
+                conn->query("ROLLBACK");
+                return false;
+            }
+        }
+        if (!conn->query("COMMIT")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Database::aggregateHourlyData(time_t window_start, time_t window_end) {
     std::stringstream sql;
     sql << "INSERT INTO sensor_data_hourly "
         << "(device_id, hour_timestamp, avg_temperature, avg_humidity, avg_co2, "
@@ -183,17 +981,23 @@ bool Database::aggregateHourlyData() {
         << "MAX(temperature), MIN(temperature), COUNT(*), "
         << "MAX(area), MAX(area_type) "
         << "FROM sensor_data_realtime "
-        << "WHERE timestamp >= FROM_UNIXTIME(" << oneHourAgo << ") "
-        << "AND timestamp < FROM_UNIXTIME(" << now << ") "
-        << "GROUP BY device_id, FROM_UNIXTIME(UNIX_TIMESTAMP(timestamp) - MOD(UNIX_TIMESTAMP(timestamp), 3600))";
+        << "WHERE timestamp >= FROM_UNIXTIME(" << window_start << ") "
+        << "AND timestamp < FROM_UNIXTIME(" << window_end << ") "
+        << "GROUP BY device_id, FROM_UNIXTIME(UNIX_TIMESTAMP(timestamp) - MOD(UNIX_TIMESTAMP(timestamp), 3600))"
+        << UPSERT_AGGREGATE_SUFFIX;
     
-    return mysql_query(conn_, sql.str().c_str()) == 0;
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    if (!conn->query(sql.str()) || !buildHourlySketches(*conn, window_start, window_end)) {
+        return false;
+    }
+    invalidateCached(ResultCache::HOURLY, window_start, window_end);
+    return true;
 }
 
-bool Database::aggregateDailyData() {
-    time_t now = time(nullptr);
-    time_t oneDayAgo = now - 24 * 3600;
-    
+bool Database::aggregateDailyData(time_t window_start, time_t window_end) {
     std::stringstream sql;
     sql << "INSERT INTO sensor_data_daily "
         << "(device_id, date_timestamp, avg_temperature, avg_humidity, avg_co2, "
@@ -206,170 +1010,504 @@ bool Database::aggregateDailyData() {
         << "MAX(max_temperature), MIN(min_temperature), SUM(samples_count), "
         << "MAX(area), MAX(area_type) "
         << "FROM sensor_data_hourly "
-        << "WHERE hour_timestamp >= FROM_UNIXTIME(" << oneDayAgo << ") "
-        << "AND hour_timestamp < FROM_UNIXTIME(" << now << ") "
-        << "GROUP BY device_id, DATE(hour_timestamp)";
+        << "WHERE hour_timestamp >= FROM_UNIXTIME(" << window_start << ") "
+        << "AND hour_timestamp < FROM_UNIXTIME(" << window_end << ") "
+        << "GROUP BY device_id, DATE(hour_timestamp)"
+        << UPSERT_AGGREGATE_SUFFIX;
     
-    return mysql_query(conn_, sql.str().c_str()) == 0;
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    if (!conn->query(sql.str()) || !buildDailySketches(*conn, window_start, window_end)) {
+        return false;
+    }
+    invalidateCached(ResultCache::DAILY, window_start, window_end);
+    return true;
 }
 
-bool Database::cleanupOldData() {
-    time_t now = time(nullptr);
+bool Database::loadWatermark(const std::string& task, time_t& watermark) {
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn->statement(SELECT_WATERMARK_SQL);
+    if (!stmt) {
+        return false;
+    }
+    long long value = 0;
+    MYSQL_BIND param;
+    bindString(param, task);
+    MYSQL_BIND result;
+    bindLongLong(result, &value);
+    if (mysql_stmt_bind_param(stmt, &param) || mysql_stmt_execute(stmt) ||
+        mysql_stmt_bind_result(stmt, &result)) {
+        conn->checkError(stmt);
+        return false;
+    }
+    if (mysql_stmt_fetch(stmt) == 0) {
+        watermark = static_cast<time_t>(value);
+    }
+    mysql_stmt_free_result(stmt);
+    return true;
+}
+
+bool Database::saveWatermark(const std::string& task, time_t watermark) {
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn->statement(UPSERT_WATERMARK_SQL);
+    if (!stmt) {
+        return false;
+    }
+    long long value = watermark;
+    MYSQL_BIND params[2];
+    bindString(params[0], task);
+    bindLongLong(params[1], &value);
+    if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+        conn->checkError(stmt);
+        return false;
+    }
+    return true;
+}
+
+bool Database::buildHourlySketches(MySQLConnection& conn, time_t start_time, time_t end_time) {
+    // 与小时聚合读取同一时间范围，覆盖本次聚合写入的行的草图
+    long long start = start_time;
+    long long end = end_time;
+    MYSQL_BIND params[2];
+    bindLongLong(params[0], &start);
+    bindLongLong(params[1], &end);
+    
+    RealtimeRow row;
+    if (!executeQuery(conn, SELECT_WINDOW_SQL, params, row.binds)) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn.statement(SELECT_WINDOW_SQL);
     
-    // 清理实时数据
-    std::stringstream sql1;
-    sql1 << "DELETE FROM sensor_data_realtime WHERE timestamp < FROM_UNIXTIME("
-         << (now - REALTIME_DATA_RETENTION_HOURS * 3600) << ")";
+    std::map<SketchKey, ChannelSketches> groups;
+    SensorData data;
+    int status;
+    while ((status = mysql_stmt_fetch(stmt)) == 0 || status == MYSQL_DATA_TRUNCATED) {
+        row.toSensorData(data);
+        groups[{data.device_id, data.timestamp - data.timestamp % 3600}].add(data);
+    }
+    if (status != MYSQL_NO_DATA) {
+        conn.checkError(stmt);
+        mysql_stmt_free_result(stmt);
+        return false;
+    }
+    mysql_stmt_free_result(stmt);
+    return updateSketches(conn, UPDATE_HOURLY_SKETCHES_SQL, groups);
+}
+
+bool Database::buildDailySketches(MySQLConnection& conn, time_t start_time, time_t end_time) {
+    long long start = start_time;
+    long long end = end_time;
+    MYSQL_BIND params[2];
+    bindLongLong(params[0], &start);
+    bindLongLong(params[1], &end);
     
-    // 清理小时数据
-    std::stringstream sql2;
-    sql2 << "DELETE FROM sensor_data_hourly WHERE hour_timestamp < FROM_UNIXTIME("
-         << (now - HOURLY_DATA_RETENTION_DAYS * 24 * 3600) << ")";
+    SketchRow row;
+    if (!executeQuery(conn, SELECT_DAY_SKETCHES_SQL, params, row.binds)) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn.statement(SELECT_DAY_SKETCHES_SQL);
     
-    // 清理每日数据
-    std::stringstream sql3;
-    sql3 << "DELETE FROM sensor_data_daily WHERE date_timestamp < DATE_SUB(CURDATE(), "
-         << "INTERVAL " << DAILY_DATA_RETENTION_DAYS << " DAY)";
+    std::map<SketchKey, ChannelSketches> groups;
+    ChannelSketches hourly;
+    int status;
+    while ((status = row.fetch(conn, stmt)) > 0) {
+        if (hourly.deserialize(row.payload.data(), row.payload_length)) {
+            groups[{row.deviceId(), row.bucket}].merge(hourly);
+        }
+    }
+    return status == 0 && updateSketches(conn, UPDATE_DAILY_SKETCHES_SQL, groups);
+}
+
+bool Database::mergeSketches(DataTier tier,
+                             const std::vector<std::string>& device_ids,
+                             time_t start_time,
+                             time_t end_time,
+                             ChannelSketches& sketches) {
+    if (tier == DataTier::REALTIME) {
+        return false;
+    }
+    if (device_ids.empty()) {
+        return true;
+    }
     
-    return mysql_query(conn_, sql1.str().c_str()) == 0 &&
-           mysql_query(conn_, sql2.str().c_str()) == 0 &&
-           mysql_query(conn_, sql3.str().c_str()) == 0;
+    auto conn = read_pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    std::string query = withDeviceList(tier == DataTier::HOURLY ? SELECT_HOURLY_SKETCHES_SQL
+                                                                : SELECT_DAILY_SKETCHES_SQL,
+                                       device_ids.size());
+    SketchRow row;
+    if (!executeRangeQuery(*conn, query, device_ids, start_time, end_time, row.binds)) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn->statement(query);
+    
+    ChannelSketches bucket;
+    int status;
+    while ((status = row.fetch(*conn, stmt)) > 0) {
+        if (bucket.deserialize(row.payload.data(), row.payload_length)) {
+            sketches.merge(bucket);
+        }
+    }
+    return status == 0;
 }
 
-std::vector<SensorData> Database::queryRealtimeData(const std::string& device_id, 
-                                                  time_t start_time, 
-                                                  time_t end_time) {
-    std::stringstream sql;
-    // 获取当前时间
+bool Database::cleanupOldData() {
     time_t now = time(nullptr);
-    // 计算查询的时间范围
-    time_t query_start = now - (end_time - start_time);
-    time_t query_end = now;
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
     
-    sql << "SELECT UNIX_TIMESTAMP(timestamp) as ts, device_id, timestamp, "
-        << "temperature, humidity, co2, pm25, noise, light, area, area_type "
-        << "FROM sensor_data_realtime "
-        << "WHERE device_id = '" << device_id << "' "
-        << "AND timestamp BETWEEN FROM_UNIXTIME(" << query_start << ") "
-        << "AND FROM_UNIXTIME(" << query_end << ") "
-        << "ORDER BY timestamp ASC";
+    // 分区表按整个分区删除，实时数据只删除已封存为压缩块的部分
+    bool success = realtime_partitions_.precreate(*conn, now) &&
+                   hourly_partitions_.precreate(*conn, now) &&
+                   daily_partitions_.precreate(*conn, now);
+    success = realtime_partitions_.dropBefore(*conn, dropBoundary(now)) && success;
+    success = hourly_partitions_.dropBefore(*conn, now - HOURLY_DATA_RETENTION_DAYS * 24 * 3600) && success;
+    success = daily_partitions_.dropBefore(*conn, now - DAILY_DATA_RETENTION_DAYS * 24 * 3600) && success;
+    
+    // 压缩块表按设备和窗口唯一，不分区，分块删除；截止时间作为参数绑定，语句文本不随运行变化
+    success = deleteInChunks(*conn, "sensor_data_blocks", "start_timestamp < ?",
+                             now - RAW_BLOCK_RETENTION_DAYS * 24 * 3600) && success;
+    
+    invalidateCached(ResultCache::HOURLY, 0, now - HOURLY_DATA_RETENTION_DAYS * 24 * 3600);
+    invalidateCached(ResultCache::DAILY, 0, now - DAILY_DATA_RETENTION_DAYS * 24 * 3600);
+    return success;
+}
+
+bool Database::deleteInChunks(MySQLConnection& conn, const std::string& table,
+                              const std::string& condition, long long bound) {
+    long long lo = 0;
+    long long hi = 0;
+    if (!selectIdRange(conn, table, condition, bound, lo, hi)) {
+        return false;
+    }
+    std::string sql = "DELETE FROM " + table + " WHERE id >= ? AND id < ? AND " + condition;
+    
+    // 每块单独提交，锁只持有一块的时间；块大小按耗时自适应，
+    // 块间休眠使删除速率不超过上限，且至少让出与删除同样长的时间给写入
+    long long chunk = DELETE_CHUNK_INITIAL_IDS;
+    unsigned long long total = 0;
+    for (long long start = lo; start <= hi; start += chunk) {
+        long long end = std::min(start + chunk, hi + 1);
+        MYSQL_STMT* stmt = conn.statement(sql);
+        if (!stmt) {
+            return false;
+        }
+        MYSQL_BIND params[3];
+        bindLongLong(params[0], &start);
+        bindLongLong(params[1], &end);
+        bindLongLong(params[2], &bound);
         
-    std::cout << "Executing SQL: " << sql.str() << std::endl;
+        auto began = std::chrono::steady_clock::now();
+        if (mysql_stmt_bind_param(stmt, params) || mysql_stmt_execute(stmt)) {
+            conn.checkError(stmt);
+            return false;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - began;
+        unsigned long long deleted = mysql_stmt_affected_rows(stmt);
+        total += deleted;
         
-    std::vector<SensorData> result;
-    if (mysql_query(conn_, sql.str().c_str()) == 0) {
-        MYSQL_RES* res = mysql_store_result(conn_);
-        if (res) {
-            MYSQL_ROW row;
-            int row_count = 0;
-            while ((row = mysql_fetch_row(res))) {
-                SensorData data;
-                data.timestamp = std::stoll(row[0]);  // ts
-                data.device_id = row[1];              // device_id
-                data.temperature = std::stof(row[3]); // temperature
-                data.humidity = std::stof(row[4]);    // humidity
-                data.co2 = std::stof(row[5]);        // co2
-                data.pm25 = std::stof(row[6]);       // pm25
-                data.noise = std::stof(row[7]);      // noise
-                data.light = std::stof(row[8]);      // light
-                data.area = row[9];                  // area
-                data.area_type = static_cast<AreaType>(std::stoi(row[10])); // area_type
-                result.push_back(data);
-                row_count++;
-            }
-            mysql_free_result(res);
-            std::cout << "Found " << row_count << " rows" << std::endl;
+        if (elapsed > DELETE_CHUNK_BUDGET) {
+            chunk = std::max(DELETE_CHUNK_MIN_IDS, chunk / 2);
+        } else if (elapsed < DELETE_CHUNK_BUDGET / 4) {
+            chunk = std::min(DELETE_CHUNK_MAX_IDS, chunk * 2);
         }
-    } else {
-        std::cerr << "MySQL query error: " << mysql_error(conn_) << std::endl;
+        
+        auto rate_limited = std::chrono::microseconds(deleted * 1000000 / DELETE_ROWS_PER_SECOND);
+        std::this_thread::sleep_for(std::max<std::chrono::steady_clock::duration>(
+            elapsed, rate_limited - elapsed));
     }
-    return result;
+    
+    if (total > 0) {
+        std::cout << "[Database] Deleted " << total << " expired rows from " << table << std::endl;
+    }
+    return true;
 }
 
-std::vector<SensorData> Database::queryHourlyData(const std::string& device_id, 
-                                                time_t start_time, 
-                                                time_t end_time) {
-    std::stringstream sql;
-    sql << "SELECT UNIX_TIMESTAMP(hour_timestamp) as ts, * FROM sensor_data_hourly "
-        << "WHERE device_id = '" << device_id << "' "
-        << "AND hour_timestamp BETWEEN FROM_UNIXTIME(" << start_time << ") "
-        << "AND FROM_UNIXTIME(" << end_time << ") "
-        << "ORDER BY hour_timestamp ASC";
-        
-    std::vector<SensorData> result;
-    if (mysql_query(conn_, sql.str().c_str()) == 0) {
-        MYSQL_RES* res = mysql_store_result(conn_);
-        if (res) {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res))) {
-                SensorData data;
-                data.timestamp = std::stoll(row[0]);  // 使用 UNIX_TIMESTAMP 的结果
-                data.device_id = row[2];
-                data.temperature = std::stof(row[4]);  // avg_temperature
-                data.humidity = std::stof(row[5]);     // avg_humidity
-                data.co2 = std::stof(row[6]);         // avg_co2
-                data.pm25 = std::stof(row[7]);        // avg_pm25
-                data.noise = std::stof(row[8]);       // avg_noise
-                data.light = std::stof(row[9]);       // avg_light
-                data.area = row[13];
-                data.area_type = static_cast<AreaType>(std::stoi(row[14]));
-                
-                // 设置聚合数据标记
-                data.has_aggregated_data = true;
-                data.is_hourly = true;
-                data.has_min_max = true;
-                data.max_temperature = std::stof(row[10]);  // max_temperature
-                data.min_temperature = std::stof(row[11]);  // min_temperature
-                data.samples_count = std::stoi(row[12]);    // samples_count
-                
-                result.push_back(data);
+bool Database::sealRawBlocks() {
+    std::lock_guard<std::mutex> lock(seal_mutex_);
+    
+    time_t now = time(nullptr);
+    time_t window = sealed_until_.load();
+    if (window == 0) {
+        // 首次封存从实时表保留期的起点开始
+        window = now - REALTIME_DATA_RETENTION_HOURS * 3600;
+        window -= window % BLOCK_SPAN_SECONDS;
+    }
+    
+    auto conn = pool_->acquire();
+    if (!conn) {
+        return false;
+    }
+    
+    // 先重新封存收到迟到数据的窗口，最近仍有迟到数据的窗口等写入落库后再处理
+    std::vector<time_t> dirty;
+    {
+        std::lock_guard<std::mutex> dirty_lock(dirty_windows_mutex_);
+        for (auto it = dirty_windows_.begin(); it != dirty_windows_.end();) {
+            if (it->second < now - SEAL_DELAY_SECONDS) {
+                dirty.push_back(it->first);
+                it = dirty_windows_.erase(it);
+            } else {
+                ++it;
             }
-            mysql_free_result(res);
         }
     }
-    return result;
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        if (!sealWindow(*conn, dirty[i], true)) {
+            // 失败的窗口放回，下次维护时重试，期间其实时分区不会被删除
+            std::lock_guard<std::mutex> dirty_lock(dirty_windows_mutex_);
+            for (; i < dirty.size(); ++i) {
+                dirty_windows_.emplace(dirty[i], 0);
+            }
+            return false;
+        }
+    }
+    
+    for (; window + BLOCK_SPAN_SECONDS + SEAL_DELAY_SECONDS <= now; window += BLOCK_SPAN_SECONDS) {
+        if (!sealWindow(*conn, window, false)) {
+            return false;
+        }
+        sealed_until_ = window + BLOCK_SPAN_SECONDS;
+    }
+    return true;
 }
 
-std::vector<SensorData> Database::queryDailyData(const std::string& device_id, 
-                                               time_t start_time, 
-                                               time_t end_time) {
-    std::stringstream sql;
-    sql << "SELECT UNIX_TIMESTAMP(date_timestamp) as ts, * FROM sensor_data_daily "
-        << "WHERE device_id = '" << device_id << "' "
-        << "AND date_timestamp BETWEEN FROM_UNIXTIME(" << start_time << ") "
-        << "AND FROM_UNIXTIME(" << end_time << ") "
-        << "ORDER BY date_timestamp ASC";
-        
-    std::vector<SensorData> result;
-    if (mysql_query(conn_, sql.str().c_str()) == 0) {
-        MYSQL_RES* res = mysql_store_result(conn_);
-        if (res) {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(res))) {
-                SensorData data;
-                data.timestamp = std::stoll(row[0]);  // 使用 UNIX_TIMESTAMP 的结果
-                data.device_id = row[2];
-                data.temperature = std::stof(row[4]);  // avg_temperature
-                data.humidity = std::stof(row[5]);     // avg_humidity
-                data.co2 = std::stof(row[6]);         // avg_co2
-                data.pm25 = std::stof(row[7]);        // avg_pm25
-                data.noise = std::stof(row[8]);       // avg_noise
-                data.light = std::stof(row[9]);       // avg_light
-                data.area = row[13];
-                data.area_type = static_cast<AreaType>(std::stoi(row[14]));
-                
-                // 设置聚合数据标记
-                data.has_aggregated_data = true;
-                data.is_hourly = false;  // 这是每日数据
-                data.has_min_max = true;
-                data.max_temperature = std::stof(row[10]);
-                data.min_temperature = std::stof(row[11]);
-                data.samples_count = std::stoi(row[12]);
-                
-                result.push_back(data);
+bool Database::sealWindow(MySQLConnection& conn, time_t window_start, bool reseal) {
+    long long start = window_start;
+    long long end = window_start + BLOCK_SPAN_SECONDS;
+    
+    // 重新封存时先取出已有的块与实时表合并，所在分区已被删除的行仍保留在新块中
+    std::map<std::string, std::string> existing;
+    if (reseal && !loadWindowBlocks(conn, start, existing)) {
+        return false;
+    }
+    
+    MYSQL_BIND params[2];
+    bindLongLong(params[0], &start);
+    bindLongLong(params[1], &end);
+    
+    // 结果按设备、时间排序，同一时间只缓存一个设备的行
+    RealtimeRow row;
+    if (!executeQuery(conn, SELECT_WINDOW_SQL, params, row.binds)) {
+        return false;
+    }
+    MYSQL_STMT* stmt = conn.statement(SELECT_WINDOW_SQL);
+    
+    std::vector<PendingBlock> blocks;
+    std::vector<SensorData> rows;
+    auto seal_current = [&]() {
+        if (rows.empty()) {
+            return;
+        }
+        auto it = existing.find(rows.front().device_id);
+        if (it != existing.end()) {
+            // 旧块与实时表中时间相同的行以实时表为准
+            std::vector<SensorData> sealed;
+            decodeBlock(it->second.data(), it->second.size(), rows.front(), start, end - 1, sealed);
+            std::vector<SensorData> merged;
+            merged.reserve(rows.size() + sealed.size());
+            size_t i = 0;
+            for (auto& old_row : sealed) {
+                while (i < rows.size() && rows[i].timestamp < old_row.timestamp) {
+                    merged.push_back(std::move(rows[i++]));
+                }
+                if (i < rows.size() && rows[i].timestamp == old_row.timestamp) {
+                    continue;
+                }
+                merged.push_back(std::move(old_row));
             }
-            mysql_free_result(res);
+            std::move(rows.begin() + i, rows.end(), std::back_inserter(merged));
+            rows.swap(merged);
         }
+        
+        GorillaEncoder encoder;
+        for (const auto& data : rows) {
+            double values[GorillaEncoder::CHANNELS] = {data.temperature, data.humidity, data.co2,
+                                                       data.pm25, data.noise, data.light};
+            encoder.append(data.timestamp, values);
+        }
+        PendingBlock& block = blocks.back();
+        block.end_timestamp = encoder.lastTimestamp();
+        block.samples_count = static_cast<int>(encoder.count());
+        block.payload = encoder.finish();
+        rows.clear();
+    };
+    
+    SensorData data;
+    int status;
+    while ((status = mysql_stmt_fetch(stmt)) == 0 || status == MYSQL_DATA_TRUNCATED) {
+        row.toSensorData(data);
+        if (blocks.empty() || blocks.back().device_id != data.device_id) {
+            seal_current();
+            PendingBlock block;
+            block.device_id = data.device_id;
+            block.area = data.area;
+            block.area_type = static_cast<int>(data.area_type);
+            block.start_timestamp = start;
+            blocks.push_back(std::move(block));
+        }
+        rows.push_back(data);
     }
-    return result;
-} 
\ No newline at end of file
+    if (status != MYSQL_NO_DATA) {
+        conn.checkError(stmt);
+        mysql_stmt_free_result(stmt);
+        return false;
+    }
+    mysql_stmt_free_result(stmt);
+    seal_current();
+    
+    if (blocks.empty()) {
+        return true;
+    }
+    
+    // 同一窗口的块在一个事务内写入；首次封存重复执行时由唯一键忽略，重新封存覆盖旧块
+    if (!conn.query("START TRANSACTION")) {
+        return false;
+    }
+    for (auto& block : blocks) {
+        if (!insertBlock(conn, reseal ? UPSERT_BLOCK_SQL : INSERT_BLOCK_SQL, block)) {
+            conn.query("ROLLBACK");
+            return false;
+        }
+    }
+    if (!conn.query("COMMIT")) {
+        return false;
+    }
+    
+    std::cout << "[Database] " << (reseal ? "Resealed " : "Sealed ") << blocks.size()
+              << " raw blocks for window " << window_start << std::endl;
+    return true;
+}
+
+time_t Database::realtimeBoundary(time_t now) const {
+    // 实时表保留期之前且已封存的数据从压缩块读取，此后的数据从实时表读取
+    time_t boundary = now - REALTIME_DATA_RETENTION_HOURS * 3600;
+    boundary -= boundary % BLOCK_SPAN_SECONDS;
+    return std::min(boundary, sealed_until_.load());
+}
+
+time_t Database::dropBoundary(time_t now) {
+    // 迟到数据尚未并入压缩块的窗口，其所在分区及之后的分区都保留
+    time_t boundary = realtimeBoundary(now);
+    std::lock_guard<std::mutex> lock(dirty_windows_mutex_);
+    if (!dirty_windows_.empty()) {
+        boundary = std::min(boundary, dirty_windows_.begin()->first);
+    }
+    return boundary;
+}
+
+void Database::noteRawIngested(time_t timestamp) {
+    // 窗口已过封存时间即可能已封存，迟到的行需要重新封存才能进入压缩块
+    time_t window = timestamp - timestamp % BLOCK_SPAN_SECONDS;
+    time_t now = time(nullptr);
+    if (window + BLOCK_SPAN_SECONDS + SEAL_DELAY_SECONDS > now) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(dirty_windows_mutex_);
+    dirty_windows_[window] = now;
+}
+
+std::unique_ptr<RowCursor> Database::openRealtimeCursor(const std::string& device_id,
+                                                        time_t start_time,
+                                                        time_t end_time) {
+    return openDevicesCursor(DataTier::REALTIME, {device_id}, start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> Database::openHourlyCursor(const std::string& device_id,
+                                                      time_t start_time,
+                                                      time_t end_time) {
+    return openDevicesCursor(DataTier::HOURLY, {device_id}, start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> Database::openDailyCursor(const std::string& device_id,
+                                                     time_t start_time,
+                                                     time_t end_time) {
+    return openDevicesCursor(DataTier::DAILY, {device_id}, start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> Database::openDevicesCursor(DataTier tier,
+                                                       const std::vector<std::string>& device_ids,
+                                                       time_t start_time,
+                                                       time_t end_time) {
+    return openCursor(tier, device_ids, start_time, end_time, [this]() {
+        return read_pool_->acquire();
+    });
+}
+
+std::unique_ptr<RowCursor> Database::openExportCursor(DataTier tier,
+                                                      const std::vector<std::string>& device_ids,
+                                                      time_t start_time,
+                                                      time_t end_time) {
+    if (active_exports_.fetch_add(1) >= MAX_CONCURRENT_EXPORTS) {
+        --active_exports_;
+        return nullptr;
+    }
+    
+    // 导出名额随专用连接一起释放；连接失败时游标报告失败
+    std::shared_ptr<MySQLConnection> conn;
+    try {
+        conn = std::shared_ptr<MySQLConnection>(
+            new MySQLConnection(host_, user_, password_, database_),
+            [this](MySQLConnection* c) {
+                delete c;
+                --active_exports_;
+            });
+    } catch (const std::exception& e) {
+        --active_exports_;
+        std::cerr << "[Database] Export connection failed: " << e.what() << std::endl;
+        return std::make_unique<FailedCursor>();
+    }
+    return openCursor(tier, device_ids, start_time, end_time, [conn]() {
+        return ConnectionPool::Lease(conn);
+    });
+}
+
+std::unique_ptr<RowCursor> Database::openCursor(DataTier tier,
+                                                const std::vector<std::string>& device_ids,
+                                                time_t start_time,
+                                                time_t end_time,
+                                                const std::function<ConnectionPool::Lease()>& acquire) {
+    if (device_ids.empty()) {
+        return std::make_unique<VectorCursor>();
+    }
+    if (tier == DataTier::HOURLY) {
+        return std::make_unique<StatementCursor<AggregateRow>>(
+            acquire(), SELECT_HOURLY_SQL, device_ids, start_time, end_time, true);
+    }
+    if (tier == DataTier::DAILY) {
+        return std::make_unique<StatementCursor<AggregateRow>>(
+            acquire(), SELECT_DAILY_SQL, device_ids, start_time, end_time, false);
+    }
+    
+    time_t boundary = realtimeBoundary(time(nullptr));
+    if (start_time >= boundary) {
+        return std::make_unique<StatementCursor<RealtimeRow>>(
+            acquire(), SELECT_REALTIME_SQL, device_ids, start_time, end_time);
+    }
+    
+    // 较早的部分从压缩块解码，两段依次打开，不会同时占用两个连接
+    std::vector<ChainCursor::Factory> parts;
+    parts.push_back([acquire, device_ids, start_time, end_time, boundary]() -> std::unique_ptr<RowCursor> {
+        return std::make_unique<BlockCursor>(acquire(), device_ids, start_time,
+                                             std::min(end_time, boundary - 1));
+    });
+    if (end_time >= boundary) {
+        parts.push_back([acquire, device_ids, boundary, end_time]() -> std::unique_ptr<RowCursor> {
+            return std::make_unique<StatementCursor<RealtimeRow>>(
+                acquire(), SELECT_REALTIME_SQL, device_ids, boundary, end_time);
+        });
+    }
+    return std::make_unique<ChainCursor>(std::move(parts));
+}
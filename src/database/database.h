@@ -1,57 +1,132 @@
 #pragma once
-#include <mysql/mysql.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "../models/sensor_data.h"
+#include "mysql_connection.h"
+#include "partition_manager.h"
+#include "row_cursor.h"
+#include "storage.h"
 
-class Database {
+// MySQL 存储后端
+class Database : public Storage {
 public:
     static Database& getInstance();
     
-    // 数据插入
-    bool insertSensorData(const SensorData& data);
-    bool batchInsertSensorData(const std::vector<SensorData>& data);
+    ConnectionInfo connectionInfo() const { return {host_, user_, password_, database_}; }
     
-    // 数据查询
-    std::vector<SensorData> getHistoryData(const std::string& device_id, 
-                                         time_t start_time, 
-                                         time_t end_time);
+    // 数据插入
+    bool insertSensorData(const SensorData& data) override;
+    bool batchInsertSensorData(const std::vector<SensorData>& data) override;
     
     // 数据维护
-    bool aggregateHourlyData();
-    bool aggregateDailyData();
-    bool cleanupOldData();
-    
-    // 将查询方法移到 public 区域
-    std::vector<SensorData> queryRealtimeData(const std::string& device_id,
-                                            time_t start_time,
-                                            time_t end_time);
-    std::vector<SensorData> queryHourlyData(const std::string& device_id,
-                                          time_t start_time,
-                                          time_t end_time);
-    std::vector<SensorData> queryDailyData(const std::string& device_id,
-                                         time_t start_time,
-                                         time_t end_time);
+    bool aggregateHourlyData(time_t window_start, time_t window_end) override;
+    bool aggregateDailyData(time_t window_start, time_t window_end) override;
+    
+    // 过期数据按分区整体删除，压缩块表按主键范围分块删除
+    bool cleanupOldData() override;
+    
+    bool loadWatermark(const std::string& task, time_t& watermark) override;
+    bool saveWatermark(const std::string& task, time_t watermark) override;
+    
+    // 把已结束的小时窗口按设备封存为 Gorilla 压缩块，
+    // 超过实时表保留期的原始数据从压缩块中读取
+    bool sealRawBlocks() override;
+    
+    // 小时/每日聚合行的 sketches 列保存 6 个通道的 DDSketch，按范围合并后求分位数
+    bool hasSketches() const override { return true; }
+    bool mergeSketches(DataTier tier,
+                       const std::vector<std::string>& device_ids,
+                       time_t start_time,
+                       time_t end_time,
+                       ChannelSketches& sketches) override;
+    
+    // 流式查询：游标存活期间占用读连接池中的一个连接，逐行从服务端读取。
+    // 读连接池与写入、维护使用的连接池分开，慢客户端拖住的查询不会阻塞入库
+    std::unique_ptr<RowCursor> openRealtimeCursor(const std::string& device_id,
+                                                  time_t start_time,
+                                                  time_t end_time) override;
+    std::unique_ptr<RowCursor> openHourlyCursor(const std::string& device_id,
+                                                time_t start_time,
+                                                time_t end_time) override;
+    std::unique_ptr<RowCursor> openDailyCursor(const std::string& device_id,
+                                               time_t start_time,
+                                               time_t end_time) override;
+    
+    // 多设备查询合并为一条 IN 查询
+    std::unique_ptr<RowCursor> openDevicesCursor(DataTier tier,
+                                                 const std::vector<std::string>& device_ids,
+                                                 time_t start_time,
+                                                 time_t end_time) override;
+    
+    // 每个导出新建一条专用连接，导出结束时关闭
+    std::unique_ptr<RowCursor> openExportCursor(DataTier tier,
+                                                const std::vector<std::string>& device_ids,
+                                                time_t start_time,
+                                                time_t end_time) override;
 
 private:
     Database(const std::string& host, const std::string& user,
             const std::string& password, const std::string& database);
-    ~Database();
+    ~Database() override;
     
     // 禁止拷贝
     Database(const Database&) = delete;
     Database& operator=(const Database&) = delete;
     
     bool initTables();
-    MYSQL* conn_;
+    bool loadSealProgress(MySQLConnection& conn);
+    std::unique_ptr<RowCursor> openCursor(DataTier tier,
+                                          const std::vector<std::string>& device_ids,
+                                          time_t start_time,
+                                          time_t end_time,
+                                          const std::function<ConnectionPool::Lease()>& acquire);
+    // 读数所在窗口可能已封存时记为脏窗口，下次封存时重新封存，封存前不删除其实时分区
+    void noteRawIngested(time_t timestamp) override;
+    // reseal 为 true 时与窗口已有的块合并后覆盖写入
+    bool sealWindow(MySQLConnection& conn, time_t window_start, bool reseal);
+    bool buildHourlySketches(MySQLConnection& conn, time_t start_time, time_t end_time);
+    bool buildDailySketches(MySQLConnection& conn, time_t start_time, time_t end_time);
+    time_t realtimeBoundary(time_t now) const;
+    time_t dropBoundary(time_t now);
+    // condition 含一个 ? 占位符，绑定为 bound
+    bool deleteInChunks(MySQLConnection& conn, const std::string& table,
+                        const std::string& condition, long long bound);
+    
+    std::unique_ptr<ConnectionPool> pool_;       // 写入和维护
+    std::unique_ptr<ConnectionPool> read_pool_;  // 查询游标和草图合并
     std::string host_;
     std::string user_;
     std::string password_;
     std::string database_;
     
-    static constexpr int REALTIME_DATA_RETENTION_HOURS = 24;
-    static constexpr int HOURLY_DATA_RETENTION_DAYS = 30;
-    static constexpr int DAILY_DATA_RETENTION_DAYS = 365;
-    static constexpr int MAX_BATCH_SIZE = 1000;
-}; 
\ No newline at end of file
+    // 实时表按天分区，聚合表按月分区，均预先创建未来的分区
+    PartitionManager realtime_partitions_{"sensor_data_realtime", "timestamp", PartitionManager::DAILY, 7};
+    PartitionManager hourly_partitions_{"sensor_data_hourly", "hour_timestamp", PartitionManager::MONTHLY, 2};
+    PartitionManager daily_partitions_{"sensor_data_daily", "date_timestamp", PartitionManager::MONTHLY, 2};
+    
+    std::mutex seal_mutex_;
+    std::atomic<time_t> sealed_until_{0};  // 此时间之前的原始数据已全部封存为压缩块
+    std::mutex dirty_windows_mutex_;
+    std::map<time_t, time_t> dirty_windows_;  // 收到迟到数据的窗口起点 -> 最近一次标记的时间
+    std::atomic<int> active_exports_{0};
+    
+    static constexpr size_t CONNECTION_POOL_SIZE = 4;
+    static constexpr size_t READ_POOL_SIZE = 4;
+    static constexpr int MAX_CONCURRENT_EXPORTS = 2;
+    static constexpr time_t BLOCK_SPAN_SECONDS = 3600;
+    static constexpr time_t SEAL_DELAY_SECONDS = 300;    // 窗口结束后等待迟到数据的时间
+    static constexpr int RAW_BLOCK_RETENTION_DAYS = 90;
+    
+    // 分块删除：块大小以主键跨度计，按单块耗时在上下限之间自适应
+    static constexpr long long DELETE_CHUNK_INITIAL_IDS = 5000;
+    static constexpr long long DELETE_CHUNK_MIN_IDS = 500;
+    static constexpr long long DELETE_CHUNK_MAX_IDS = 100000;
+    static constexpr std::chrono::milliseconds DELETE_CHUNK_BUDGET{50};
+    static constexpr unsigned long long DELETE_ROWS_PER_SECOND = 20000;
+};
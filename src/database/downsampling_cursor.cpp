@@ -0,0 +1,199 @@
+#include "downsampling_cursor.h"
+#include <algorithm>
+#include <cmath>
+
+DownsamplingCursor::DownsamplingCursor(std::unique_ptr<RowCursor> source, time_t start_time,
+                                       time_t end_time, size_t max_points, Mode mode,
+                                       double SensorData::*field)
+    : source_(std::move(source))
+    , mode_(mode)
+    , field_(field)
+    , start_time_(start_time) {
+    // LTTB 的首尾两点不占用桶，MINMAX 每个桶最多输出两行
+    size_t buckets = mode == Mode::LTTB ? std::max(max_points, MIN_POINTS) - 2
+                                        : std::max<size_t>(max_points / 2, 1);
+    time_t span = std::max<time_t>(end_time - start_time + 1, 1);
+    bucket_width_ = std::max<time_t>((span + static_cast<time_t>(buckets) - 1) /
+                                     static_cast<time_t>(buckets), 1);
+}
+
+bool DownsamplingCursor::parseMode(const std::string& name, Mode& mode) {
+    if (name == "lttb") {
+        mode = Mode::LTTB;
+    } else if (name == "minmax") {
+        mode = Mode::MINMAX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool DownsamplingCursor::parseField(const std::string& name, double SensorData::*& field) {
+    if (name == "temperature") {
+        field = &SensorData::temperature;
+    } else if (name == "humidity") {
+        field = &SensorData::humidity;
+    } else if (name == "co2") {
+        field = &SensorData::co2;
+    } else if (name == "pm25") {
+        field = &SensorData::pm25;
+    } else if (name == "noise") {
+        field = &SensorData::noise;
+    } else if (name == "light") {
+        field = &SensorData::light;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool DownsamplingCursor::next(SensorData& row) {
+    SensorData input;
+    while (ready_.empty() && !source_done_) {
+        if (source_->next(input)) {
+            add(std::move(input));
+        } else {
+            source_done_ = true;
+            finish();
+        }
+    }
+    if (ready_.empty()) {
+        return false;
+    }
+    row = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
+
+long long DownsamplingCursor::bucketIndex(time_t timestamp) const {
+    return static_cast<long long>((timestamp - start_time_) / bucket_width_);
+}
+
+void DownsamplingCursor::emit(const SensorData& row) {
+    ready_.push_back(row);
+}
+
+void DownsamplingCursor::add(SensorData row) {
+    long long index = bucketIndex(row.timestamp);
+
+    if (mode_ == Mode::MINMAX) {
+        if (index != minmax_index_) {
+            finish();
+            minmax_index_ = index;
+            min_row_ = row;
+            max_row_ = std::move(row);
+            return;
+        }
+        if (row.*field_ < min_row_.*field_) {
+            min_row_ = row;
+        }
+        if (row.*field_ > max_row_.*field_) {
+            max_row_ = std::move(row);
+        }
+        return;
+    }
+
+    // 第一行原样输出，作为第一个三角形的顶点
+    if (!has_anchor_) {
+        has_anchor_ = true;
+        anchor_ = row;
+        emit(row);
+        return;
+    }
+
+    if (current_.rows.empty() || index == current_.index) {
+        current_.index = index;
+        current_.rows.push_back(std::move(row));
+        return;
+    }
+    if (pending_.rows.empty() || index == pending_.index) {
+        pending_.index = index;
+        pending_.rows.push_back(std::move(row));
+        return;
+    }
+
+    // 新行进入了第三个桶，当前桶的下一个桶已经完整
+    double avg_time = 0;
+    double avg_value = 0;
+    for (const auto& r : pending_.rows) {
+        avg_time += static_cast<double>(r.timestamp);
+        avg_value += r.*field_;
+    }
+    avg_time /= static_cast<double>(pending_.rows.size());
+    avg_value /= static_cast<double>(pending_.rows.size());
+    selectLargestTriangle(current_, avg_time, avg_value);
+
+    current_ = std::move(pending_);
+    pending_ = Bucket();
+    pending_.index = index;
+    pending_.rows.push_back(std::move(row));
+}
+
+void DownsamplingCursor::finish() {
+    if (mode_ == Mode::MINMAX) {
+        if (minmax_index_ < 0) {
+            return;
+        }
+        // 按时间顺序输出，最小和最大是同一行时只输出一次
+        const SensorData& first = min_row_.timestamp <= max_row_.timestamp ? min_row_ : max_row_;
+        const SensorData& second = &first == &min_row_ ? max_row_ : min_row_;
+        emit(first);
+        if (second.timestamp != first.timestamp || second.*field_ != first.*field_) {
+            emit(second);
+        }
+        minmax_index_ = -1;
+        return;
+    }
+
+    // 最后一行原样保留，作为最后一个桶的参考点
+    Bucket& tail = pending_.rows.empty() ? current_ : pending_;
+    if (tail.rows.empty()) {
+        return;
+    }
+    SensorData last = std::move(tail.rows.back());
+    tail.rows.pop_back();
+
+    double last_time = static_cast<double>(last.timestamp);
+    double last_value = last.*field_;
+    if (!pending_.rows.empty()) {
+        double avg_time = 0;
+        double avg_value = 0;
+        for (const auto& r : pending_.rows) {
+            avg_time += static_cast<double>(r.timestamp);
+            avg_value += r.*field_;
+        }
+        selectLargestTriangle(current_, avg_time / static_cast<double>(pending_.rows.size()),
+                              avg_value / static_cast<double>(pending_.rows.size()));
+        selectLargestTriangle(pending_, last_time, last_value);
+    } else {
+        selectLargestTriangle(current_, last_time, last_value);
+    }
+    emit(last);
+    current_ = Bucket();
+    pending_ = Bucket();
+}
+
+void DownsamplingCursor::selectLargestTriangle(Bucket& bucket, double ref_time, double ref_value) {
+    if (bucket.rows.empty()) {
+        return;
+    }
+
+    double anchor_time = static_cast<double>(anchor_.timestamp);
+    double anchor_value = anchor_.*field_;
+    size_t best = 0;
+    double best_area = -1;
+    for (size_t i = 0; i < bucket.rows.size(); ++i) {
+        double time = static_cast<double>(bucket.rows[i].timestamp);
+        double value = bucket.rows[i].*field_;
+        double area = std::fabs((anchor_time - ref_time) * (value - anchor_value) -
+                                (anchor_time - time) * (ref_value - anchor_value));
+        if (area > best_area) {
+            best_area = area;
+            best = i;
+        }
+    }
+
+    anchor_ = std::move(bucket.rows[best]);
+    emit(anchor_);
+    bucket.rows.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "row_cursor.h"
+
+// 在游标之上做流式降采样，输出行数约为 max_points。
+// 时间范围按等宽时间桶划分，只缓存当前桶和下一个桶：
+// - LTTB：每个桶保留与上一个选中点、下一个桶均值构成三角形面积最大的行，首尾两行原样保留
+// - MINMAX：每个桶按时间顺序保留指定字段最小和最大的两行
+class DownsamplingCursor : public RowCursor {
+public:
+    enum class Mode { LTTB, MINMAX };
+
+    DownsamplingCursor(std::unique_ptr<RowCursor> source, time_t start_time, time_t end_time,
+                       size_t max_points, Mode mode, double SensorData::*field);
+
+    bool next(SensorData& row) override;
+    bool failed() const override { return source_->failed(); }
+
+    // 解析请求参数，未知的模式或字段返回 false
+    static bool parseMode(const std::string& name, Mode& mode);
+    static bool parseField(const std::string& name, double SensorData::*& field);
+
+    // LTTB 固定保留首尾两行，至少需要 3 个点
+    static constexpr size_t MIN_POINTS = 3;
+
+private:
+    struct Bucket {
+        long long index = -1;
+        std::vector<SensorData> rows;
+    };
+
+    void add(SensorData row);
+    void finish();
+    void selectLargestTriangle(Bucket& bucket, double ref_time, double ref_value);
+    void emit(const SensorData& row);
+    long long bucketIndex(time_t timestamp) const;
+
+    std::unique_ptr<RowCursor> source_;
+    Mode mode_;
+    double SensorData::*field_;
+    time_t start_time_;
+    time_t bucket_width_;
+
+    std::deque<SensorData> ready_;
+    bool source_done_ = false;
+
+    // LTTB 状态
+    bool has_anchor_ = false;
+    SensorData anchor_;           // 上一个选中的点
+    Bucket current_;
+    Bucket pending_;              // 下一个桶，用于计算均值
+
+    // MINMAX 状态
+    long long minmax_index_ = -1;
+    SensorData min_row_;
+    SensorData max_row_;
+};
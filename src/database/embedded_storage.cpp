@@ -0,0 +1,515 @@
+#include "embedded_storage.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace fs = std::filesystem;
+
+static_assert(sizeof(EmbeddedStorage::Record) == 80, "record layout must be packed");
+
+namespace {
+
+// 设备ID中文件名不安全的字符转义为 %XX
+std::string escapeName(const std::string& name) {
+    std::string out;
+    for (unsigned char c : name) {
+        if (std::isalnum(c) || c == '_' || c == '-') {
+            out += static_cast<char>(c);
+        } else {
+            char buf[4];
+            std::snprintf(buf, sizeof(buf), "%%%02X", c);
+            out += buf;
+        }
+    }
+    return out;
+}
+
+std::string unescapeName(const std::string& name) {
+    std::string out;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] == '%' && i + 2 < name.size()) {
+            out += static_cast<char>(std::stoi(name.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += name[i];
+        }
+    }
+    return out;
+}
+
+// 按顺序 mmap 每个段，返回时间范围内的记录
+class SegmentCursor : public RowCursor {
+public:
+    SegmentCursor(std::vector<EmbeddedStorage::SegmentSnapshot> segments,
+                  EmbeddedStorage::Tier tier, std::string device_id, std::string area,
+                  time_t start_time, time_t end_time)
+        : segments_(std::move(segments))
+        , tier_(tier)
+        , device_id_(std::move(device_id))
+        , area_(std::move(area))
+        , start_(start_time)
+        , end_(end_time) {
+    }
+
+    ~SegmentCursor() override {
+        unmap();
+    }
+
+    bool next(SensorData& row) override {
+        while (true) {
+            if (records_ && pos_ < order_.size()) {
+                const auto& record = records_[order_[pos_++]];
+                if (record.timestamp > end_) {
+                    // 段按时间窗口有序，后续段只会更晚
+                    pos_ = order_.size();
+                    segment_ = segments_.size();
+                    continue;
+                }
+                toSensorData(record, row);
+                return true;
+            }
+            if (!mapNext()) {
+                return false;
+            }
+        }
+    }
+
+private:
+    bool mapNext() {
+        unmap();
+        while (segment_ < segments_.size()) {
+            const auto& snapshot = segments_[segment_++];
+            if (snapshot.count == 0) {
+                continue;
+            }
+            int fd = ::open(snapshot.path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                continue;  // 段已被保留期清理删除
+            }
+            length_ = snapshot.count * sizeof(EmbeddedStorage::Record);
+            void* addr = ::mmap(nullptr, length_, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED) {
+                continue;
+            }
+            mapping_ = addr;
+            records_ = static_cast<const EmbeddedStorage::Record*>(addr);
+
+            // 有序段直接二分定位起点；乱序写入的段先按时间戳排序下标
+            order_.resize(snapshot.count);
+            std::iota(order_.begin(), order_.end(), 0);
+            if (!snapshot.sorted) {
+                std::stable_sort(order_.begin(), order_.end(), [this](uint32_t a, uint32_t b) {
+                    return records_[a].timestamp < records_[b].timestamp;
+                });
+            }
+            if (tier_ != EmbeddedStorage::RAW) {
+                // 重新聚合会为同一桶追加新记录，同一时间戳只保留最后写入的一条
+                size_t kept = 0;
+                for (size_t i = 0; i < order_.size(); ++i) {
+                    if (i + 1 < order_.size() &&
+                        records_[order_[i + 1]].timestamp == records_[order_[i]].timestamp) {
+                        continue;
+                    }
+                    order_[kept++] = order_[i];
+                }
+                order_.resize(kept);
+            }
+            auto first = std::lower_bound(order_.begin(), order_.end(), start_,
+                [this](uint32_t index, time_t ts) { return records_[index].timestamp < ts; });
+            pos_ = first - order_.begin();
+            return true;
+        }
+        return false;
+    }
+
+    void unmap() {
+        if (mapping_) {
+            ::munmap(mapping_, length_);
+            mapping_ = nullptr;
+            records_ = nullptr;
+        }
+    }
+
+    void toSensorData(const EmbeddedStorage::Record& record, SensorData& row) const {
+        row.device_id = device_id_;
+        row.area = area_;
+        row.timestamp = record.timestamp;
+        row.temperature = record.values[0];
+        row.humidity = record.values[1];
+        row.co2 = record.values[2];
+        row.pm25 = record.values[3];
+        row.noise = record.values[4];
+        row.light = record.values[5];
+        row.area_type = static_cast<AreaType>(record.area_type);
+        row.has_aggregated_data = tier_ != EmbeddedStorage::RAW;
+        row.has_min_max = row.has_aggregated_data;
+        row.is_hourly = tier_ == EmbeddedStorage::HOURLY;
+        row.max_temperature = record.max_temperature;
+        row.min_temperature = record.min_temperature;
+        row.samples_count = record.samples_count;
+    }
+
+    std::vector<EmbeddedStorage::SegmentSnapshot> segments_;
+    EmbeddedStorage::Tier tier_;
+    std::string device_id_;
+    std::string area_;
+    time_t start_;
+    time_t end_;
+
+    size_t segment_ = 0;
+    void* mapping_ = nullptr;
+    size_t length_ = 0;
+    const EmbeddedStorage::Record* records_ = nullptr;
+    std::vector<uint32_t> order_;
+    size_t pos_ = 0;
+};
+
+// 按桶累加聚合值
+struct BucketAccumulator {
+    double sums[6] = {};
+    double max_temperature = -1e300;
+    double min_temperature = 1e300;
+    int rows = 0;
+    int samples = 0;
+    int area_type = 0;
+};
+
+} // namespace
+
+EmbeddedStorage::EmbeddedStorage(const std::string& dir)
+    : dir_(dir) {
+    fs::create_directories(dir_);
+    load();
+}
+
+EmbeddedStorage::~EmbeddedStorage() {
+    for (auto& [_, series] : devices_) {
+        for (auto& tier : series.segments) {
+            for (auto& [_, segment] : tier) {
+                if (segment.fd >= 0) {
+                    ::close(segment.fd);
+                }
+            }
+        }
+    }
+}
+
+void EmbeddedStorage::load() {
+    for (const auto& device_entry : fs::directory_iterator(dir_)) {
+        if (!device_entry.is_directory()) {
+            continue;
+        }
+        auto& series = devices_[unescapeName(device_entry.path().filename().string())];
+
+        std::ifstream area_file(device_entry.path() / "area");
+        std::getline(area_file, series.area);
+
+        for (int tier = 0; tier < TIER_COUNT; ++tier) {
+            fs::path tier_dir = device_entry.path() / TIER_NAMES[tier];
+            if (!fs::exists(tier_dir)) {
+                continue;
+            }
+            for (const auto& file : fs::directory_iterator(tier_dir)) {
+                if (file.path().extension() != ".seg") {
+                    continue;
+                }
+                Segment segment;
+                segment.path = file.path().string();
+                segment.count = file.file_size() / sizeof(Record);  // 丢弃写了一半的尾部记录
+
+                // 重建有序标志和最后时间戳
+                std::ifstream in(segment.path, std::ios::binary);
+                Record record;
+                for (size_t i = 0; i < segment.count && in.read(reinterpret_cast<char*>(&record), sizeof(record)); ++i) {
+                    if (i > 0 && record.timestamp < segment.last_ts) {
+                        segment.sorted = false;
+                    }
+                    segment.last_ts = std::max(segment.last_ts, record.timestamp);
+                }
+                series.segments[tier][std::stoll(file.path().stem().string())] = std::move(segment);
+            }
+        }
+    }
+    std::cout << "[Storage] Loaded " << devices_.size() << " devices from " << dir_ << std::endl;
+}
+
+std::string EmbeddedStorage::deviceDir(const std::string& device_id) const {
+    return (fs::path(dir_) / escapeName(device_id)).string();
+}
+
+time_t EmbeddedStorage::bucketStart(Tier tier, time_t timestamp) {
+    if (tier == DAILY) {
+        // 与 MySQL DATE() 一致按本地日期分桶
+        struct tm tm;
+        localtime_r(&timestamp, &tm);
+        tm.tm_hour = 0;
+        tm.tm_min = 0;
+        tm.tm_sec = 0;
+        return mktime(&tm);
+    }
+    return timestamp - timestamp % 3600;
+}
+
+bool EmbeddedStorage::appendLocked(const std::string& device_id, Tier tier, const Record& record) {
+    auto& segments = devices_[device_id].segments[tier];
+    time_t window = record.timestamp - record.timestamp % SEGMENT_SPAN[tier];
+
+    auto it = segments.find(window);
+    if (it == segments.end()) {
+        fs::path tier_dir = fs::path(deviceDir(device_id)) / TIER_NAMES[tier];
+        fs::create_directories(tier_dir);
+        Segment segment;
+        segment.path = (tier_dir / (std::to_string(window) + ".seg")).string();
+        it = segments.emplace(window, std::move(segment)).first;
+    }
+
+    Segment& segment = it->second;
+    if (segment.fd < 0) {
+        segment.fd = ::open(segment.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (segment.fd < 0) {
+            std::cerr << "[Storage] Cannot open segment " << segment.path << std::endl;
+            return false;
+        }
+    }
+
+    if (::write(segment.fd, &record, sizeof(record)) != static_cast<ssize_t>(sizeof(record))) {
+        std::cerr << "[Storage] Write failed for " << segment.path << std::endl;
+        return false;
+    }
+    if (segment.count > 0 && record.timestamp < segment.last_ts) {
+        segment.sorted = false;
+    }
+    segment.last_ts = std::max(segment.last_ts, record.timestamp);
+    ++segment.count;
+
+    // 迟到数据写入旧段后立即关闭，只保留最新段的描述符
+    if (std::next(it) != segments.end()) {
+        ::close(segment.fd);
+        segment.fd = -1;
+    }
+    return true;
+}
+
+bool EmbeddedStorage::insertSensorData(const SensorData& data) {
+    Record record{};
+    record.timestamp = data.timestamp;
+    record.values[0] = data.temperature;
+    record.values[1] = data.humidity;
+    record.values[2] = data.co2;
+    record.values[3] = data.pm25;
+    record.values[4] = data.noise;
+    record.values[5] = data.light;
+    record.area_type = static_cast<int32_t>(data.area_type);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& series = devices_[data.device_id];
+    if (series.area != data.area) {
+        fs::create_directories(deviceDir(data.device_id));
+        std::ofstream(fs::path(deviceDir(data.device_id)) / "area") << data.area << '\n';
+        series.area = data.area;
+    }
+    return appendLocked(data.device_id, RAW, record);
+}
+
+bool EmbeddedStorage::batchInsertSensorData(const std::vector<SensorData>& data) {
+    for (const auto& item : data) {
+        if (!insertSensorData(item)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<RowCursor> EmbeddedStorage::openCursor(Tier tier, const std::string& device_id,
+                                                       time_t start_time, time_t end_time) {
+    std::vector<SegmentSnapshot> snapshots;
+    std::string area;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = devices_.find(device_id);
+        if (it == devices_.end()) {
+            return std::make_unique<VectorCursor>();
+        }
+        area = it->second.area;
+
+        // 只取与查询范围相交的段
+        const auto& segments = it->second.segments[tier];
+        auto seg = segments.upper_bound(start_time - SEGMENT_SPAN[tier]);
+        for (; seg != segments.end() && seg->first <= end_time; ++seg) {
+            snapshots.push_back({seg->second.path, seg->second.count, seg->second.sorted});
+        }
+    }
+    return std::make_unique<SegmentCursor>(std::move(snapshots), tier, device_id, area,
+                                           start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> EmbeddedStorage::openRealtimeCursor(const std::string& device_id,
+                                                               time_t start_time,
+                                                               time_t end_time) {
+    return openCursor(RAW, device_id, start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> EmbeddedStorage::openHourlyCursor(const std::string& device_id,
+                                                             time_t start_time,
+                                                             time_t end_time) {
+    return openCursor(HOURLY, device_id, start_time, end_time);
+}
+
+std::unique_ptr<RowCursor> EmbeddedStorage::openDailyCursor(const std::string& device_id,
+                                                            time_t start_time,
+                                                            time_t end_time) {
+    return openCursor(DAILY, device_id, start_time, end_time);
+}
+
+bool EmbeddedStorage::aggregate(Tier source, Tier target, time_t start_time, time_t end_time) {
+    std::vector<std::string> device_ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [device_id, _] : devices_) {
+            device_ids.push_back(device_id);
+        }
+    }
+
+    for (const auto& device_id : device_ids) {
+        std::map<time_t, BucketAccumulator> buckets;
+        auto cursor = openCursor(source, device_id, start_time, end_time - 1);
+        SensorData row;
+        while (cursor->next(row)) {
+            auto& bucket = buckets[bucketStart(target, row.timestamp)];
+            double values[6] = {row.temperature, row.humidity, row.co2,
+                                row.pm25, row.noise, row.light};
+            for (int i = 0; i < 6; ++i) {
+                bucket.sums[i] += values[i];
+            }
+            bucket.max_temperature = std::max(bucket.max_temperature,
+                                              row.has_min_max ? row.max_temperature : row.temperature);
+            bucket.min_temperature = std::min(bucket.min_temperature,
+                                              row.has_min_max ? row.min_temperature : row.temperature);
+            bucket.rows += 1;
+            bucket.samples += row.has_aggregated_data ? row.samples_count : 1;
+            bucket.area_type = static_cast<int>(row.area_type);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [bucket_start, bucket] : buckets) {
+            Record record{};
+            record.timestamp = bucket_start;
+            for (int i = 0; i < 6; ++i) {
+                record.values[i] = bucket.sums[i] / bucket.rows;
+            }
+            record.max_temperature = bucket.max_temperature;
+            record.min_temperature = bucket.min_temperature;
+            record.samples_count = bucket.samples;
+            record.area_type = bucket.area_type;
+            if (!appendLocked(device_id, target, record)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool EmbeddedStorage::aggregateHourlyData(time_t window_start, time_t window_end) {
+    if (!aggregate(RAW, HOURLY, window_start, window_end)) {
+        return false;
+    }
+    invalidateCached(ResultCache::HOURLY, window_start, window_end);
+    return true;
+}
+
+bool EmbeddedStorage::aggregateDailyData(time_t window_start, time_t window_end) {
+    if (!aggregate(HOURLY, DAILY, window_start, window_end)) {
+        return false;
+    }
+    invalidateCached(ResultCache::DAILY, window_start, window_end);
+    return true;
+}
+
+bool EmbeddedStorage::loadWatermark(const std::string& task, time_t& watermark) {
+    std::lock_guard<std::mutex> lock(watermark_mutex_);
+    std::ifstream file(fs::path(dir_) / "watermarks");
+    std::string name;
+    long long value;
+    while (file >> name >> value) {
+        if (name == task) {
+            watermark = static_cast<time_t>(value);
+        }
+    }
+    return true;
+}
+
+bool EmbeddedStorage::saveWatermark(const std::string& task, time_t watermark) {
+    std::lock_guard<std::mutex> lock(watermark_mutex_);
+    fs::path path = fs::path(dir_) / "watermarks";
+    std::map<std::string, long long> values;
+    {
+        std::ifstream file(path);
+        std::string name;
+        long long value;
+        while (file >> name >> value) {
+            values[name] = value;
+        }
+    }
+    values[task] = watermark;
+
+    // 先写临时文件再改名，崩溃时不会留下写了一半的水位
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        for (const auto& [name, value] : values) {
+            file << name << ' ' << value << '\n';
+        }
+        if (!file.flush()) {
+            std::cerr << "[Storage] Cannot write " << tmp << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "[Storage] Cannot write " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EmbeddedStorage::cleanupOldData() {
+    time_t now = time(nullptr);
+    const time_t retention[TIER_COUNT] = {
+        REALTIME_DATA_RETENTION_HOURS * 3600,
+        HOURLY_DATA_RETENTION_DAYS * 24 * 3600,
+        static_cast<time_t>(DAILY_DATA_RETENTION_DAYS) * 24 * 3600,
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [_, series] : devices_) {
+        for (int tier = 0; tier < TIER_COUNT; ++tier) {
+            auto& segments = series.segments[tier];
+            time_t cutoff = now - retention[tier];
+
+            // 整个窗口都早于保留期的段直接删除文件，无需逐行删除
+            for (auto it = segments.begin();
+                 it != segments.end() && it->first + SEGMENT_SPAN[tier] <= cutoff;) {
+                if (it->second.fd >= 0) {
+                    ::close(it->second.fd);
+                }
+                std::error_code ec;
+                fs::remove(it->second.path, ec);
+                it = segments.erase(it);
+            }
+        }
+    }
+
+    invalidateCached(ResultCache::HOURLY, 0, now - retention[HOURLY]);
+    invalidateCached(ResultCache::DAILY, 0, now - retention[DAILY]);
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "storage.h"
+
+// 嵌入式追加写存储后端，无需 MySQL。
+// 目录结构：<dir>/<设备ID>/{area, raw/, hourly/, daily/}，每层按固定时间窗口切分段文件，
+// 段文件是定长记录的追加日志；内存中按窗口起点索引所有段，读取时 mmap 段文件，
+// 保留期清理直接删除整个过期段文件。聚合层重新聚合时追加新记录，读取时同一桶以最后一条为准。
+class EmbeddedStorage : public Storage {
+public:
+    explicit EmbeddedStorage(const std::string& dir);
+    ~EmbeddedStorage() override;
+
+    // 禁止拷贝
+    EmbeddedStorage(const EmbeddedStorage&) = delete;
+    EmbeddedStorage& operator=(const EmbeddedStorage&) = delete;
+
+    bool insertSensorData(const SensorData& data) override;
+    bool batchInsertSensorData(const std::vector<SensorData>& data) override;
+
+    std::unique_ptr<RowCursor> openRealtimeCursor(const std::string& device_id,
+                                                  time_t start_time,
+                                                  time_t end_time) override;
+    std::unique_ptr<RowCursor> openHourlyCursor(const std::string& device_id,
+                                                time_t start_time,
+                                                time_t end_time) override;
+    std::unique_ptr<RowCursor> openDailyCursor(const std::string& device_id,
+                                               time_t start_time,
+                                               time_t end_time) override;
+
+    bool aggregateHourlyData(time_t window_start, time_t window_end) override;
+    bool aggregateDailyData(time_t window_start, time_t window_end) override;
+    bool cleanupOldData() override;
+
+    // 水位保存在数据目录下的 watermarks 文件中，每行 "<任务> <水位>"
+    bool loadWatermark(const std::string& task, time_t& watermark) override;
+    bool saveWatermark(const std::string& task, time_t watermark) override;
+
+    // 段文件中的定长记录，原始数据只使用前 7 个字段
+    struct Record {
+        int64_t timestamp;
+        double values[6];  // temperature, humidity, co2, pm25, noise, light
+        double max_temperature;
+        double min_temperature;
+        int32_t samples_count;
+        int32_t area_type;
+    };
+
+    enum Tier { RAW, HOURLY, DAILY, TIER_COUNT };
+
+    // 某个段在打开游标时的快照
+    struct SegmentSnapshot {
+        std::string path;
+        size_t count;
+        bool sorted;
+    };
+
+private:
+    struct Segment {
+        std::string path;
+        size_t count = 0;      // 已写入的记录数
+        bool sorted = true;    // 记录是否按时间戳非递减写入
+        int64_t last_ts = 0;
+        int fd = -1;           // 仅最新的段保持打开用于追加
+    };
+
+    struct DeviceSeries {
+        std::string area;
+        std::map<time_t, Segment> segments[TIER_COUNT];  // 按窗口起点索引
+    };
+
+    bool appendLocked(const std::string& device_id, Tier tier, const Record& record);
+    std::unique_ptr<RowCursor> openCursor(Tier tier, const std::string& device_id,
+                                          time_t start_time, time_t end_time);
+    bool aggregate(Tier source, Tier target, time_t start_time, time_t end_time);
+    void load();
+    std::string deviceDir(const std::string& device_id) const;
+
+    static time_t bucketStart(Tier tier, time_t timestamp);
+
+    std::string dir_;
+    std::mutex mutex_;
+    std::mutex watermark_mutex_;
+    std::unordered_map<std::string, DeviceSeries> devices_;
+
+    static constexpr time_t SEGMENT_SPAN[TIER_COUNT] = {3600, 24 * 3600, 30 * 24 * 3600};
+    static constexpr const char* TIER_NAMES[TIER_COUNT] = {"raw", "hourly", "daily"};
+};
@@ -0,0 +1,166 @@
+#include "hot_tier.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// 热层快照游标，逐行展开为 SensorData
+class HotCursor : public RowCursor {
+public:
+    HotCursor(std::string device_id, std::string area, AreaType area_type,
+              std::vector<HotTier::Reading> readings)
+        : device_id_(std::move(device_id))
+        , area_(std::move(area))
+        , area_type_(area_type)
+        , readings_(std::move(readings)) {
+    }
+
+    bool next(SensorData& row) override {
+        if (index_ >= readings_.size()) {
+            return false;
+        }
+        const auto& reading = readings_[index_++];
+        row.device_id = device_id_;
+        row.timestamp = reading.timestamp;
+        row.temperature = reading.values[0];
+        row.humidity = reading.values[1];
+        row.co2 = reading.values[2];
+        row.pm25 = reading.values[3];
+        row.noise = reading.values[4];
+        row.light = reading.values[5];
+        row.area = area_;
+        row.area_type = area_type_;
+        return true;
+    }
+
+private:
+    std::string device_id_;
+    std::string area_;
+    AreaType area_type_;
+    std::vector<HotTier::Reading> readings_;
+    size_t index_ = 0;
+};
+
+bool earlier(const HotTier::Reading& reading, int64_t timestamp) {
+    return reading.timestamp < timestamp;
+}
+
+} // namespace
+
+HotTier::HotTier(time_t retention_seconds, size_t budget_bytes)
+    : started_at_(time(nullptr))
+    , retention_seconds_(retention_seconds)
+    , budget_bytes_(budget_bytes) {
+}
+
+size_t HotTier::budgetFromEnv() {
+    const char* value = std::getenv("EVM_HOT_TIER_MB");
+    size_t mb = value ? std::strtoull(value, nullptr, 10) : DEFAULT_BUDGET_MB;
+    return mb << 20;
+}
+
+std::shared_ptr<HotTier::Series> HotTier::find(const std::string& device_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = series_.find(device_id);
+    return it == series_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<HotTier::Series> HotTier::findOrCreate(const std::string& device_id) {
+    if (auto series = find(device_id)) {
+        return series;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto& series = series_[device_id];
+    if (!series) {
+        // 进程启动之前的数据不在内存中
+        series = std::make_shared<Series>();
+        series->covered_from = started_at_;
+    }
+    return series;
+}
+
+void HotTier::popFront(Series& series) {
+    series.covered_from = std::max<time_t>(series.covered_from,
+                                           series.readings.front().timestamp + 1);
+    series.readings.pop_front();
+    bytes_ -= sizeof(Reading);
+}
+
+void HotTier::append(const SensorData& data) {
+    if (budget_bytes_ == 0) {
+        return;
+    }
+
+    auto series = findOrCreate(data.device_id);
+    size_t device_count;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        device_count = series_.size();
+    }
+
+    std::lock_guard<std::mutex> lock(series->mutex);
+    // 早于覆盖起点的迟到数据只在数据库中
+    if (data.timestamp < series->covered_from) {
+        return;
+    }
+
+    Reading reading{data.timestamp, {data.temperature, data.humidity, data.co2,
+                                     data.pm25, data.noise, data.light}};
+    auto& readings = series->readings;
+    if (readings.empty() || readings.back().timestamp <= reading.timestamp) {
+        readings.push_back(reading);
+    } else {
+        auto pos = std::upper_bound(readings.begin(), readings.end(), reading,
+                                    [](const Reading& a, const Reading& b) {
+                                        return a.timestamp < b.timestamp;
+                                    });
+        readings.insert(pos, reading);
+    }
+    series->area = data.area;
+    series->area_type = data.area_type;
+    bytes_ += sizeof(Reading);
+
+    // 超出保留期的读数
+    int64_t cutoff = readings.back().timestamp - retention_seconds_;
+    while (!readings.empty() && readings.front().timestamp < cutoff) {
+        popFront(*series);
+    }
+    series->covered_from = std::max<time_t>(series->covered_from, cutoff);
+
+    // 超出预算时每个设备最多保留均分的份额
+    if (bytes_.load() > budget_bytes_) {
+        size_t share = std::max<size_t>(budget_bytes_ / device_count / sizeof(Reading), 1);
+        while (readings.size() > share) {
+            popFront(*series);
+        }
+    }
+}
+
+time_t HotTier::coveredFrom(const std::string& device_id) const {
+    auto series = find(device_id);
+    if (!series) {
+        return std::numeric_limits<time_t>::max();
+    }
+    std::lock_guard<std::mutex> lock(series->mutex);
+    return series->covered_from;
+}
+
+std::unique_ptr<RowCursor> HotTier::openCursor(const std::string& device_id,
+                                               time_t start_time,
+                                               time_t end_time) const {
+    auto series = find(device_id);
+    if (!series) {
+        return std::make_unique<VectorCursor>();
+    }
+
+    std::lock_guard<std::mutex> lock(series->mutex);
+    const auto& readings = series->readings;
+    auto first = std::lower_bound(readings.begin(), readings.end(),
+                                  static_cast<int64_t>(start_time), earlier);
+    auto last = std::lower_bound(first, readings.end(),
+                                 static_cast<int64_t>(end_time) + 1, earlier);
+    return std::make_unique<HotCursor>(device_id, series->area, series->area_type,
+                                       std::vector<Reading>(first, last));
+}
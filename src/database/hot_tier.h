@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "../models/sensor_data.h"
+#include "row_cursor.h"
+
+// 最近数据的内存热层：每个设备一个按时间排序的紧凑读数缓冲区，覆盖实时数据保留期，
+// 总内存受预算限制，超出时按设备均分预算并淘汰最旧的读数。
+// 历史查询中热层完整覆盖的时间段直接从内存返回，不访问数据库。
+class HotTier {
+public:
+    HotTier(time_t retention_seconds, size_t budget_bytes);
+
+    // 禁止拷贝
+    HotTier(const HotTier&) = delete;
+    HotTier& operator=(const HotTier&) = delete;
+
+    void append(const SensorData& data);
+
+    // 该设备从此时间点起的读数全部在内存中，没有覆盖时返回 time_t 最大值
+    time_t coveredFrom(const std::string& device_id) const;
+
+    // 读取 [start_time, end_time] 内的内存读数，打开时复制一份快照
+    std::unique_ptr<RowCursor> openCursor(const std::string& device_id,
+                                          time_t start_time,
+                                          time_t end_time) const;
+
+    size_t memoryUsage() const { return bytes_.load(); }
+
+    // 预算默认 256 MB，可由环境变量 EVM_HOT_TIER_MB 覆盖
+    static size_t budgetFromEnv();
+
+    struct Reading {
+        int64_t timestamp;
+        double values[6];  // temperature, humidity, co2, pm25, noise, light
+    };
+
+private:
+    struct Series {
+        std::mutex mutex;
+        std::string area;
+        AreaType area_type = AreaType::LIVING;
+        std::deque<Reading> readings;
+        time_t covered_from = 0;
+    };
+
+    std::shared_ptr<Series> find(const std::string& device_id) const;
+    std::shared_ptr<Series> findOrCreate(const std::string& device_id);
+    void popFront(Series& series);
+
+    time_t started_at_;
+    time_t retention_seconds_;
+    size_t budget_bytes_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Series>> series_;
+    std::atomic<size_t> bytes_{0};
+
+    static constexpr size_t DEFAULT_BUDGET_MB = 256;
+};
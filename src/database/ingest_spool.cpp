@@ -0,0 +1,379 @@
+#include "ingest_spool.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 记录格式：[u32 负载长度][u32 CRC32][负载]
+// 负载：i64 时间戳、6 个 double、i32 区域类型、u16+设备ID、u16+区域
+constexpr size_t RECORD_HEADER_SIZE = 8;
+constexpr size_t FIXED_PAYLOAD_SIZE = 8 + 6 * 8 + 4;
+
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const char*& p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return value;
+}
+
+void encodeRecord(std::string& out, const SensorData& data) {
+    uint16_t device_len = static_cast<uint16_t>(std::min<size_t>(data.device_id.size(), UINT16_MAX));
+    uint16_t area_len = static_cast<uint16_t>(std::min<size_t>(data.area.size(), UINT16_MAX));
+    uint32_t payload_len = FIXED_PAYLOAD_SIZE + 2 + device_len + 2 + area_len;
+
+    size_t header_pos = out.size();
+    out.resize(header_pos + RECORD_HEADER_SIZE);
+    size_t payload_pos = out.size();
+
+    put<int64_t>(out, data.timestamp);
+    for (double value : {data.temperature, data.humidity, data.co2,
+                         data.pm25, data.noise, data.light}) {
+        put<double>(out, value);
+    }
+    put<int32_t>(out, static_cast<int32_t>(data.area_type));
+    put<uint16_t>(out, device_len);
+    out.append(data.device_id.data(), device_len);
+    put<uint16_t>(out, area_len);
+    out.append(data.area.data(), area_len);
+
+    uint32_t crc = crc32(0L, reinterpret_cast<const Bytef*>(out.data() + payload_pos), payload_len);
+    std::memcpy(&out[header_pos], &payload_len, 4);
+    std::memcpy(&out[header_pos + 4], &crc, 4);
+}
+
+bool decodePayload(const char* p, size_t len, SensorData& data) {
+    if (len < FIXED_PAYLOAD_SIZE + 4) {
+        return false;
+    }
+    const char* end = p + len;
+    data.timestamp = get<int64_t>(p);
+    data.temperature = get<double>(p);
+    data.humidity = get<double>(p);
+    data.co2 = get<double>(p);
+    data.pm25 = get<double>(p);
+    data.noise = get<double>(p);
+    data.light = get<double>(p);
+    data.area_type = static_cast<AreaType>(get<int32_t>(p));
+    uint16_t device_len = get<uint16_t>(p);
+    if (p + device_len + 2 > end) {
+        return false;
+    }
+    data.device_id.assign(p, device_len);
+    p += device_len;
+    uint16_t area_len = get<uint16_t>(p);
+    if (p + area_len > end) {
+        return false;
+    }
+    data.area.assign(p, area_len);
+    return true;
+}
+
+// 段文件名为 12 位序号加 .spool，其他文件（包括手工放入的同扩展名文件）忽略
+bool parseSegmentSeq(const fs::path& path, unsigned long long& seq) {
+    if (path.extension() != ".spool") {
+        return false;
+    }
+    std::string stem = path.stem().string();
+    if (stem.empty() || !std::all_of(stem.begin(), stem.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    errno = 0;
+    seq = std::strtoull(stem.c_str(), nullptr, 10);
+    return errno == 0;
+}
+
+} // namespace
+
+IngestSpool::IngestSpool(const std::string& dir, Storage& storage)
+    : dir_(dir)
+    , storage_(storage) {
+    fs::create_directories(dir_);
+
+    // 接着上次运行遗留的段编号继续写，遗留段稍后回放
+    for (const auto& entry : fs::directory_iterator(dir_)) {
+        unsigned long long seq;
+        if (parseSegmentSeq(entry.path(), seq)) {
+            segment_seq_ = std::max(segment_seq_, seq + 1);
+        }
+    }
+}
+
+IngestSpool::~IngestSpool() {
+    stop();
+}
+
+void IngestSpool::start() {
+    running_ = true;
+    worker_ = std::thread(&IngestSpool::run, this);
+}
+
+void IngestSpool::stop() {
+    running_ = false;
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    flush();
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void IngestSpool::append(const SensorData& data) {
+    bool flush_now;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        encodeRecord(buffer_, data);
+        flush_now = buffer_.size() >= FLUSH_THRESHOLD;
+    }
+    ++spooled_records_;
+    if (flush_now) {
+        cv_.notify_one();
+    }
+}
+
+void IngestSpool::reportSuccess() {
+    consecutive_failures_ = 0;
+    if (!healthy_.exchange(true)) {
+        std::cout << "[Spool] Database recovered, draining spool" << std::endl;
+    }
+}
+
+void IngestSpool::reportFailure() {
+    if (++consecutive_failures_ >= FAILURE_THRESHOLD && healthy_.exchange(false)) {
+        std::cerr << "[Spool] Database unhealthy, spooling readings to " << dir_ << std::endl;
+    }
+}
+
+void IngestSpool::run() {
+    auto next_replay = std::chrono::steady_clock::now();
+
+    while (running_) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] {
+                return !running_ || buffer_.size() >= FLUSH_THRESHOLD;
+            });
+        }
+        flush();
+
+        if (!running_ || std::chrono::steady_clock::now() < next_replay) {
+            continue;
+        }
+
+        auto segments = closedSegments();
+        if (segments.empty()) {
+            // 没有待回放的已关闭段时，关闭当前段使其可以回放
+            std::lock_guard<std::mutex> io_lock(io_mutex_);
+            if (segment_bytes_ == 0) {
+                continue;
+            }
+            rotateLocked();
+        }
+
+        for (const auto& path : closedSegments()) {
+            if (!running_) {
+                break;
+            }
+            if (!replaySegment(path)) {
+                next_replay = std::chrono::steady_clock::now() +
+                              std::chrono::seconds(REPLAY_RETRY_SECONDS);
+                break;
+            }
+            fs::remove(path);
+        }
+    }
+}
+
+void IngestSpool::flush() {
+    // 缓冲区在 mutex_ 下换出，写盘和 fdatasync 只持有 io_mutex_，append 不会等待磁盘同步
+    std::lock_guard<std::mutex> io_lock(io_mutex_);
+    std::string pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(buffer_);
+    }
+    if (pending.empty()) {
+        return;
+    }
+    if (fd_ < 0) {
+        openSegmentLocked();
+        if (fd_ < 0) {
+            requeue(pending);
+            return;
+        }
+    }
+
+    size_t written = 0;
+    bool ok = true;
+    while (written < pending.size()) {
+        ssize_t n = ::write(fd_, pending.data() + written, pending.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[Spool] Write failed: " << std::strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    // 一次 fdatasync 覆盖本批所有记录
+    if (ok && ::fdatasync(fd_) != 0) {
+        std::cerr << "[Spool] fdatasync failed: " << std::strerror(errno) << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        // 本批不算落盘：截掉可能写了一半的记录，换新段重写整批，旧段中已同步的数据照常回放
+        if (::ftruncate(fd_, static_cast<off_t>(segment_bytes_)) != 0) {
+            std::cerr << "[Spool] Cannot truncate segment: " << std::strerror(errno) << std::endl;
+        }
+        rotateLocked();
+        requeue(pending);
+        return;
+    }
+    segment_bytes_ += written;
+
+    if (segment_bytes_ >= SEGMENT_MAX_BYTES) {
+        rotateLocked();
+    }
+}
+
+void IngestSpool::requeue(const std::string& records) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer_.insert(0, records);
+}
+
+void IngestSpool::rotateLocked() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    ++segment_seq_;
+    segment_bytes_ = 0;
+}
+
+void IngestSpool::openSegmentLocked() {
+    fd_ = ::open(segmentPath(segment_seq_).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+        std::cerr << "[Spool] Cannot open segment: " << std::strerror(errno) << std::endl;
+    }
+}
+
+std::vector<std::string> IngestSpool::closedSegments() {
+    std::string active;
+    {
+        std::lock_guard<std::mutex> io_lock(io_mutex_);
+        active = segmentPath(segment_seq_);
+    }
+
+    std::vector<std::string> segments;
+    unsigned long long seq;
+    for (const auto& entry : fs::directory_iterator(dir_)) {
+        if (parseSegmentSeq(entry.path(), seq) && entry.path().string() != active) {
+            segments.push_back(entry.path().string());
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+bool IngestSpool::replaySegment(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    // 同一进程内记住回放进度，失败重试时从上次成功的批次之后继续
+    if (replay_path_ == path) {
+        file.seekg(replay_offset_);
+    } else {
+        replay_path_ = path;
+        replay_offset_ = 0;
+    }
+
+    std::vector<SensorData> batch;
+    batch.reserve(REPLAY_BATCH_SIZE);
+    std::string payload;
+
+    auto flush_batch = [&]() {
+        if (batch.empty()) {
+            return true;
+        }
+        if (!storage_.batchInsertSensorData(batch)) {
+            reportFailure();
+            return false;
+        }
+        reportSuccess();
+        // 回放的读数可能早于已聚合的小时，标记为脏小时以便重新聚合
+        for (const auto& data : batch) {
+            storage_.noteIngested(data.timestamp);
+        }
+        spooled_records_ -= std::min(spooled_records_.load(), batch.size());
+        batch.clear();
+        replay_offset_ = file.tellg();
+        return true;
+    };
+
+    char header[RECORD_HEADER_SIZE];
+    while (running_ && file.read(header, RECORD_HEADER_SIZE)) {
+        uint32_t payload_len;
+        uint32_t crc;
+        std::memcpy(&payload_len, header, 4);
+        std::memcpy(&crc, header + 4, 4);
+
+        payload.resize(payload_len);
+        if (!file.read(payload.data(), payload_len) ||
+            crc32(0L, reinterpret_cast<const Bytef*>(payload.data()), payload_len) != crc) {
+            // 崩溃时写了一半的尾部记录，丢弃该段剩余部分
+            std::cerr << "[Spool] Truncated record in " << path << std::endl;
+            file.clear();
+            break;
+        }
+
+        SensorData data;
+        if (decodePayload(payload.data(), payload.size(), data)) {
+            batch.push_back(std::move(data));
+        }
+        if (batch.size() >= REPLAY_BATCH_SIZE && !flush_batch()) {
+            return false;
+        }
+    }
+    file.clear();
+    if (!running_ || !flush_batch()) {
+        return false;
+    }
+
+    replay_path_.clear();
+    std::cout << "[Spool] Replayed " << path << std::endl;
+    return true;
+}
+
+std::string IngestSpool::segmentPath(unsigned long long seq) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%012llu.spool", seq);
+    return (fs::path(dir_) / name).string();
+}
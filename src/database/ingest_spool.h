@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../models/sensor_data.h"
+#include "storage.h"
+
+// 数据库写入失败或变慢时的本地预写日志。
+// 读数以追加方式写入分段文件，后台线程批量 fsync；
+// 数据库恢复后由同一线程按段大批量回放到 MySQL，回放完成的段文件被删除。
+// 回放语义为至少一次：回放中途崩溃会导致该段部分数据重复写入。
+class IngestSpool {
+public:
+    IngestSpool(const std::string& dir, Storage& storage);
+    ~IngestSpool();
+
+    // 禁止拷贝
+    IngestSpool(const IngestSpool&) = delete;
+    IngestSpool& operator=(const IngestSpool&) = delete;
+
+    void start();
+    void stop();
+
+    // 追加一条读数，只写入内存缓冲区，由后台线程落盘
+    void append(const SensorData& data);
+
+    // 数据库健康状态，由写入结果驱动
+    bool databaseHealthy() const { return healthy_.load(); }
+    void reportSuccess();
+    void reportFailure();
+
+    size_t spooledRecords() const { return spooled_records_.load(); }
+
+private:
+    void run();
+    void flush();
+    void requeue(const std::string& records);
+    // 以下两个函数要求持有 io_mutex_
+    void rotateLocked();
+    void openSegmentLocked();
+    std::vector<std::string> closedSegments();
+    bool replaySegment(const std::string& path);
+    std::string segmentPath(unsigned long long seq) const;
+
+    std::string dir_;
+    Storage& storage_;
+
+    std::mutex mutex_;                 // 保护 buffer_，append 只持有它
+    std::condition_variable cv_;
+    std::string buffer_;               // 等待落盘的记录
+
+    // 段文件状态，io_mutex_ 保护；需要同时持有时先取 io_mutex_ 再取 mutex_
+    std::mutex io_mutex_;
+    int fd_ = -1;                      // 当前写入的段文件
+    unsigned long long segment_seq_ = 0;
+    size_t segment_bytes_ = 0;
+
+    // 回放进度，仅由后台线程访问
+    std::string replay_path_;
+    long long replay_offset_ = 0;
+
+    std::atomic<bool> healthy_{true};
+    std::atomic<int> consecutive_failures_{0};
+    std::atomic<size_t> spooled_records_{0};
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+
+    static constexpr int FAILURE_THRESHOLD = 3;          // 连续失败多少次判定为不健康
+    static constexpr int FLUSH_INTERVAL_MS = 100;        // fsync 批量间隔
+    static constexpr int REPLAY_RETRY_SECONDS = 5;       // 回放失败后的重试间隔
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 20;   // 缓冲区超过该大小立即落盘
+    static constexpr size_t SEGMENT_MAX_BYTES = 64 << 20;
+    static constexpr size_t REPLAY_BATCH_SIZE = 1000;
+};
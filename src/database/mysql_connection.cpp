@@ -0,0 +1,132 @@
+#include "mysql_connection.h"
+#include <iostream>
+#include <stdexcept>
+
+MySQLConnection::MySQLConnection(const std::string& host, const std::string& user,
+                                 const std::string& password, const std::string& database)
+    : conn_(nullptr)
+    , host_(host)
+    , user_(user)
+    , password_(password)
+    , database_(database) {
+    connect();
+}
+
+MySQLConnection::~MySQLConnection() {
+    closeStatements();
+    if (conn_) {
+        mysql_close(conn_);
+    }
+}
+
+void MySQLConnection::connect() {
+    conn_ = mysql_init(nullptr);
+    if (!conn_) {
+        throw std::runtime_error("mysql_init() failed");
+    }
+
+    if (!mysql_real_connect(conn_, host_.c_str(), user_.c_str(),
+                            password_.c_str(), database_.c_str(), 0, nullptr, 0)) {
+        std::string error = mysql_error(conn_);
+        mysql_close(conn_);
+        conn_ = nullptr;
+        throw std::runtime_error(error);
+    }
+}
+
+bool MySQLConnection::ensureConnected() {
+    if (conn_) {
+        return true;
+    }
+    try {
+        connect();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "MySQL reconnect failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void MySQLConnection::closeStatements() {
+    for (auto& entry : statements_) {
+        mysql_stmt_close(entry.second);
+    }
+    statements_.clear();
+}
+
+bool MySQLConnection::query(const std::string& sql) {
+    if (!ensureConnected()) {
+        return false;
+    }
+    if (mysql_real_query(conn_, sql.data(), sql.size()) != 0) {
+        checkError(nullptr);
+        return false;
+    }
+    return true;
+}
+
+MYSQL_STMT* MySQLConnection::statement(const std::string& sql) {
+    auto it = statements_.find(sql);
+    if (it != statements_.end()) {
+        return it->second;
+    }
+    if (!ensureConnected()) {
+        return nullptr;
+    }
+
+    MYSQL_STMT* stmt = mysql_stmt_init(conn_);
+    if (!stmt) {
+        std::cerr << "mysql_stmt_init() failed: " << mysql_error(conn_) << std::endl;
+        return nullptr;
+    }
+
+    if (mysql_stmt_prepare(stmt, sql.data(), sql.size()) != 0) {
+        std::cerr << "MySQL prepare error: " << mysql_stmt_error(stmt) << std::endl;
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    statements_.emplace(sql, stmt);
+    return stmt;
+}
+
+void MySQLConnection::checkError(MYSQL_STMT* stmt) {
+    unsigned int err = stmt ? mysql_stmt_errno(stmt) : mysql_errno(conn_);
+    std::cerr << "MySQL statement error (" << err << "): "
+              << (stmt ? mysql_stmt_error(stmt) : mysql_error(conn_)) << std::endl;
+
+    // 连接断开后服务端的语句句柄全部失效，下次使用时重连并重新准备
+    if (err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST) {
+        closeStatements();
+        mysql_close(conn_);
+        conn_ = nullptr;
+    }
+}
+
+ConnectionPool::ConnectionPool(const std::string& host, const std::string& user,
+                               const std::string& password, const std::string& database,
+                               size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        connections_.push_back(std::make_unique<MySQLConnection>(host, user, password, database));
+        idle_.push_back(connections_.back().get());
+    }
+}
+
+ConnectionPool::Lease ConnectionPool::acquire(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [this] { return !idle_.empty(); })) {
+        std::cerr << "[Database] No idle connection after " << timeout.count() << " ms" << std::endl;
+        return Lease();
+    }
+    MySQLConnection* conn = idle_.back();
+    idle_.pop_back();
+    return Lease(this, conn);
+}
+
+void ConnectionPool::release(MySQLConnection* conn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(conn);
+    }
+    cv_.notify_one();
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <mysql/mysql.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// MySQL 8 的 MYSQL_BIND 标志位是 bool，MariaDB 和旧版本是 my_bool
+using bind_flag_t = std::remove_pointer_t<decltype(MYSQL_BIND::is_null)>;
+
+// 数据库连接参数
+struct ConnectionInfo {
+    std::string host;
+    std::string user;
+    std::string password;
+    std::string database;
+};
+
+// 单个 MySQL 连接，缓存该连接上已准备好的预处理语句
+class MySQLConnection {
+public:
+    MySQLConnection(const std::string& host, const std::string& user,
+                    const std::string& password, const std::string& database);
+    ~MySQLConnection();
+
+    // 禁止拷贝
+    MySQLConnection(const MySQLConnection&) = delete;
+    MySQLConnection& operator=(const MySQLConnection&) = delete;
+
+    MYSQL* handle() { return conn_; }
+
+    // 执行文本 SQL（建表、维护等低频语句）
+    bool query(const std::string& sql);
+
+    // 获取缓存的预处理语句，首次使用时准备，失败返回 nullptr
+    MYSQL_STMT* statement(const std::string& sql);
+
+    // 执行语句失败后调用，连接断开时清空语句缓存，下次使用时重连
+    void checkError(MYSQL_STMT* stmt);
+
+private:
+    void connect();
+    bool ensureConnected();
+    void closeStatements();
+
+    MYSQL* conn_;
+    std::string host_;
+    std::string user_;
+    std::string password_;
+    std::string database_;
+    std::unordered_map<std::string, MYSQL_STMT*> statements_;
+};
+
+// 固定大小的连接池，每个连接同一时间只被一个线程使用
+class ConnectionPool {
+public:
+    // 借出的连接，析构时自动归还；等待超时时为空
+    class Lease {
+    public:
+        Lease() : pool_(nullptr), conn_(nullptr) {}
+        Lease(ConnectionPool* pool, MySQLConnection* conn) : pool_(pool), conn_(conn) {}
+        // 不属于连接池的专用连接，最后一个持有者释放时关闭
+        explicit Lease(std::shared_ptr<MySQLConnection> dedicated)
+            : pool_(nullptr), conn_(dedicated.get()), dedicated_(std::move(dedicated)) {}
+        Lease(Lease&& other) noexcept
+            : pool_(other.pool_), conn_(other.conn_), dedicated_(std::move(other.dedicated_)) { other.conn_ = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (conn_ && pool_) pool_->release(conn_); }
+
+        explicit operator bool() const { return conn_ != nullptr; }
+        MySQLConnection* operator->() const { return conn_; }
+        MySQLConnection& operator*() const { return *conn_; }
+
+    private:
+        ConnectionPool* pool_;
+        MySQLConnection* conn_;
+        std::shared_ptr<MySQLConnection> dedicated_;
+    };
+
+    ConnectionPool(const std::string& host, const std::string& user,
+                   const std::string& password, const std::string& database,
+                   size_t size);
+
+    // 等待空闲连接，超时返回空的 Lease，调用方按数据库不可用处理
+    Lease acquire(std::chrono::milliseconds timeout = DEFAULT_ACQUIRE_TIMEOUT);
+
+    static constexpr std::chrono::milliseconds DEFAULT_ACQUIRE_TIMEOUT{5000};
+
+private:
+    void release(MySQLConnection* conn);
+
+    std::vector<std::unique_ptr<MySQLConnection>> connections_;
+    std::vector<MySQLConnection*> idle_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+// 参数/结果绑定辅助函数
+inline void bindLongLong(MYSQL_BIND& bind, long long* value) {
+    std::memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_LONGLONG;
+    bind.buffer = value;
+}
+
+inline void bindInt(MYSQL_BIND& bind, int* value) {
+    std::memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_LONG;
+    bind.buffer = value;
+}
+
+inline void bindDouble(MYSQL_BIND& bind, double* value) {
+    std::memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_DOUBLE;
+    bind.buffer = value;
+}
+
+// 输入参数：直接引用字符串内容
+inline void bindString(MYSQL_BIND& bind, const std::string& value) {
+    std::memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = const_cast<char*>(value.data());
+    bind.buffer_length = value.size();
+}
+
+// 输出结果：写入固定大小的缓冲区，实际长度写入 length
+inline void bindString(MYSQL_BIND& bind, char* buffer, unsigned long capacity, unsigned long* length) {
+    std::memset(&bind, 0, sizeof(bind));
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = buffer;
+    bind.buffer_length = capacity;
+    bind.length = length;
+}
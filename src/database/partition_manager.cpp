@@ -0,0 +1,175 @@
+#include "partition_manager.h"
+#include <iostream>
+#include <sstream>
+
+PartitionManager::PartitionManager(std::string table, std::string column,
+                                   Granularity granularity, int ahead)
+    : table_(std::move(table))
+    , column_(std::move(column))
+    , granularity_(granularity)
+    , ahead_(ahead) {
+}
+
+std::string PartitionManager::createClause() const {
+    return "PARTITION BY RANGE (UNIX_TIMESTAMP(" + column_ + ")) "
+           "(PARTITION pmax VALUES LESS THAN MAXVALUE)";
+}
+
+bool PartitionManager::ensurePartitioned(MySQLConnection& conn, time_t now) {
+    std::vector<Partition> partitions;
+    bool partitioned = false;
+    if (!listPartitions(conn, partitions, partitioned)) {
+        return false;
+    }
+    if (partitioned) {
+        return true;
+    }
+
+    // 分区表的每个唯一键都必须包含分区列，这里需要重建整张表
+    std::cout << "[Partition] Converting " << table_ << " to range partitions, "
+              << "this rebuilds the table" << std::endl;
+    std::ostringstream sql;
+    sql << "ALTER TABLE " << table_ << " DROP PRIMARY KEY, ADD PRIMARY KEY (id, " << column_ << ") "
+        << "PARTITION BY RANGE (UNIX_TIMESTAMP(" << column_ << ")) ("
+        << "PARTITION p_start VALUES LESS THAN (" << periodStart(now) << "), "
+        << "PARTITION pmax VALUES LESS THAN MAXVALUE)";
+    return conn.query(sql.str());
+}
+
+bool PartitionManager::precreate(MySQLConnection& conn, time_t now) {
+    std::vector<Partition> partitions;
+    bool partitioned = false;
+    if (!listPartitions(conn, partitions, partitioned)) {
+        return false;
+    }
+    if (!partitioned) {
+        std::cerr << "[Partition] " << table_ << " is not partitioned" << std::endl;
+        return false;
+    }
+
+    // 从最后一个有界分区的上界开始向后补齐；只有 pmax 时从当前周期开始
+    time_t period = periodStart(now);
+    for (const auto& partition : partitions) {
+        if (!partition.maxvalue) {
+            period = partition.upper;
+        }
+    }
+
+    time_t horizon = periodStart(now);
+    for (int i = 0; i < ahead_; ++i) {
+        horizon = nextPeriod(horizon);
+    }
+
+    std::ostringstream definitions;
+    int created = 0;
+    for (; period <= horizon; period = nextPeriod(period)) {
+        definitions << "PARTITION " << partitionName(period)
+                    << " VALUES LESS THAN (" << nextPeriod(period) << "), ";
+        ++created;
+    }
+    if (created == 0) {
+        return true;
+    }
+
+    // pmax 中通常没有数据（数据都落在预先创建的分区里），重组只修改元数据
+    std::string sql = "ALTER TABLE " + table_ + " REORGANIZE PARTITION pmax INTO (" +
+                      definitions.str() + "PARTITION pmax VALUES LESS THAN MAXVALUE)";
+    if (!conn.query(sql)) {
+        return false;
+    }
+    std::cout << "[Partition] Created " << created << " partitions for " << table_ << std::endl;
+    return true;
+}
+
+bool PartitionManager::dropBefore(MySQLConnection& conn, time_t boundary) {
+    std::vector<Partition> partitions;
+    bool partitioned = false;
+    if (!listPartitions(conn, partitions, partitioned)) {
+        return false;
+    }
+
+    std::string names;
+    for (const auto& partition : partitions) {
+        if (!partition.maxvalue && partition.upper <= boundary) {
+            names += (names.empty() ? "" : ", ") + partition.name;
+        }
+    }
+    if (names.empty()) {
+        return true;
+    }
+    if (!conn.query("ALTER TABLE " + table_ + " DROP PARTITION " + names)) {
+        return false;
+    }
+    std::cout << "[Partition] Dropped " << names << " from " << table_ << std::endl;
+    return true;
+}
+
+bool PartitionManager::listPartitions(MySQLConnection& conn, std::vector<Partition>& partitions,
+                                      bool& partitioned) {
+    std::string sql =
+        "SELECT PARTITION_NAME, PARTITION_DESCRIPTION FROM information_schema.PARTITIONS "
+        "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table_ + "' "
+        "ORDER BY PARTITION_ORDINAL_POSITION";
+    if (!conn.query(sql)) {
+        return false;
+    }
+    MYSQL_RES* result = mysql_store_result(conn.handle());
+    if (!result) {
+        std::cerr << "[Partition] " << mysql_error(conn.handle()) << std::endl;
+        return false;
+    }
+
+    // 未分区的表只有一行且分区名为 NULL
+    partitions.clear();
+    partitioned = false;
+    while (MYSQL_ROW row = mysql_fetch_row(result)) {
+        if (!row[0]) {
+            continue;
+        }
+        partitioned = true;
+        Partition partition;
+        partition.name = row[0];
+        partition.maxvalue = !row[1] || std::string(row[1]) == "MAXVALUE";
+        partition.upper = partition.maxvalue ? 0 : static_cast<time_t>(std::stoll(row[1]));
+        partitions.push_back(std::move(partition));
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+time_t PartitionManager::periodStart(time_t timestamp) const {
+    struct tm tm;
+    localtime_r(&timestamp, &tm);
+    if (granularity_ == MONTHLY) {
+        tm.tm_mday = 1;
+    }
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+time_t PartitionManager::nextPeriod(time_t period_start) const {
+    struct tm tm;
+    localtime_r(&period_start, &tm);
+    if (granularity_ == MONTHLY) {
+        tm.tm_mon += 1;
+        tm.tm_mday = 1;
+    } else {
+        tm.tm_mday += 1;
+    }
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+std::string PartitionManager::partitionName(time_t period_start) const {
+    struct tm tm;
+    localtime_r(&period_start, &tm);
+    char name[16];
+    strftime(name, sizeof(name), granularity_ == MONTHLY ? "p%Y%m" : "p%Y%m%d", &tm);
+    return name;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <ctime>
+#include <string>
+#include <vector>
+#include "mysql_connection.h"
+
+// 按时间 RANGE 分区的表的分区维护。
+// 分区键为 UNIX_TIMESTAMP(时间列)，分区按本地自然日或自然月划分，名称为 pYYYYMMDD / pYYYYMM；
+// 末尾始终保留 pmax (MAXVALUE) 兜底，新分区通过 REORGANIZE pmax 预先切出。
+// 保留期清理直接 DROP PARTITION，只修改元数据，不逐行删除。
+class PartitionManager {
+public:
+    enum Granularity { DAILY, MONTHLY };
+
+    PartitionManager(std::string table, std::string column, Granularity granularity, int ahead);
+
+    // 建表语句末尾的分区子句：只有 pmax 一个分区，由 precreate 切分
+    std::string createClause() const;
+
+    // 旧版本创建的未分区表：主键改为 (id, 时间列) 并按时间分区。
+    // 已有数据全部落入 p_start 分区，该分区过了保留期后整体删除
+    bool ensurePartitioned(MySQLConnection& conn, time_t now);
+
+    // 确保从当前周期起向后 ahead 个周期的分区已存在
+    bool precreate(MySQLConnection& conn, time_t now);
+
+    // 删除上界不晚于 boundary 的分区，即其中所有数据都早于 boundary
+    bool dropBefore(MySQLConnection& conn, time_t boundary);
+
+    const std::string& table() const { return table_; }
+
+private:
+    struct Partition {
+        std::string name;
+        bool maxvalue;
+        time_t upper;   // VALUES LESS THAN 的上界
+    };
+
+    bool listPartitions(MySQLConnection& conn, std::vector<Partition>& partitions, bool& partitioned);
+    time_t periodStart(time_t timestamp) const;
+    time_t nextPeriod(time_t period_start) const;
+    std::string partitionName(time_t period_start) const;
+
+    std::string table_;
+    std::string column_;
+    Granularity granularity_;
+    int ahead_;
+};
@@ -0,0 +1,138 @@
+#include "result_cache.h"
+#include <cstdlib>
+#include <functional>
+
+ResultCache::ResultCache(size_t budget_bytes)
+    : shard_budget_(budget_bytes / SHARD_COUNT) {
+}
+
+size_t ResultCache::budgetFromEnv() {
+    const char* value = std::getenv("EVM_RESULT_CACHE_MB");
+    size_t mb = value ? std::strtoull(value, nullptr, 10) : DEFAULT_BUDGET_MB;
+    return mb << 20;
+}
+
+time_t ResultCache::blockStart(Tier tier, time_t timestamp) {
+    time_t span = blockSpan(tier);
+    time_t offset = timestamp % span;
+    return timestamp - (offset < 0 ? offset + span : offset);
+}
+
+std::string ResultCache::makeKey(const std::string& device_id, Tier tier, time_t block_start) {
+    return device_id + '\x1f' + std::to_string(static_cast<int>(tier)) + '\x1f' +
+           std::to_string(static_cast<long long>(block_start));
+}
+
+ResultCache::Shard& ResultCache::shardFor(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+void ResultCache::eraseLocked(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+}
+
+bool ResultCache::lookup(const std::string& device_id, Tier tier, time_t block_start,
+                         std::vector<SensorData>& rows) {
+    std::string key = makeKey(device_id, tier, block_start);
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+
+    const Entry& entry = *found->second;
+    for (const auto& cached : entry.rows) {
+        SensorData row;
+        row.device_id = entry.device_id;
+        row.timestamp = cached.timestamp;
+        row.temperature = cached.values[0];
+        row.humidity = cached.values[1];
+        row.co2 = cached.values[2];
+        row.pm25 = cached.values[3];
+        row.noise = cached.values[4];
+        row.light = cached.values[5];
+        row.area = entry.area;
+        row.area_type = entry.area_type;
+        row.has_aggregated_data = true;
+        row.is_hourly = tier == HOURLY;
+        row.has_min_max = true;
+        row.max_temperature = cached.max_temperature;
+        row.min_temperature = cached.min_temperature;
+        row.samples_count = cached.samples_count;
+        rows.push_back(std::move(row));
+    }
+    return true;
+}
+
+void ResultCache::insert(const std::string& device_id, Tier tier, time_t block_start,
+                         const std::vector<SensorData>& rows) {
+    Entry entry;
+    entry.key = makeKey(device_id, tier, block_start);
+    entry.tier = tier;
+    entry.block_start = block_start;
+    entry.device_id = device_id;
+    entry.area_type = AreaType::LIVING;
+    if (!rows.empty()) {
+        entry.area = rows.front().area;
+        entry.area_type = rows.front().area_type;
+    }
+    entry.rows.reserve(rows.size());
+    for (const auto& row : rows) {
+        entry.rows.push_back({row.timestamp,
+                              {row.temperature, row.humidity, row.co2,
+                               row.pm25, row.noise, row.light},
+                              row.max_temperature, row.min_temperature, row.samples_count});
+    }
+    entry.bytes = sizeof(Entry) + entry.key.size() * 2 + entry.device_id.size() +
+                  entry.area.size() + entry.rows.size() * sizeof(Row);
+    if (entry.bytes > shard_budget_) {
+        return;
+    }
+
+    Shard& shard = shardFor(entry.key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(entry.key);
+    if (found != shard.index.end()) {
+        eraseLocked(shard, found->second);
+    }
+
+    shard.bytes += entry.bytes;
+    shard.lru.push_front(std::move(entry));
+    shard.index[shard.lru.front().key] = shard.lru.begin();
+
+    while (shard.bytes > shard_budget_) {
+        eraseLocked(shard, std::prev(shard.lru.end()));
+        ++evictions_;
+    }
+}
+
+void ResultCache::invalidate(Tier tier, time_t start_time, time_t end_time) {
+    time_t first = blockStart(tier, start_time);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+            auto current = it++;
+            if (current->tier == tier && current->block_start >= first &&
+                current->block_start <= end_time) {
+                eraseLocked(shard, current);
+            }
+        }
+    }
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    Stats stats{hits_.load(), misses_.load(), evictions_.load(), 0, 0};
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.bytes += shard.bytes;
+        stats.entries += shard.lru.size();
+    }
+    return stats;
+}
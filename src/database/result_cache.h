@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../models/sensor_data.h"
+
+// 聚合层历史查询的结果缓存，键为 (设备, 数据层, 对齐的时间块)。
+// 已封闭的时间块内容不再变化，缓存到被 LRU 淘汰或被重新聚合/清理失效为止；
+// 仍在聚合中的尾部时间块不进入缓存。按字节数限制容量，分片减少锁竞争。
+class ResultCache {
+public:
+    enum Tier { HOURLY, DAILY, TIER_COUNT };
+
+    explicit ResultCache(size_t budget_bytes);
+
+    // 禁止拷贝
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // 命中时把该块的行追加到 rows
+    bool lookup(const std::string& device_id, Tier tier, time_t block_start,
+                std::vector<SensorData>& rows);
+    void insert(const std::string& device_id, Tier tier, time_t block_start,
+                const std::vector<SensorData>& rows);
+
+    // 使所有设备中与 [start_time, end_time] 重叠的时间块失效
+    void invalidate(Tier tier, time_t start_time, time_t end_time);
+
+    // 时间块长度：小时层一天，日层三十天
+    static time_t blockSpan(Tier tier) { return tier == HOURLY ? 24 * 3600 : 30 * 24 * 3600; }
+    static time_t blockStart(Tier tier, time_t timestamp);
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t bytes;
+        size_t entries;
+    };
+    Stats stats() const;
+
+    // 预算默认 64 MB，可由环境变量 EVM_RESULT_CACHE_MB 覆盖
+    static size_t budgetFromEnv();
+
+private:
+    // 聚合行的紧凑表示
+    struct Row {
+        int64_t timestamp;
+        double values[6];
+        double max_temperature;
+        double min_temperature;
+        int32_t samples_count;
+    };
+
+    struct Entry {
+        std::string key;
+        Tier tier;
+        time_t block_start;
+        std::string device_id;
+        std::string area;
+        AreaType area_type;
+        std::vector<Row> rows;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // 表头最近使用
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    static std::string makeKey(const std::string& device_id, Tier tier, time_t block_start);
+    Shard& shardFor(const std::string& key);
+    void eraseLocked(Shard& shard, std::list<Entry>::iterator it);
+
+    static constexpr size_t SHARD_COUNT = 16;
+    static constexpr size_t DEFAULT_BUDGET_MB = 64;
+
+    Shard shards_[SHARD_COUNT];
+    size_t shard_budget_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "../models/sensor_data.h"
+
+// 按时间顺序逐行读取查询结果，避免一次性物化整个结果集
+class RowCursor {
+public:
+    virtual ~RowCursor() = default;
+
+    // 读取下一行，没有更多数据时返回 false
+    virtual bool next(SensorData& row) = 0;
+
+    // 读取过程中是否发生错误，此时已返回的结果可能不完整
+    virtual bool failed() const { return false; }
+};
+
+// 基于已在内存中的结果的游标
+class VectorCursor : public RowCursor {
+public:
+    VectorCursor() = default;
+    explicit VectorCursor(std::vector<SensorData> rows) : rows_(std::move(rows)) {}
+
+    bool next(SensorData& row) override {
+        if (index_ >= rows_.size()) {
+            return false;
+        }
+        row = std::move(rows_[index_++]);
+        return true;
+    }
+
+private:
+    std::vector<SensorData> rows_;
+    size_t index_ = 0;
+};
+
+// 依次读取多个游标，前一个读完并释放后才打开下一个，
+// 因此同一时间最多占用一个数据库连接
+class ChainCursor : public RowCursor {
+public:
+    using Factory = std::function<std::unique_ptr<RowCursor>()>;
+
+    explicit ChainCursor(std::vector<Factory> parts) : parts_(std::move(parts)) {}
+
+    bool next(SensorData& row) override {
+        while (true) {
+            if (current_ && current_->next(row)) {
+                return true;
+            }
+            failed_ = failed_ || (current_ && current_->failed());
+            current_.reset();
+            if (index_ >= parts_.size()) {
+                return false;
+            }
+            current_ = parts_[index_++]();
+        }
+    }
+
+    bool failed() const override { return failed_ || (current_ && current_->failed()); }
+
+private:
+    std::vector<Factory> parts_;
+    size_t index_ = 0;
+    std::unique_ptr<RowCursor> current_;
+    bool failed_ = false;
+};
+
+// 把多个按时间升序的游标归并为一个按时间升序的游标。
+// 所有子游标同时处于打开状态，调用方需保证其中最多一个占用数据库连接
+class MergeCursor : public RowCursor {
+public:
+    explicit MergeCursor(std::vector<std::unique_ptr<RowCursor>> sources)
+        : sources_(std::move(sources))
+        , heads_(sources_.size())
+        , valid_(sources_.size(), false) {
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            valid_[i] = sources_[i]->next(heads_[i]);
+        }
+    }
+
+    bool next(SensorData& row) override {
+        // 子游标数量等于设备数，线性选择最早的行即可
+        size_t best = sources_.size();
+        for (size_t i = 0; i < sources_.size(); ++i) {
+            if (valid_[i] && (best == sources_.size() || heads_[i].timestamp < heads_[best].timestamp)) {
+                best = i;
+            }
+        }
+        if (best == sources_.size()) {
+            return false;
+        }
+        row = std::move(heads_[best]);
+        valid_[best] = sources_[best]->next(heads_[best]);
+        return true;
+    }
+
+    bool failed() const override {
+        for (const auto& source : sources_) {
+            if (source->failed()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::unique_ptr<RowCursor>> sources_;
+    std::vector<SensorData> heads_;
+    std::vector<bool> valid_;
+};
@@ -0,0 +1,325 @@
+#include "storage.h"
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include "database.h"
+#include "embedded_storage.h"
+
+Storage& Storage::getInstance() {
+    static Storage& instance = []() -> Storage& {
+        const char* backend = std::getenv("EVM_STORAGE");
+        if (backend && std::string(backend) == "embedded") {
+            const char* dir = std::getenv("EVM_DATA_DIR");
+            static EmbeddedStorage embedded(dir ? dir : "data");
+            std::cout << "[Storage] Using embedded storage" << std::endl;
+            return embedded;
+        }
+        return Database::getInstance();
+    }();
+    return instance;
+}
+
+namespace {
+
+// 严格晚于 timestamp 的下一个本地零点
+time_t nextLocalMidnight(time_t timestamp) {
+    struct tm tm;
+    localtime_r(&timestamp, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_mday += 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+} // namespace
+
+std::unique_ptr<RowCursor> Storage::openHistoryCursor(const std::string& device_id,
+                                                      time_t start_time,
+                                                      time_t end_time) {
+    if (end_time < start_time) {
+        return std::make_unique<VectorCursor>();
+    }
+    
+    // 各层覆盖范围的起点：实时层对齐到整点、小时层对齐到零点，
+    // 保证相邻两层的聚合桶互不重叠
+    time_t now = time(nullptr);
+    time_t raw_from = now - REALTIME_DATA_RETENTION_HOURS * 3600;
+    raw_from -= raw_from % 3600;
+    time_t hourly_from = nextLocalMidnight(now - HOURLY_DATA_RETENTION_DAYS * 24 * 3600);
+    
+    using RowsFuture = std::future<std::vector<SensorData>>;
+    std::vector<ChainCursor::Factory> parts;
+    
+    // 聚合层的结果行数很少，并行查询并在内存中等待拼接
+    auto launch = [&](ResultCache::Tier tier, time_t from, time_t to) {
+        auto rows = std::make_shared<RowsFuture>(std::async(std::launch::async,
+            [this, tier, device_id, from, to]() {
+                auto cursor = openCachedCursor(tier, device_id, from, to);
+                return drain(*cursor);
+            }));
+        parts.push_back([rows]() -> std::unique_ptr<RowCursor> {
+            return std::make_unique<VectorCursor>(rows->get());
+        });
+    };
+    
+    if (start_time < hourly_from) {
+        launch(ResultCache::DAILY, start_time, std::min(end_time, hourly_from - 1));
+    }
+    if (start_time < raw_from && end_time >= hourly_from) {
+        launch(ResultCache::HOURLY, std::max(start_time, hourly_from),
+               std::min(end_time, raw_from - 1));
+    }
+    
+    // 原始数据量最大，放在最后流式读取：前面的部分读完后才占用连接，
+    // 避免持有连接时再等待连接池
+    if (end_time >= raw_from) {
+        time_t from = std::max(start_time, raw_from);
+        parts.push_back([this, device_id, from, end_time]() {
+            return openRawCursor(device_id, from, end_time);
+        });
+    }
+    
+    return std::make_unique<ChainCursor>(std::move(parts));
+}
+
+std::unique_ptr<RowCursor> Storage::openRawCursor(const std::string& device_id,
+                                                  time_t start_time,
+                                                  time_t end_time) {
+    time_t covered_from = hot_tier_.coveredFrom(device_id);
+    if (covered_from <= start_time) {
+        return hot_tier_.openCursor(device_id, start_time, end_time);
+    }
+    if (covered_from > end_time) {
+        return openRealtimeCursor(device_id, start_time, end_time);
+    }
+    
+    // 热层覆盖起点之前的部分查询后端，之后的部分从内存读取
+    std::vector<ChainCursor::Factory> parts;
+    parts.push_back([this, device_id, start_time, covered_from]() {
+        return openRealtimeCursor(device_id, start_time, covered_from - 1);
+    });
+    parts.push_back([this, device_id, covered_from, end_time]() {
+        return hot_tier_.openCursor(device_id, covered_from, end_time);
+    });
+    return std::make_unique<ChainCursor>(std::move(parts));
+}
+
+std::unique_ptr<RowCursor> Storage::openCachedCursor(ResultCache::Tier tier,
+                                                     const std::string& device_id,
+                                                     time_t start_time,
+                                                     time_t end_time) {
+    auto open = [&](time_t from, time_t to) {
+        return tier == ResultCache::HOURLY ? openHourlyCursor(device_id, from, to)
+                                           : openDailyCursor(device_id, from, to);
+    };
+    auto append_in_range = [&](std::vector<SensorData>& out, std::vector<SensorData>& rows) {
+        for (auto& row : rows) {
+            if (row.timestamp >= start_time && row.timestamp <= end_time) {
+                out.push_back(std::move(row));
+            }
+        }
+    };
+    
+    // 保留期之前没有数据，避免从 0 开始逐块查询
+    time_t now = time(nullptr);
+    time_t retention = tier == ResultCache::HOURLY
+                           ? static_cast<time_t>(HOURLY_DATA_RETENTION_DAYS) * 24 * 3600
+                           : static_cast<time_t>(DAILY_DATA_RETENTION_DAYS) * 24 * 3600;
+    start_time = std::max(start_time, now - retention - ResultCache::blockSpan(tier));
+    if (end_time < start_time) {
+        return std::make_unique<VectorCursor>();
+    }
+    
+    // 尚在聚合中的尾部：小时层从上一个整点起，日层从前一天起
+    time_t open_from = tier == ResultCache::HOURLY ? now - now % 3600 - 3600 : now - 2 * 24 * 3600;
+    time_t span = ResultCache::blockSpan(tier);
+    time_t last_closed = std::min(ResultCache::blockStart(tier, end_time),
+                                  ResultCache::blockStart(tier, open_from - span));
+    
+    std::vector<SensorData> rows;
+    std::vector<SensorData> block_rows;
+    time_t block = ResultCache::blockStart(tier, start_time);
+    while (block <= last_closed) {
+        block_rows.clear();
+        if (result_cache_.lookup(device_id, tier, block, block_rows)) {
+            append_in_range(rows, block_rows);
+            block += span;
+            continue;
+        }
+        
+        // 未命中时把剩余的封闭时间块合并为一次查询，按块拆分后写入缓存
+        auto cursor = open(block, last_closed + span - 1);
+        auto fetched = drain(*cursor);
+        if (!cursor->failed()) {
+            auto it = fetched.begin();
+            for (time_t b = block; b <= last_closed; b += span) {
+                auto block_end = std::find_if(it, fetched.end(), [&](const SensorData& row) {
+                    return row.timestamp >= b + span;
+                });
+                result_cache_.insert(device_id, tier, b, std::vector<SensorData>(it, block_end));
+                it = block_end;
+            }
+        }
+        append_in_range(rows, fetched);
+        block = last_closed + span;
+    }
+    
+    // 尾部时间块每次重新查询，不进入缓存
+    if (block <= end_time) {
+        auto cursor = open(std::max(start_time, block), end_time);
+        auto tail = drain(*cursor);
+        append_in_range(rows, tail);
+    }
+    return std::make_unique<VectorCursor>(std::move(rows));
+}
+
+std::unique_ptr<RowCursor> Storage::openDevicesCursor(DataTier tier,
+                                                      const std::vector<std::string>& device_ids,
+                                                      time_t start_time,
+                                                      time_t end_time) {
+    std::vector<std::unique_ptr<RowCursor>> cursors;
+    for (const auto& device_id : device_ids) {
+        switch (tier) {
+            case DataTier::REALTIME:
+                cursors.push_back(openRealtimeCursor(device_id, start_time, end_time));
+                break;
+            case DataTier::HOURLY:
+                cursors.push_back(openHourlyCursor(device_id, start_time, end_time));
+                break;
+            case DataTier::DAILY:
+                cursors.push_back(openDailyCursor(device_id, start_time, end_time));
+                break;
+        }
+    }
+    return std::make_unique<MergeCursor>(std::move(cursors));
+}
+
+std::unique_ptr<RowCursor> Storage::openMultiHistoryCursor(DataTier tier,
+                                                           const std::vector<std::string>& device_ids,
+                                                           time_t start_time,
+                                                           time_t end_time) {
+    std::vector<std::unique_ptr<RowCursor>> cursors;
+    std::vector<std::string> backend_ids;
+    for (const auto& device_id : device_ids) {
+        if (tier == DataTier::REALTIME && hot_tier_.coveredFrom(device_id) <= start_time) {
+            cursors.push_back(hot_tier_.openCursor(device_id, start_time, end_time));
+        } else {
+            backend_ids.push_back(device_id);
+        }
+    }
+    
+    // 热层游标只是内存快照，归并时只有后端游标占用连接
+    if (!backend_ids.empty()) {
+        cursors.push_back(openDevicesCursor(tier, backend_ids, start_time, end_time));
+    }
+    return std::make_unique<MergeCursor>(std::move(cursors));
+}
+
+bool Storage::queryPercentiles(const std::vector<std::string>& device_ids,
+                               time_t start_time,
+                               time_t end_time,
+                               ChannelSketches& sketches) {
+    if (end_time < start_time || device_ids.empty()) {
+        return true;
+    }
+    
+    time_t now = time(nullptr);
+    time_t hour_start = now - now % 3600;
+    time_t hourly_from = nextLocalMidnight(now - HOURLY_DATA_RETENTION_DAYS * 24 * 3600);
+    
+    if (start_time < hourly_from &&
+        !mergeSketches(DataTier::DAILY, device_ids, start_time,
+                       std::min(end_time, hourly_from - 1), sketches)) {
+        return false;
+    }
+    if (end_time >= hourly_from && std::max(start_time, hourly_from) < hour_start &&
+        !mergeSketches(DataTier::HOURLY, device_ids, std::max(start_time, hourly_from),
+                       std::min(end_time, hour_start - 1), sketches)) {
+        return false;
+    }
+    
+    // 当前小时最多一小时的原始数据，通常直接从热层读取
+    if (end_time >= hour_start) {
+        auto cursor = openMultiHistoryCursor(DataTier::REALTIME, device_ids,
+                                             std::max(start_time, hour_start), end_time);
+        SensorData row;
+        while (cursor->next(row)) {
+            sketches.add(row);
+        }
+        return !cursor->failed();
+    }
+    return true;
+}
+
+std::vector<SensorData> Storage::getHistoryData(const std::string& device_id,
+                                                time_t start_time,
+                                                time_t end_time) {
+    auto cursor = openHistoryCursor(device_id, start_time, end_time);
+    return drain(*cursor);
+}
+
+std::vector<SensorData> Storage::queryRealtimeData(const std::string& device_id,
+                                                   time_t start_time,
+                                                   time_t end_time) {
+    auto cursor = openRawCursor(device_id, start_time, end_time);
+    auto result = drain(*cursor);
+#ifdef DEBUG_MODE
+    std::cout << "[Storage] Found " << result.size() << " rows" << std::endl;
+#endif
+    return result;
+}
+
+std::vector<SensorData> Storage::queryHourlyData(const std::string& device_id,
+                                                 time_t start_time,
+                                                 time_t end_time) {
+    auto cursor = openCachedCursor(ResultCache::HOURLY, device_id, start_time, end_time);
+    return drain(*cursor);
+}
+
+std::vector<SensorData> Storage::queryDailyData(const std::string& device_id,
+                                                time_t start_time,
+                                                time_t end_time) {
+    auto cursor = openCachedCursor(ResultCache::DAILY, device_id, start_time, end_time);
+    return drain(*cursor);
+}
+
+void Storage::noteIngested(time_t timestamp) {
+    noteRawIngested(timestamp);
+    if (timestamp >= aggregated_until_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    dirty_hours_[timestamp - timestamp % 3600] = time(nullptr);
+}
+
+std::vector<time_t> Storage::takeDirtyHours(time_t noted_before) {
+    std::vector<time_t> hours;
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    for (auto it = dirty_hours_.begin(); it != dirty_hours_.end();) {
+        // 最近仍有迟到数据的小时等数据沉淀后再处理
+        if (it->second < noted_before) {
+            hours.push_back(it->first);
+            it = dirty_hours_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return hours;
+}
+
+void Storage::markDirtyHour(time_t hour_start) {
+    std::lock_guard<std::mutex> lock(dirty_mutex_);
+    dirty_hours_.emplace(hour_start, 0);
+}
+
+std::vector<SensorData> Storage::drain(RowCursor& cursor) {
+    std::vector<SensorData> result;
+    SensorData row;
+    while (cursor.next(row)) {
+        result.push_back(std::move(row));
+    }
+    return result;
+}
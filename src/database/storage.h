@@ -0,0 +1,166 @@
+#pragma once
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../models/sensor_data.h"
+#include "../utils/ddsketch.h"
+#include "hot_tier.h"
+#include "result_cache.h"
+#include "row_cursor.h"
+
+// 历史数据层
+enum class DataTier { REALTIME, HOURLY, DAILY };
+
+// 传感器数据存储接口，MySQL 和嵌入式两种后端实现
+class Storage {
+public:
+    virtual ~Storage() = default;
+
+    // 按环境变量 EVM_STORAGE 选择后端：mysql（默认）或 embedded，
+    // 嵌入式后端的数据目录由 EVM_DATA_DIR 指定（默认 data）
+    static Storage& getInstance();
+
+    // 只读打开，须在第一次 getInstance 之前调用：MySQL 后端不建表、不做结构迁移，
+    // 供导出等离线工具使用，避免在旧库上触发重建表的 ALTER TABLE
+    static void setReadOnly() { read_only_ = true; }
+    static bool readOnly() { return read_only_; }
+
+    // 数据插入
+    virtual bool insertSensorData(const SensorData& data) = 0;
+    virtual bool batchInsertSensorData(const std::vector<SensorData>& data) = 0;
+
+    // 分层范围查询，游标按时间升序返回
+    virtual std::unique_ptr<RowCursor> openRealtimeCursor(const std::string& device_id,
+                                                          time_t start_time,
+                                                          time_t end_time) = 0;
+    virtual std::unique_ptr<RowCursor> openHourlyCursor(const std::string& device_id,
+                                                        time_t start_time,
+                                                        time_t end_time) = 0;
+    virtual std::unique_ptr<RowCursor> openDailyCursor(const std::string& device_id,
+                                                       time_t start_time,
+                                                       time_t end_time) = 0;
+
+    // 多设备范围查询，游标按时间升序返回所有设备的行。
+    // 默认归并各设备的游标，MySQL 后端用一条 IN 查询代替
+    virtual std::unique_ptr<RowCursor> openDevicesCursor(DataTier tier,
+                                                         const std::vector<std::string>& device_ids,
+                                                         time_t start_time,
+                                                         time_t end_time);
+
+    // 批量导出的游标。导出可能随慢客户端持续很久，MySQL 后端为其使用专用连接，
+    // 不占用在线查询和写入的连接；同时进行的导出达到上限时返回 nullptr
+    virtual std::unique_ptr<RowCursor> openExportCursor(DataTier tier,
+                                                        const std::vector<std::string>& device_ids,
+                                                        time_t start_time,
+                                                        time_t end_time) {
+        return openDevicesCursor(tier, device_ids, start_time, end_time);
+    }
+
+    // 数据维护：聚合 [window_start, window_end) 内的完整小时或本地自然日，以及按保留期清理
+    virtual bool aggregateHourlyData(time_t window_start, time_t window_end) = 0;
+    virtual bool aggregateDailyData(time_t window_start, time_t window_end) = 0;
+    virtual bool cleanupOldData() = 0;
+
+    // 维护任务的进度水位，持久化保存以便重启后补做错过的窗口。
+    // 没有保存过的任务返回 true 且不修改 watermark
+    virtual bool loadWatermark(const std::string& task, time_t& watermark) = 0;
+    virtual bool saveWatermark(const std::string& task, time_t watermark) = 0;
+
+    // 把已结束时间窗口的原始数据封存为压缩块，不需要封存的后端直接返回
+    virtual bool sealRawBlocks() { return true; }
+
+    // 合并小时或每日聚合行中保存的分位数草图，不保存草图的后端返回 false，
+    // 调用方先用 hasSketches 区分不支持和查询失败
+    virtual bool hasSketches() const { return false; }
+    virtual bool mergeSketches(DataTier /*tier*/,
+                               const std::vector<std::string>& /*device_ids*/,
+                               time_t /*start_time*/,
+                               time_t /*end_time*/,
+                               ChannelSketches& /*sketches*/) {
+        return false;
+    }
+
+    // 原始数据游标：热层完整覆盖的部分从内存读取，更早的部分查询后端
+    std::unique_ptr<RowCursor> openRawCursor(const std::string& device_id,
+                                             time_t start_time,
+                                             time_t end_time);
+
+    // 聚合层游标：已封闭的时间块从结果缓存读取，未命中时查询后端并写入缓存
+    std::unique_ptr<RowCursor> openCachedCursor(ResultCache::Tier tier,
+                                                const std::string& device_id,
+                                                time_t start_time,
+                                                time_t end_time);
+
+    // 多设备历史查询：热层完整覆盖的设备从内存读取，其余设备合并为一次后端查询
+    std::unique_ptr<RowCursor> openMultiHistoryCursor(DataTier tier,
+                                                      const std::vector<std::string>& device_ids,
+                                                      time_t start_time,
+                                                      time_t end_time);
+
+    // 按保留期把时间范围拆分到日/小时/实时三层，每段使用可用的最细粒度，
+    // 聚合层并行查询，结果按时间顺序拼接
+    std::unique_ptr<RowCursor> openHistoryCursor(const std::string& device_id,
+                                                 time_t start_time,
+                                                 time_t end_time);
+    // 任意时间范围的分位数草图：按与 openHistoryCursor 相同的保留期边界合并每日和小时草图，
+    // 尚未聚合的当前小时从原始数据补齐
+    bool queryPercentiles(const std::vector<std::string>& device_ids,
+                          time_t start_time,
+                          time_t end_time,
+                          ChannelSketches& sketches);
+
+    std::vector<SensorData> getHistoryData(const std::string& device_id,
+                                           time_t start_time,
+                                           time_t end_time);
+
+    std::vector<SensorData> queryRealtimeData(const std::string& device_id,
+                                              time_t start_time,
+                                              time_t end_time);
+    std::vector<SensorData> queryHourlyData(const std::string& device_id,
+                                            time_t start_time,
+                                            time_t end_time);
+    std::vector<SensorData> queryDailyData(const std::string& device_id,
+                                           time_t start_time,
+                                           time_t end_time);
+
+    // 迟到数据：由数据接收端在写入时调用，读数早于已聚合到的小时水位时标记所在小时为脏。
+    // 维护任务取出标记时间早于 noted_before 的脏小时重新聚合，失败时放回
+    void noteIngested(time_t timestamp);
+    void setAggregatedUntil(time_t watermark) { aggregated_until_ = watermark; }
+    std::vector<time_t> takeDirtyHours(time_t noted_before);
+    void markDirtyHour(time_t hour_start);
+
+    // 最近数据的内存热层，由数据接收端在写入存储的同时追加
+    HotTier& hotTier() { return hot_tier_; }
+    const ResultCache& resultCache() const { return result_cache_; }
+
+    static constexpr int REALTIME_DATA_RETENTION_HOURS = 24;
+    static constexpr int HOURLY_DATA_RETENTION_DAYS = 30;
+    static constexpr int DAILY_DATA_RETENTION_DAYS = 365;
+    static constexpr int MAX_BATCH_SIZE = 1000;
+
+protected:
+    static std::vector<SensorData> drain(RowCursor& cursor);
+
+    // 由 noteIngested 对每条读数调用，供存储后端跟踪自己的迟到数据
+    virtual void noteRawIngested(time_t) {}
+
+    // 聚合或清理改写了某层数据后调用，使重叠的缓存块失效
+    void invalidateCached(ResultCache::Tier tier, time_t start_time, time_t end_time) {
+        result_cache_.invalidate(tier, start_time, end_time);
+    }
+
+private:
+    static inline std::atomic<bool> read_only_{false};
+
+    HotTier hot_tier_{REALTIME_DATA_RETENTION_HOURS * 3600, HotTier::budgetFromEnv()};
+    ResultCache result_cache_{ResultCache::budgetFromEnv()};
+
+    std::atomic<time_t> aggregated_until_{0};
+    std::mutex dirty_mutex_;
+    std::map<time_t, time_t> dirty_hours_;  // 小时起点 -> 最近一次标记的时间
+};
@@ -0,0 +1,266 @@
+#include "device_fragments.h"
+#include "../utils/json_writer.h"
+
+namespace {
+
+// 评分详情沿用接口原有的计算方式，与入库时 EnvironmentScorer 的评分规则不同
+double calculateHumidityScore(double humidity) {
+    if (humidity >= 40 && humidity <= 60) return 100;
+    if (humidity < 40) return 100 - (40 - humidity) * 2;
+    return 100 - (humidity - 60) * 2;
+}
+
+double calculateCO2Score(double co2) {
+    if (co2 <= 800) return 100;
+    if (co2 <= 1000) return 80;
+    if (co2 <= 1500) return 60;
+    if (co2 <= 2000) return 40;
+    return 20;
+}
+
+double calculatePM25Score(double pm25) {
+    if (pm25 <= 35) return 100;
+    if (pm25 <= 75) return 80;
+    if (pm25 <= 115) return 60;
+    if (pm25 <= 150) return 40;
+    return 20;
+}
+
+double calculateNoiseScore(double noise, AreaType area_type) {
+    switch (area_type) {
+        case AreaType::LIVING:
+            // 生活区要求安静
+            if (noise <= 40) return 100;
+            if (noise <= 50) return 80;
+            if (noise <= 60) return 60;
+            if (noise <= 70) return 40;
+            return 20;
+            
+        case AreaType::TEACHING:
+            // 教学区要求较安静
+            if (noise <= 45) return 100;
+            if (noise <= 55) return 80;
+            if (noise <= 65) return 60;
+            if (noise <= 75) return 40;
+            return 20;
+            
+        case AreaType::RECREATION:
+            // 娱乐区允许较大噪音
+            if (noise <= 55) return 100;
+            if (noise <= 65) return 80;
+            if (noise <= 75) return 60;
+            if (noise <= 85) return 40;
+            return 20;
+    }
+    return 0;
+}
+
+double calculateLightScore(double light, AreaType area_type) {
+    switch (area_type) {
+        case AreaType::LIVING:
+            // 生活区光照要求舒适
+            if (light >= 200 && light <= 500) return 100;
+            if (light < 200) return 60 + (light / 200) * 40;
+            if (light <= 750) return 80;
+            if (light <= 1000) return 60;
+            return 40;
+            
+        case AreaType::TEACHING:
+            // 教学区要求充足明亮
+            if (light >= 400 && light <= 750) return 100;
+            if (light < 400) return 60 + (light / 400) * 40;
+            if (light <= 1000) return 80;
+            if (light <= 1500) return 60;
+            return 40;
+            
+        case AreaType::RECREATION:
+            // 娱乐区光照要求灵活
+            if (light >= 300 && light <= 1000) return 100;
+            if (light < 300) return 60 + (light / 300) * 40;
+            if (light <= 1500) return 80;
+            if (light <= 2000) return 60;
+            return 40;
+    }
+    return 0;
+}
+
+std::string getTemperatureStatus(double temp, AreaType type) {
+    switch (type) {
+        case AreaType::LIVING:
+            if (temp >= 22 && temp <= 26) return "适宜";
+            if (temp < 22) return "偏冷";
+            return "偏热";
+            
+        case AreaType::TEACHING:
+            if (temp >= 20 && temp <= 25) return "适宜";
+            if (temp < 20) return "偏冷";
+            return "偏热";
+            
+        case AreaType::RECREATION:
+            if (temp >= 18 && temp <= 27) return "适宜";
+            if (temp < 18) return "偏冷";
+            return "偏热";
+    }
+    return "异常";
+}
+
+std::string getHumidityStatus(double humidity) {
+    if (humidity >= 40 && humidity <= 60) return "正常";
+    if (humidity < 40) return "偏干";
+    return "偏湿";
+}
+
+std::string getCO2Status(double co2) {
+    if (co2 <= 800) return "优";
+    if (co2 <= 1000) return "良";
+    if (co2 <= 1500) return "中";
+    if (co2 <= 2000) return "差";
+    return "很差";
+}
+
+std::string getPM25Status(double pm25) {
+    if (pm25 <= 35) return "优";
+    if (pm25 <= 75) return "良";
+    if (pm25 <= 115) return "中";
+    if (pm25 <= 150) return "差";
+    return "很差";
+}
+
+std::string getNoiseStatus(double noise, AreaType type) {
+    switch (type) {
+        case AreaType::LIVING:
+            if (noise <= 40) return "安静";
+            if (noise <= 50) return "适中";
+            if (noise <= 60) return "较吵";
+            return "很吵";
+            
+        case AreaType::TEACHING:
+            if (noise <= 45) return "安静";
+            if (noise <= 55) return "适中";
+            if (noise <= 65) return "较吵";
+            return "很吵";
+            
+        case AreaType::RECREATION:
+            if (noise <= 55) return "适中";
+            if (noise <= 65) return "正常";
+            if (noise <= 75) return "较吵";
+            return "很吵";
+    }
+    return "异常";
+}
+
+std::string getLightStatus(double light, AreaType type) {
+    switch (type) {
+        case AreaType::LIVING:
+            if (light >= 200 && light <= 500) return "适宜";
+            if (light < 200) return "偏暗";
+            return "偏亮";
+            
+        case AreaType::TEACHING:
+            if (light >= 400 && light <= 750) return "适宜";
+            if (light < 400) return "偏暗";
+            return "偏亮";
+            
+        case AreaType::RECREATION:
+            if (light >= 300 && light <= 1000) return "适宜";
+            if (light < 300) return "偏暗";
+            return "偏亮";
+    }
+    return "异常";
+}
+
+void writeScores(JsonWriter& json, const SensorData& data) {
+    json.beginObject()
+        .member("temperature", data.scores.temperature)
+        .member("humidity", data.scores.humidity)
+        .member("co2", data.scores.co2)
+        .member("pm25", data.scores.pm25)
+        .member("noise", data.scores.noise)
+        .member("light", data.scores.light)
+        .member("overall", data.scores.overall)
+        .endObject();
+}
+
+void writeScoreDetail(JsonWriter& json, const char* name, double value, double score, const std::string& status) {
+    json.key(name).beginObject()
+        .member("value", value)
+        .member("score", score)
+        .member("status", status)
+        .endObject();
+}
+
+} // namespace
+
+std::shared_ptr<const DeviceFragments> DeviceFragments::build(const SensorData& data) {
+    auto fragments = std::make_shared<DeviceFragments>();
+    
+    // 完整读数，以 "device_status": 结尾
+    JsonWriter full(fragments->full);
+    full.beginObject()
+        .member("device_id", data.device_id)
+        .member("area", data.area)
+        .member("area_type", static_cast<int>(data.area_type))
+        .member("temperature", data.temperature)
+        .member("humidity", data.humidity)
+        .member("co2", data.co2)
+        .member("pm25", data.pm25)
+        .member("noise", data.noise)
+        .member("light", data.light)
+        .member("timestamp", static_cast<long long>(data.timestamp));
+    full.key("scores");
+    writeScores(full, data);
+    full.key("status").beginObject()
+        .member("temperature", data.status.temperature)
+        .member("humidity", data.status.humidity)
+        .member("co2", data.status.co2)
+        .member("pm25", data.status.pm25)
+        .member("noise", data.status.noise)
+        .member("light", data.status.light)
+        .endObject();
+    full.key("suggestions").beginArray();
+    for (const auto& suggestion : data.suggestions) {
+        full.value(suggestion);
+    }
+    full.endArray();
+    full.key("device_status");
+    
+    // 设备列表项，以 "status": 结尾
+    JsonWriter summary(fragments->summary);
+    summary.beginObject()
+        .member("device_id", data.device_id)
+        .member("area", data.area)
+        .member("area_type", static_cast<int>(data.area_type))
+        .key("status");
+    
+    // 评分和各项指标详情
+    JsonWriter scores(fragments->scores);
+    scores.beginObject().member("device_id", data.device_id);
+    scores.key("scores");
+    writeScores(scores, data);
+    scores.key("details").beginObject();
+    writeScoreDetail(scores, "temperature", data.temperature, data.scores.temperature,
+                     getTemperatureStatus(data.temperature, data.area_type));
+    writeScoreDetail(scores, "humidity", data.humidity, calculateHumidityScore(data.humidity),
+                     getHumidityStatus(data.humidity));
+    writeScoreDetail(scores, "co2", data.co2, calculateCO2Score(data.co2), getCO2Status(data.co2));
+    writeScoreDetail(scores, "pm25", data.pm25, calculatePM25Score(data.pm25), getPM25Status(data.pm25));
+    writeScoreDetail(scores, "noise", data.noise, calculateNoiseScore(data.noise, data.area_type),
+                     getNoiseStatus(data.noise, data.area_type));
+    writeScoreDetail(scores, "light", data.light, calculateLightScore(data.light, data.area_type),
+                     getLightStatus(data.light, data.area_type));
+    scores.endObject();
+    scores.member("timestamp", static_cast<long long>(data.timestamp)).endObject();
+    
+    return fragments;
+}
+
+std::shared_ptr<const DeviceFragments> DeviceFragments::build(const std::string& device_id) {
+    auto fragments = std::make_shared<DeviceFragments>();
+    JsonWriter summary(fragments->summary);
+    summary.beginObject()
+        .member("device_id", device_id)
+        .member("area", "")
+        .member("area_type", 0)
+        .key("status");
+    return fragments;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "../models/sensor_data.h"
+
+// 设备最新状态预先序列化成的 JSON 片段。
+// 每条读数到达时生成一次，各设备接口直接拼接片段输出，不再为每个请求构建 JSON 树。
+// 随时间变化的字段（在线状态、心跳时间）不在片段中，由请求方追加在末尾：
+//   full    + "1}" 或 "0}"                    完整读数，末尾为 "device_status":
+//   summary + "<status>,\"last_update\":<t>}" 设备列表项，末尾为 "status":
+//   scores                                   评分和各项指标详情，完整对象
+struct DeviceFragments {
+    std::string full;
+    std::string summary;
+    std::string scores;
+
+    bool hasData() const { return !full.empty(); }
+
+    // 由最新读数生成全部片段
+    static std::shared_ptr<const DeviceFragments> build(const SensorData& data);
+    // 尚无读数的设备只有设备列表项
+    static std::shared_ptr<const DeviceFragments> build(const std::string& device_id);
+};
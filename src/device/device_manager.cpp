@@ -20,8 +20,10 @@ bool DeviceManager::registerDevice(const std::string& device_id,
     device->register_time = std::time(nullptr);
     device->last_heartbeat = device->register_time;
     device->last_seen = device->register_time;
+    device->fragments = DeviceFragments::build(device_id);
     
     devices_[device_id] = device;
+    version_.fetch_add(1, std::memory_order_release);
     return true;
 }
 
@@ -30,6 +32,7 @@ void DeviceManager::updateDeviceStatus(const std::string& device_id, DeviceStatu
     
     if (auto it = devices_.find(device_id); it != devices_.end()) {
         it->second->status = status;
+        version_.fetch_add(1, std::memory_order_release);
     }
 }
 
@@ -41,10 +44,13 @@ void DeviceManager::updateHeartbeat(const std::string& device_id) {
         if (it->second->status == DeviceStatus::OFFLINE) {
             it->second->status = DeviceStatus::ONLINE;
         }
+        version_.fetch_add(1, std::memory_order_release);
     }
 }
 
 void DeviceManager::addSensorData(const std::string& device_id, const SensorData& data) {
+    // 每条读数只序列化一次，在锁外完成
+    auto fragments = DeviceFragments::build(data);
     std::lock_guard<std::mutex> lock(mutex_);
     
     if (auto it = devices_.find(device_id); it != devices_.end()) {
@@ -52,6 +58,8 @@ void DeviceManager::addSensorData(const std::string& device_id, const SensorData
         if (it->second->recent_data.size() > 100) {
             it->second->recent_data.erase(it->second->recent_data.begin());
         }
+        std::atomic_store(&it->second->fragments, fragments);
+        version_.fetch_add(1, std::memory_order_release);
     }
 }
 
@@ -129,6 +137,7 @@ bool DeviceManager::unregisterDevice(const std::string& device_id) {
     auto it = devices_.find(device_id);
     if (it != devices_.end()) {
         devices_.erase(it);
+        version_.fetch_add(1, std::memory_order_release);
         return true;
     }
     return false;
@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -6,6 +8,7 @@
 #include <vector>
 #include <deque>
 #include "../models/sensor_data.h"
+#include "device_fragments.h"
 
 // 设备状态
 enum class DeviceStatus {
@@ -25,6 +28,8 @@ struct DeviceInfo {
     time_t last_seen;
     time_t register_time;
     std::deque<SensorData> recent_data;  // 最近的数据缓存
+    // 最新状态的 JSON 片段，读写都通过 std::atomic_load / std::atomic_store
+    std::shared_ptr<const DeviceFragments> fragments;
     
     // 设备配置
     struct Config {
@@ -41,6 +46,8 @@ struct DeviceInfo {
 
 class DeviceManager {
 public:
+    static constexpr time_t ONLINE_TIMEOUT = 30;  // 30秒内有心跳就认为在线
+
     static DeviceManager& getInstance() {
         static DeviceManager instance;
         return instance;
@@ -57,7 +64,7 @@ public:
     // 更新设备心跳
     void updateHeartbeat(const std::string& device_id);
     
-    // 添加传感器数据
+    // 添加传感器数据，同时生成该读数的 JSON 片段
     void addSensorData(const std::string& device_id, const SensorData& data);
     
     // 获取设备信息
@@ -79,6 +86,9 @@ public:
 
     const std::map<std::string, std::shared_ptr<DeviceInfo>>& getDevices() const { return devices_; }
 
+    // 设备集合或任一设备的数据、心跳发生变化时递增，用于判断缓存的实时快照是否过期
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
 private:
     DeviceManager() = default;
     ~DeviceManager() = default;
@@ -87,4 +97,5 @@ private:
 
     std::map<std::string, std::shared_ptr<DeviceInfo>> devices_;
     mutable std::mutex mutex_;
+    std::atomic<uint64_t> version_{0};
 }; 
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "network/tcp_server.h"
 #include "network/http_server.h"
 #include "tasks/data_maintenance.h"
+#include "database/database.h"
 #include <iostream>
 #include <thread>
 #include <csignal>
@@ -23,14 +24,25 @@ int main() {
         auto tcp_work_guard = boost::asio::make_work_guard(tcp_io_context);
         auto http_work_guard = boost::asio::make_work_guard(http_io_context);
         
-        // 获取数据库单例
-        auto& db = Database::getInstance();
+        // 获取存储后端
+        auto& storage = Storage::getInstance();
         
         // 启动数据维护任务
         DataMaintenanceTask::getInstance().start();
         
+        // 异步数据库客户端仅用于 MySQL 后端，运行在 TCP io_context 上处理数据写入
+        std::unique_ptr<AsyncDatabase> async_db;
+        if (auto* mysql = dynamic_cast<Database*>(&storage)) {
+            async_db = std::make_unique<AsyncDatabase>(tcp_io_context, mysql->connectionInfo(), 4);
+            async_db->start();
+        }
+        
+        // 数据库不可用时的本地预写日志，恢复后自动回放
+        IngestSpool spool("spool", storage);
+        spool.start();
+        
         // 启动 TCP 服务器
-        TCPServer tcp_server(tcp_io_context, 8888, db);
+        TCPServer tcp_server(tcp_io_context, 8888, storage, async_db.get(), &spool);
         tcp_server.start();
         
         // 启动 HTTP 服务器
@@ -53,8 +65,9 @@ int main() {
             });
         }
         
-        // 启动 HTTP 工作线程
-        for (int i = 0; i < num_threads - 1; ++i) {
+        // 启动 HTTP 工作线程，线程数由 EVM_HTTP_THREADS 配置
+        const size_t num_http_threads = HTTPServer::threadsFromEnv();
+        for (size_t i = 0; i < num_http_threads; ++i) {
             http_threads.emplace_back([&http_server]() {
                 try {
                     http_server.run();
@@ -83,6 +96,11 @@ int main() {
             thread.join();
         }
         
+        if (async_db) {
+            async_db->stop();
+        }
+        spool.stop();
+        
         // 停止数据维护任务
         DataMaintenanceTask::getInstance().stop();
         
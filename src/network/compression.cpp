@@ -0,0 +1,284 @@
+#include "compression.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <zlib.h>
+#ifdef EVM_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+bool supported(ContentEncoding encoding) {
+#ifndef EVM_HAVE_BROTLI
+    if (encoding == ContentEncoding::BROTLI) {
+        return false;
+    }
+#endif
+    return encoding != ContentEncoding::IDENTITY && encoding != ContentEncoding::COUNT;
+}
+
+} // namespace
+
+const HttpCompression::Settings& HttpCompression::settings() {
+    static const Settings settings = []() {
+        Settings result;
+        if (const char* value = std::getenv("EVM_HTTP_COMPRESSION_LEVEL")) {
+            result.level = std::clamp(std::atoi(value), 0, 9);
+        }
+        if (const char* value = std::getenv("EVM_HTTP_COMPRESSION_MIN_BYTES")) {
+            result.min_bytes = std::strtoull(value, nullptr, 10);
+        }
+        return result;
+    }();
+    return settings;
+}
+
+ContentEncoding HttpCompression::negotiate(std::string_view accept_encoding) {
+    if (settings().level == 0) {
+        return ContentEncoding::IDENTITY;
+    }
+
+    // 同分时按此顺序优先
+    static const ContentEncoding PREFERENCE[] = {ContentEncoding::BROTLI, ContentEncoding::GZIP,
+                                                 ContentEncoding::DEFLATE};
+    double quality[static_cast<int>(ContentEncoding::COUNT)] = {};
+    double wildcard = -1;
+
+    size_t pos = 0;
+    while (pos < accept_encoding.size()) {
+        size_t comma = accept_encoding.find(',', pos);
+        if (comma == std::string_view::npos) {
+            comma = accept_encoding.size();
+        }
+        std::string_view item = accept_encoding.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        double q = 1;
+        size_t semicolon = item.find(';');
+        if (semicolon != std::string_view::npos) {
+            std::string_view param = trim(item.substr(semicolon + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                q = std::atof(std::string(param.substr(2)).c_str());
+            }
+            item = item.substr(0, semicolon);
+        }
+        item = trim(item);
+
+        if (item == "*") {
+            wildcard = q;
+        }
+        for (ContentEncoding encoding : PREFERENCE) {
+            if (equalsIgnoreCase(item, name(encoding)) ||
+                (encoding == ContentEncoding::GZIP && equalsIgnoreCase(item, "x-gzip"))) {
+                quality[static_cast<int>(encoding)] = q > 0 ? q : -1;  // q=0 表示明确拒绝
+            }
+        }
+    }
+
+    ContentEncoding best = ContentEncoding::IDENTITY;
+    double best_q = 0;
+    for (ContentEncoding encoding : PREFERENCE) {
+        double q = quality[static_cast<int>(encoding)];
+        if (q == 0 && wildcard > 0) {
+            q = wildcard;  // 未列出的编码按 * 的 q 值
+        }
+        if (supported(encoding) && q > best_q) {
+            best = encoding;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
+const char* HttpCompression::name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::GZIP: return "gzip";
+        case ContentEncoding::DEFLATE: return "deflate";
+        case ContentEncoding::BROTLI: return "br";
+        default: return "identity";
+    }
+}
+
+bool HttpCompression::compressible(std::string_view content_type) {
+    return content_type.compare(0, 5, "text/") == 0 ||
+           content_type.compare(0, 16, "application/json") == 0 ||
+           content_type.compare(0, 22, "application/javascript") == 0;
+}
+
+bool HttpCompression::compress(ContentEncoding encoding, std::string_view input, std::string& output) {
+    StreamCompressor compressor(encoding, settings().level);
+    return compressor.write(input, output, true);
+}
+
+std::string HttpCompression::variantEtag(const std::string& etag, ContentEncoding encoding) {
+    if (encoding == ContentEncoding::IDENTITY || etag.size() < 2 || etag.back() != '"') {
+        return etag;
+    }
+    std::string result = etag.substr(0, etag.size() - 1);
+    result += '-';
+    result += name(encoding);
+    result += '"';
+    return result;
+}
+
+// zlib 处理 gzip 和 deflate（zlib 格式），brotli 使用其流式编码接口
+struct StreamCompressor::State {
+    ContentEncoding encoding;
+    bool ok = false;
+    z_stream zstream{};
+#ifdef EVM_HAVE_BROTLI
+    BrotliEncoderState* brotli = nullptr;
+#endif
+};
+
+StreamCompressor::StreamCompressor(ContentEncoding encoding, int level)
+    : state_(std::make_unique<State>()) {
+    state_->encoding = encoding;
+    level = std::clamp(level, 1, 9);
+    if (encoding == ContentEncoding::GZIP || encoding == ContentEncoding::DEFLATE) {
+        int window_bits = encoding == ContentEncoding::GZIP ? 15 + 16 : 15;
+        state_->ok = deflateInit2(&state_->zstream, level, Z_DEFLATED, window_bits, 8,
+                                  Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+#ifdef EVM_HAVE_BROTLI
+    else if (encoding == ContentEncoding::BROTLI) {
+        state_->brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (state_->brotli) {
+            BrotliEncoderSetParameter(state_->brotli, BROTLI_PARAM_QUALITY, level);
+            BrotliEncoderSetParameter(state_->brotli, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT);
+            state_->ok = true;
+        }
+    }
+#endif
+    if (!state_->ok) {
+        std::cerr << "[HTTP] Cannot initialize " << HttpCompression::name(encoding) << " compressor" << std::endl;
+    }
+}
+
+StreamCompressor::~StreamCompressor() {
+    if (state_->encoding == ContentEncoding::GZIP || state_->encoding == ContentEncoding::DEFLATE) {
+        if (state_->ok) {
+            deflateEnd(&state_->zstream);
+        }
+    }
+#ifdef EVM_HAVE_BROTLI
+    if (state_->brotli) {
+        BrotliEncoderDestroyInstance(state_->brotli);
+    }
+#endif
+}
+
+bool StreamCompressor::write(std::string_view input, std::string& output, bool finish) {
+    if (!state_->ok) {
+        return false;
+    }
+
+    if (state_->encoding == ContentEncoding::GZIP || state_->encoding == ContentEncoding::DEFLATE) {
+        z_stream& zs = state_->zstream;
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        zs.avail_in = static_cast<uInt>(input.size());
+        int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+        int ret;
+        do {
+            size_t offset = output.size();
+            size_t room = deflateBound(&zs, zs.avail_in) + 64;
+            output.resize(offset + room);
+            zs.next_out = reinterpret_cast<Bytef*>(&output[offset]);
+            zs.avail_out = static_cast<uInt>(room);
+            ret = deflate(&zs, flush);
+            output.resize(offset + room - zs.avail_out);
+            if (ret == Z_STREAM_ERROR) {
+                state_->ok = false;
+                return false;
+            }
+        } while (zs.avail_out == 0 || (finish && ret != Z_STREAM_END));
+        return true;
+    }
+
+#ifdef EVM_HAVE_BROTLI
+    if (state_->encoding == ContentEncoding::BROTLI) {
+        size_t available_in = input.size();
+        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input.data());
+        BrotliEncoderOperation op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+        do {
+            size_t available_out = 0;
+            if (!BrotliEncoderCompressStream(state_->brotli, op, &available_in, &next_in,
+                                             &available_out, nullptr, nullptr)) {
+                state_->ok = false;
+                return false;
+            }
+            size_t size = 0;
+            const uint8_t* data = BrotliEncoderTakeOutput(state_->brotli, &size);
+            output.append(reinterpret_cast<const char*>(data), size);
+        } while (available_in > 0 || BrotliEncoderHasMoreOutput(state_->brotli) ||
+                 (finish && !BrotliEncoderIsFinished(state_->brotli)));
+        return true;
+    }
+#endif
+    return false;
+}
+
+CompressedVariants::CompressedVariants(std::string identity)
+    : identity_(std::move(identity)) {
+}
+
+std::shared_ptr<const std::string> CompressedVariants::get(ContentEncoding encoding) const {
+    if (encoding == ContentEncoding::IDENTITY || identity_.size() < HttpCompression::settings().min_bytes) {
+        return nullptr;
+    }
+
+    int index = static_cast<int>(encoding);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!attempted_[index]) {
+        attempted_[index] = true;
+        auto compressed = std::make_shared<std::string>();
+        if (HttpCompression::compress(encoding, identity_, *compressed) && compressed->size() < identity_.size()) {
+            variants_[index] = std::move(compressed);
+        }
+    }
+    return variants_[index];
+}
+
+CompressingChunkWriter::CompressingChunkWriter(std::unique_ptr<ChunkWriter> inner, ContentEncoding encoding)
+    : inner_(std::move(inner))
+    , compressor_(encoding, HttpCompression::settings().level) {
+}
+
+bool CompressingChunkWriter::nextChunk(std::string& chunk) {
+    chunk.clear();
+    // 压缩输出为空的块会被当作 chunked 结束标记，继续读取直到有输出或内层结束
+    while (chunk.empty()) {
+        if (finished_ || failed_) {
+            return false;
+        }
+        bool more = inner_->nextChunk(input_);
+        if (!more) {
+            finished_ = true;
+            input_.clear();
+        }
+        if (!compressor_.write(input_, chunk, !more)) {
+            failed_ = true;
+            return false;
+        }
+    }
+    return true;
+}
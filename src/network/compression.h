@@ -0,0 +1,87 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "history_stream.h"
+
+// HTTP 响应压缩：按 Accept-Encoding 协商 gzip、deflate，
+// 构建时找到 libbrotlienc（定义了 EVM_HAVE_BROTLI）则同时支持 br
+enum class ContentEncoding { IDENTITY, GZIP, DEFLATE, BROTLI, COUNT };
+
+class HttpCompression {
+public:
+    // 环境变量 EVM_HTTP_COMPRESSION_LEVEL（1-9，默认 6，0 表示关闭压缩）
+    // 和 EVM_HTTP_COMPRESSION_MIN_BYTES（默认 1024，更小的响应不压缩），启动后首次使用时读取
+    struct Settings {
+        int level = 6;
+        size_t min_bytes = 1024;
+    };
+    static const Settings& settings();
+
+    // 选择客户端接受且 q 值最高的编码，同分时依次优先 br、gzip、deflate；关闭压缩时返回 IDENTITY
+    static ContentEncoding negotiate(std::string_view accept_encoding);
+    static const char* name(ContentEncoding encoding);
+
+    // 只压缩文本类响应，已压缩的二进制格式（如 EVMC 导出）不再压缩
+    static bool compressible(std::string_view content_type);
+
+    // 一次性压缩，输出追加到 output
+    static bool compress(ContentEncoding encoding, std::string_view input, std::string& output);
+
+    // 不同编码的表示使用不同的强校验 ETag："abc" -> "abc-gzip"
+    static std::string variantEtag(const std::string& etag, ContentEncoding encoding);
+};
+
+// 流式压缩器，每次调用后刷出已输入的数据，客户端可以逐块解码
+class StreamCompressor {
+public:
+    StreamCompressor(ContentEncoding encoding, int level);
+    ~StreamCompressor();
+
+    // 禁止拷贝
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    // 压缩 input 并把输出追加到 output；finish 为 true 时结束压缩流
+    bool write(std::string_view input, std::string& output, bool finish);
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+// 一份内容及其各编码版本，某个编码第一次被请求时压缩并缓存
+class CompressedVariants {
+public:
+    explicit CompressedVariants(std::string identity);
+
+    const std::string& identity() const { return identity_; }
+
+    // 返回指定编码的内容；内容小于阈值、压缩失败或压缩后没有变小时返回 nullptr，调用方使用原始内容
+    std::shared_ptr<const std::string> get(ContentEncoding encoding) const;
+
+private:
+    std::string identity_;
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const std::string> variants_[static_cast<int>(ContentEncoding::COUNT)];
+    mutable bool attempted_[static_cast<int>(ContentEncoding::COUNT)] = {};
+};
+
+// 包装流式响应，逐块压缩后输出
+class CompressingChunkWriter : public ChunkWriter {
+public:
+    CompressingChunkWriter(std::unique_ptr<ChunkWriter> inner, ContentEncoding encoding);
+
+    bool nextChunk(std::string& chunk) override;
+    const char* contentType() const override { return inner_->contentType(); }
+    size_t rowCount() const override { return inner_->rowCount(); }
+    bool failed() const override { return failed_ || inner_->failed(); }
+
+private:
+    std::unique_ptr<ChunkWriter> inner_;
+    StreamCompressor compressor_;
+    std::string input_;
+    bool finished_ = false;
+    bool failed_ = false;
+};
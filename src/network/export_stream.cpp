@@ -0,0 +1,221 @@
+#include "export_stream.h"
+#include <zlib.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+void appendNumber(std::string& out, double value) {
+    if (!std::isfinite(value)) {
+        return;  // CSV 中留空
+    }
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void appendNumber(std::string& out, long long value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+// 含分隔符、引号或换行的字段加引号，内部引号重复一次
+void appendCsvField(std::string& out, const std::string& value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        out += value;
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+template <typename T>
+void putLE(std::string& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out += static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff);
+    }
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+uint64_t toBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+const char* CSV_HEADER =
+    "device_id,timestamp,temperature,humidity,co2,pm25,noise,light,area,area_type,samples_count\n";
+
+} // namespace
+
+CsvChunkWriter::CsvChunkWriter(std::unique_ptr<RowCursor> cursor)
+    : cursor_(std::move(cursor)) {
+}
+
+bool CsvChunkWriter::nextChunk(std::string& chunk) {
+    chunk.clear();
+    if (finished_) {
+        return false;
+    }
+    if (!started_) {
+        chunk = CSV_HEADER;
+        started_ = true;
+    }
+    
+    SensorData row;
+    while (chunk.size() < CHUNK_SIZE) {
+        if (!cursor_->next(row)) {
+            failed_ = cursor_->failed();
+            if (failed_) {
+                std::cerr << "[Export] Cursor failed after " << row_count_ << " rows" << std::endl;
+            }
+            finished_ = true;
+            cursor_.reset();  // 尽早归还数据库连接
+            break;
+        }
+        appendCsvField(chunk, row.device_id);
+        chunk += ',';
+        appendNumber(chunk, static_cast<long long>(row.timestamp));
+        for (double value : {row.temperature, row.humidity, row.co2, row.pm25, row.noise, row.light}) {
+            chunk += ',';
+            appendNumber(chunk, value);
+        }
+        chunk += ',';
+        appendCsvField(chunk, row.area);
+        chunk += ',';
+        appendNumber(chunk, static_cast<long long>(row.area_type));
+        chunk += ',';
+        appendNumber(chunk, static_cast<long long>(row.samples_count));
+        chunk += '\n';
+        ++row_count_;
+    }
+    return !chunk.empty();
+}
+
+void ColumnChunkWriter::DictionaryColumn::append(const std::string& value) {
+    auto it = index.find(value);
+    if (it == index.end()) {
+        it = index.emplace(value, static_cast<uint32_t>(entries.size())).first;
+        entries.push_back(&it->first);
+    }
+    putVarint(indices, it->second);
+}
+
+std::string ColumnChunkWriter::DictionaryColumn::encode() const {
+    std::string out;
+    putVarint(out, entries.size());
+    for (const std::string* entry : entries) {
+        putVarint(out, entry->size());
+        out += *entry;
+    }
+    out += indices;
+    return out;
+}
+
+void ColumnChunkWriter::DictionaryColumn::clear() {
+    index.clear();
+    entries.clear();
+    indices.clear();
+}
+
+ColumnChunkWriter::ColumnChunkWriter(std::unique_ptr<RowCursor> cursor)
+    : cursor_(std::move(cursor)) {
+}
+
+bool ColumnChunkWriter::nextChunk(std::string& chunk) {
+    chunk.clear();
+    if (finished_) {
+        return false;
+    }
+    if (!started_) {
+        chunk = "EVMC";
+        chunk += static_cast<char>(FORMAT_VERSION);
+        started_ = true;
+    }
+    
+    DictionaryColumn devices;
+    DictionaryColumn areas;
+    std::string timestamps;
+    std::string channels[6];
+    std::string area_types;
+    std::string samples;
+    int64_t prev_timestamp = 0;
+    uint64_t prev_bits[6] = {};
+    
+    uint32_t rows = 0;
+    SensorData row;
+    while (rows < ROWS_PER_CHUNK) {
+        if (!cursor_->next(row)) {
+            failed_ = cursor_->failed();
+            if (failed_) {
+                std::cerr << "[Export] Cursor failed after " << row_count_ << " rows" << std::endl;
+            }
+            finished_ = true;
+            cursor_.reset();
+            break;
+        }
+        devices.append(row.device_id);
+        areas.append(row.area);
+        int64_t delta = static_cast<int64_t>(row.timestamp) - prev_timestamp;
+        putVarint(timestamps, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+        prev_timestamp = row.timestamp;
+        double values[6] = {row.temperature, row.humidity, row.co2, row.pm25, row.noise, row.light};
+        for (int i = 0; i < 6; ++i) {
+            uint64_t bits = toBits(values[i]);
+            putLE<uint64_t>(channels[i], bits ^ prev_bits[i]);
+            prev_bits[i] = bits;
+        }
+        area_types += static_cast<char>(static_cast<uint8_t>(row.area_type));
+        putVarint(samples, static_cast<uint64_t>(std::max(0, row.samples_count)));
+        ++rows;
+    }
+    
+    if (rows > 0) {
+        putLE<uint32_t>(chunk, rows);
+        chunk += static_cast<char>(COLUMN_COUNT);
+        appendColumn(chunk, DEVICE_ID, DICTIONARY, devices.encode());
+        appendColumn(chunk, TIMESTAMP, DELTA_VARINT, timestamps);
+        for (int i = 0; i < 6; ++i) {
+            appendColumn(chunk, static_cast<Column>(TEMPERATURE + i), XOR_DOUBLE, channels[i]);
+        }
+        appendColumn(chunk, AREA, DICTIONARY, areas.encode());
+        appendColumn(chunk, AREA_TYPE, UINT8, area_types);
+        appendColumn(chunk, SAMPLES_COUNT, VARINT, samples);
+        row_count_ += rows;
+    }
+    if (finished_) {
+        putLE<uint32_t>(chunk, 0);
+    }
+    return true;
+}
+
+void ColumnChunkWriter::appendColumn(std::string& out, Column column, Encoding encoding,
+                                     const std::string& raw) {
+    uLongf compressed_size = compressBound(raw.size());
+    std::string compressed(compressed_size, '\0');
+    compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+              reinterpret_cast<const Bytef*>(raw.data()), raw.size(), Z_DEFAULT_COMPRESSION);
+    
+    out += static_cast<char>(column);
+    out += static_cast<char>(encoding);
+    putLE<uint32_t>(out, static_cast<uint32_t>(compressed_size));
+    putLE<uint32_t>(out, static_cast<uint32_t>(raw.size()));
+    out.append(compressed.data(), compressed_size);
+}
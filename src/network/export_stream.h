@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "history_stream.h"
+
+// 批量导出的 CSV 格式，逐行输出，内存占用与导出范围无关
+class CsvChunkWriter : public ChunkWriter {
+public:
+    explicit CsvChunkWriter(std::unique_ptr<RowCursor> cursor);
+
+    bool nextChunk(std::string& chunk) override;
+    const char* contentType() const override { return "text/csv"; }
+    size_t rowCount() const override { return row_count_; }
+    bool failed() const override { return failed_; }
+
+private:
+    std::unique_ptr<RowCursor> cursor_;
+    size_t row_count_ = 0;
+    bool failed_ = false;
+    bool started_ = false;
+    bool finished_ = false;
+
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+};
+
+// 批量导出的列式格式（EVMC）。每 ROWS_PER_CHUNK 行组成一个列块，各列分别编码后 zlib 压缩，
+// 内存中只保留当前列块。所有整数为小端序：
+//   文件头：    "EVMC" u8 版本
+//   列块：      u32 行数 u8 列数，随后每列 [u8 列号][u8 编码][u32 压缩长度][u32 原始长度][zlib 数据]
+//   文件尾：    u32 0（行数为 0 的列块）
+// 列号与编码：
+//   0 device_id、8 area     字典：varint 字典大小、每项 varint 长度+字节，随后每行 varint 字典下标
+//   1 timestamp             与上一行之差的 zigzag varint（列块第一行与 0 相比）
+//   2-7 六个通道            IEEE 754 位与上一行异或后的 8 字节
+//   9 area_type             每行 u8
+//   10 samples_count        每行 varint，原始数据为 0
+class ColumnChunkWriter : public ChunkWriter {
+public:
+    static constexpr uint8_t FORMAT_VERSION = 1;
+    static constexpr size_t ROWS_PER_CHUNK = 16384;
+
+    enum Column : uint8_t {
+        DEVICE_ID, TIMESTAMP, TEMPERATURE, HUMIDITY, CO2, PM25, NOISE, LIGHT,
+        AREA, AREA_TYPE, SAMPLES_COUNT, COLUMN_COUNT
+    };
+    enum Encoding : uint8_t { DICTIONARY, DELTA_VARINT, XOR_DOUBLE, UINT8, VARINT };
+
+    explicit ColumnChunkWriter(std::unique_ptr<RowCursor> cursor);
+
+    bool nextChunk(std::string& chunk) override;
+    const char* contentType() const override { return "application/octet-stream"; }
+    size_t rowCount() const override { return row_count_; }
+    bool failed() const override { return failed_; }
+
+private:
+    // 字典编码的列，字典在每个列块内独立
+    struct DictionaryColumn {
+        std::unordered_map<std::string, uint32_t> index;
+        std::vector<const std::string*> entries;
+        std::string indices;
+
+        void append(const std::string& value);
+        std::string encode() const;
+        void clear();
+    };
+
+    void appendColumn(std::string& out, Column column, Encoding encoding, const std::string& raw);
+
+    std::unique_ptr<RowCursor> cursor_;
+    size_t row_count_ = 0;
+    bool failed_ = false;
+    bool started_ = false;
+    bool finished_ = false;
+};
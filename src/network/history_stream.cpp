@@ -0,0 +1,76 @@
+#include "history_stream.h"
+#include "../utils/json_writer.h"
+
+HistoryChunkWriter::HistoryChunkWriter(std::unique_ptr<RowCursor> cursor, bool include_device)
+    : cursor_(std::move(cursor))
+    , include_device_(include_device) {
+}
+
+bool HistoryChunkWriter::nextChunk(std::string& chunk) {
+    chunk.clear();
+    if (finished_) {
+        return false;
+    }
+    
+    if (!started_) {
+        chunk = "{\"data\":[";
+        started_ = true;
+    }
+    
+    SensorData row;
+    while (chunk.size() < CHUNK_SIZE) {
+        if (!cursor_->next(row)) {
+            chunk += "]}\n";
+            finished_ = true;
+            failed_ = cursor_->failed();
+            cursor_.reset();  // 尽早归还数据库连接
+            break;
+        }
+        if (row_count_ > 0) {
+            chunk += ',';
+        }
+        appendRow(chunk, row);
+        ++row_count_;
+    }
+    return true;
+}
+
+void HistoryChunkWriter::appendRow(std::string& out, const SensorData& row) {
+    out += "{\"timestamp\":";
+    JsonWriter::appendNumber(out, static_cast<long long>(row.timestamp));
+    if (include_device_) {
+        out += ",\"device_id\":";
+        JsonWriter::appendString(out, row.device_id);
+    }
+    out += ",\"temperature\":";
+    JsonWriter::appendNumber(out, row.temperature);
+    out += ",\"humidity\":";
+    JsonWriter::appendNumber(out, row.humidity);
+    out += ",\"co2\":";
+    JsonWriter::appendNumber(out, row.co2);
+    out += ",\"pm25\":";
+    JsonWriter::appendNumber(out, row.pm25);
+    out += ",\"noise\":";
+    JsonWriter::appendNumber(out, row.noise);
+    out += ",\"light\":";
+    JsonWriter::appendNumber(out, row.light);
+    out += '}';
+}
+
+PrefetchedChunkWriter::PrefetchedChunkWriter(std::unique_ptr<ChunkWriter> inner)
+    : inner_(std::move(inner)) {
+    has_first_ = inner_->nextChunk(first_);
+    // 出错的游标也会输出结尾的 "]}"，此时视为开始即失败
+    if (has_first_ && inner_->failed() && inner_->rowCount() == 0) {
+        has_first_ = false;
+    }
+}
+
+bool PrefetchedChunkWriter::nextChunk(std::string& chunk) {
+    if (has_first_) {
+        chunk.swap(first_);
+        has_first_ = false;
+        return true;
+    }
+    return inner_->nextChunk(chunk);
+}
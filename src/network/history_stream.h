@@ -0,0 +1,63 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "../database/row_cursor.h"
+
+// 把游标增量序列化为响应体的分块，由 HTTP 层以 chunked 编码逐块写出
+class ChunkWriter {
+public:
+    virtual ~ChunkWriter() = default;
+
+    // 生成下一个分块，全部输出完毕后返回 false
+    virtual bool nextChunk(std::string& chunk) = 0;
+    virtual const char* contentType() const = 0;
+    virtual size_t rowCount() const = 0;
+
+    // 游标中途出错时为 true，此时已输出的内容不完整
+    virtual bool failed() const { return false; }
+};
+
+// 把历史数据游标增量序列化为 {"data":[...]} JSON，每次产出一个分块
+class HistoryChunkWriter : public ChunkWriter {
+public:
+    // include_device 为 true 时每行附带 device_id，用于多设备查询
+    explicit HistoryChunkWriter(std::unique_ptr<RowCursor> cursor, bool include_device = false);
+
+    // 生成下一个分块（约 CHUNK_SIZE 字节），全部输出完毕后返回 false
+    bool nextChunk(std::string& chunk) override;
+    const char* contentType() const override { return "application/json"; }
+    size_t rowCount() const override { return row_count_; }
+    bool failed() const override { return failed_; }
+
+private:
+    void appendRow(std::string& out, const SensorData& row);
+
+    std::unique_ptr<RowCursor> cursor_;
+    bool include_device_;
+    size_t row_count_ = 0;
+    bool started_ = false;
+    bool finished_ = false;
+    bool failed_ = false;
+
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+};
+
+// 在写出响应头之前先生成第一个分块：取不到数据库连接或查询一开始就失败时，
+// 处理函数还能返回错误状态码，而不是先写出 200 再中断连接
+class PrefetchedChunkWriter : public ChunkWriter {
+public:
+    explicit PrefetchedChunkWriter(std::unique_ptr<ChunkWriter> inner);
+
+    // 第一个分块之前已经出错
+    bool failedAtStart() const { return !has_first_ && inner_->failed(); }
+
+    bool nextChunk(std::string& chunk) override;
+    const char* contentType() const override { return inner_->contentType(); }
+    size_t rowCount() const override { return inner_->rowCount(); }
+    bool failed() const override { return inner_->failed(); }
+
+private:
+    std::unique_ptr<ChunkWriter> inner_;
+    std::string first_;
+    bool has_first_ = false;
+};
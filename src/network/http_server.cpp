@@ -1,13 +1,177 @@
 #include "http_server.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <boost/beast/version.hpp>
-#include <jsoncpp/json/json.h>
 #include <fstream>
+#include <thread>
+#include "../database/area_aggregate_cursor.h"
+#include "../database/downsampling_cursor.h"
+#include "../services/area_aggregator.h"
+#include "../utils/json_writer.h"
+#include "export_stream.h"
+#include "http_session.h"
+
+namespace {
+
+// 解码 URL 路径中的 %XX（区域名称可能是中文）
+std::string urlDecode(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '%' && i + 2 < value.size()) {
+            result += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else if (value[i] == '+') {
+            result += ' ';
+        } else {
+            result += value[i];
+        }
+    }
+    return result;
+}
+
+// If-None-Match 可以是 "*" 或逗号分隔的多个 ETag，弱比较时忽略 W/ 前缀
+bool etagMatches(boost::beast::string_view header, const std::string& etag) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t comma = header.find(',', pos);
+        if (comma == boost::beast::string_view::npos) {
+            comma = header.size();
+        }
+        auto candidate = header.substr(pos, comma - pos);
+        while (!candidate.empty() && candidate.front() == ' ') {
+            candidate.remove_prefix(1);
+        }
+        while (!candidate.empty() && candidate.back() == ' ') {
+            candidate.remove_suffix(1);
+        }
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// 按 Accept-Encoding 选择缓存内容的版本，设置 Vary 和 Content-Encoding，返回应写出的内容
+const std::string& selectVariant(const CompressedVariants& content,
+                                 const http::request<http::string_body>& req,
+                                 http::response<http::string_body>& res,
+                                 ContentEncoding* selected = nullptr) {
+    res.set(http::field::vary, "Accept-Encoding");
+    auto accept = req[http::field::accept_encoding];
+    ContentEncoding encoding = HttpCompression::negotiate(std::string_view(accept.data(), accept.size()));
+    auto variant = content.get(encoding);
+    if (selected) {
+        *selected = variant ? encoding : ContentEncoding::IDENTITY;
+    }
+    if (!variant) {
+        return content.identity();
+    }
+    // 压缩版本由 CompressedVariants 一直持有，返回引用在 content 存活期间有效
+    res.set(http::field::content_encoding, HttpCompression::name(encoding));
+    return *variant;
+}
+
+void setUnavailable(http::response<http::string_body>& res, const char* message) {
+    res.result(http::status::service_unavailable);
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::retry_after, "5");
+    res.body().clear();
+    JsonWriter(res.body()).beginObject().member("error", message).endObject();
+    res.body() += '\n';
+}
+
+// 流式响应在写出响应头之前先取第一个分块；连接池等待超时或查询一开始就失败时
+// 改为返回 503。stream 为空（处理函数已填写错误响应）时返回 false
+bool prepareStream(std::unique_ptr<ChunkWriter>& stream, http::response<http::string_body>& res) {
+    if (!stream) {
+        return false;
+    }
+    auto prefetched = std::make_unique<PrefetchedChunkWriter>(std::move(stream));
+    if (prefetched->failedAtStart()) {
+        setUnavailable(res, "Database unavailable");
+        return false;
+    }
+    stream = std::move(prefetched);
+    return true;
+}
+
+// 解析历史查询的公共参数
+void parseHistoryParams(const std::string& path, HistoryQuery& query) {
+    query.end_time = time(nullptr);
+    if (path.find('?') == std::string::npos) {
+        return;
+    }
+    
+    std::string params = path.substr(path.find('?') + 1);
+    std::istringstream iss(params);
+    std::string param;
+    while (std::getline(iss, param, '&')) {
+        if (param.substr(0, 6) == "start=") {
+            query.start_time = std::stoll(param.substr(6));
+            query.has_start = true;
+        } else if (param.substr(0, 4) == "end=") {
+            query.end_time = std::stoll(param.substr(4));
+        } else if (param.substr(0, 5) == "type=") {
+            query.type = param.substr(5);
+        } else if (param.substr(0, 11) == "max_points=") {
+            query.max_points = std::stoul(param.substr(11));
+        } else if (param.substr(0, 5) == "mode=") {
+            query.mode = param.substr(5);
+        } else if (param.substr(0, 6) == "field=") {
+            query.field = param.substr(6);
+        } else if (param.substr(0, 10) == "aggregate=") {
+            query.aggregate = param.substr(10);
+        } else if (param.substr(0, 7) == "bucket=") {
+            query.bucket_seconds = std::stoll(param.substr(7));
+        } else if (param.substr(0, 7) == "format=") {
+            query.format = param.substr(7);
+        } else if (param.substr(0, 2) == "q=") {
+            query.quantiles.clear();
+            std::istringstream quantiles(urlDecode(param.substr(2)));
+            std::string q;
+            while (std::getline(quantiles, q, ',')) {
+                if (!q.empty()) {
+                    query.quantiles.push_back(std::stod(q));
+                }
+            }
+        } else if (param.substr(0, 4) == "ids=") {
+            std::istringstream ids(urlDecode(param.substr(4)));
+            std::string id;
+            while (std::getline(ids, id, ',')) {
+                if (!id.empty()) {
+                    query.device_ids.push_back(id);
+                }
+            }
+        }
+    }
+}
+
+bool parseTier(const std::string& type, DataTier& tier) {
+    if (type == "realtime") {
+        tier = DataTier::REALTIME;
+    } else if (type == "hourly") {
+        tier = DataTier::HOURLY;
+    } else if (type == "daily") {
+        tier = DataTier::DAILY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
 
 HTTPServer::HTTPServer(int port)
     : ioc_()
-    , acceptor_(ioc_, {net::ip::make_address("0.0.0.0"), static_cast<unsigned short>(port)})
-    , buffer_()
+    , acceptor_(net::make_strand(ioc_), {net::ip::make_address("0.0.0.0"), static_cast<unsigned short>(port)})
     , port_(port)
 {
 }
@@ -25,21 +189,19 @@ void HTTPServer::stop() {
     ioc_.stop();
 }
 
+size_t HTTPServer::threadsFromEnv() {
+    const char* value = std::getenv("EVM_HTTP_THREADS");
+    size_t threads = value ? std::strtoull(value, nullptr, 10) : std::thread::hardware_concurrency();
+    return std::max<size_t>(threads, 1);
+}
+
 void HTTPServer::do_accept() {
+    // 每个连接使用独立的 strand，同一会话的读写和超时回调不会并发执行
     acceptor_.async_accept(
+        net::make_strand(ioc_),
         [this](beast::error_code ec, tcp::socket socket) {
             if (!ec) {
-                auto socket_ptr = std::make_shared<tcp::socket>(std::move(socket));
-                auto req = std::make_shared<http::request<http::string_body>>();
-                
-                http::async_read(*socket_ptr, buffer_, *req,
-                    [this, req, socket_ptr](beast::error_code ec, std::size_t) {
-                        if (!ec) {
-                            handle_request(std::move(*req), *socket_ptr);
-                        } else {
-                            std::cerr << "[HTTP] Read error: " << ec.message() << std::endl;
-                        }
-                    });
+                std::make_shared<HttpSession>(*this, std::move(socket))->start();
             } else {
                 std::cerr << "[HTTP] Accept error: " << ec.message() << std::endl;
             }
@@ -48,585 +210,615 @@ void HTTPServer::do_accept() {
         });
 }
 
-void HTTPServer::handle_request(http::request<http::string_body>&& req, tcp::socket& socket) {
-    auto response = std::make_shared<http::response<http::string_body>>();
-    response->version(req.version());
-    response->set(http::field::server, "EVM Monitor");
-    response->set(http::field::access_control_allow_origin, "*");
-    response->set(http::field::access_control_allow_methods, "GET, POST, OPTIONS");
-    response->set(http::field::access_control_allow_headers, "Content-Type, Accept");
-    response->set(http::field::access_control_max_age, "3600");
-    response->set(http::field::connection, "keep-alive");  // 保持连接
+bool HTTPServer::parseStreamRequest(const http::request<http::string_body>& req, PushHub::Filter& filter) {
+    std::string target(req.target());
+    std::string path = target.substr(0, target.find('?'));
+    if (req.method() != http::verb::get || path != "/api/stream") {
+        return false;
+    }
+    if (path.size() == target.size()) {
+        return true;
+    }
+    
+    std::istringstream iss(target.substr(path.size() + 1));
+    std::string param;
+    while (std::getline(iss, param, '&')) {
+        if (param.substr(0, 8) == "devices=") {
+            std::istringstream ids(urlDecode(param.substr(8)));
+            std::string id;
+            while (std::getline(ids, id, ',')) {
+                if (!id.empty()) {
+                    filter.device_ids.insert(id);
+                }
+            }
+        } else if (param.substr(0, 5) == "area=") {
+            filter.area = urlDecode(param.substr(5));
+        }
+    }
+    return true;
+}
+
+void HTTPServer::handle_request(const http::request<http::string_body>& req, bool keep_alive,
+                                http::response<http::string_body>& response,
+                                std::unique_ptr<ChunkWriter>& stream) {
+    response.version(req.version());
+    response.set(http::field::server, "EVM Monitor");
+    response.set(http::field::access_control_allow_origin, "*");
+    response.set(http::field::access_control_allow_methods, "GET, POST, OPTIONS");
+    response.set(http::field::access_control_allow_headers, "Content-Type, Accept");
+    response.set(http::field::access_control_max_age, "3600");
+    response.keep_alive(keep_alive);
     
     // 处理预检请求
     if (req.method() == http::verb::options) {
-        response->result(http::status::no_content);
-        response->prepare_payload();
-        beast::error_code ec;
-        http::write(socket, *response, ec);
+        response.result(http::status::no_content);
+        response.prepare_payload();
         return;
     }
     
     try {
         if (req.target() == "/") {
-            static std::string cached_index;  // 缓存index.html
-            if (cached_index.empty()) {
-                std::string filepath = "../web/index.html";
-                std::ifstream file(filepath);
-                if (file) {
-                    cached_index = std::string(
-                        std::istreambuf_iterator<char>(file),
-                        std::istreambuf_iterator<char>()
-                    );
-                }
-            }
-            
-            if (!cached_index.empty()) {
-                response->set(http::field::content_type, "text/html");
-                response->body() = cached_index;
+            // 缓存 index.html，静态局部变量的初始化在多个工作线程间是线程安全的
+            // 压缩版本在第一次被请求时生成并缓存
+            static const CompressedVariants cached_index([]() {
+                std::ifstream file("../web/index.html");
+                return std::string(std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>());
+            }());
+            
+            if (!cached_index.identity().empty()) {
+                response.set(http::field::content_type, "text/html");
+                response.body() = selectVariant(cached_index, req, response);
             } else {
-                response->result(http::status::not_found);
-                response->body() = "404 Not Found\n";
+                response.result(http::status::not_found);
+                response.body() = "404 Not Found\n";
             }
         }
         else if (req.target() == "/api/devices" && req.method() == http::verb::get) {
-            response->set(http::field::content_type, "application/json");
-            handleGetDevices(*response);
+            response.set(http::field::content_type, "application/json");
+            handleGetDevices(response);
+        }
+        else if (req.target() == "/api/metrics" && req.method() == http::verb::get) {
+            handleGetMetrics(response);
         }
         else if (req.target() == "/api/data/realtime" && req.method() == http::verb::get) {
-            response->set(http::field::content_type, "application/json");
-            handleGetRealtimeData(req, *response);
+            response.set(http::field::content_type, "application/json");
+            handleGetRealtimeData(req, response);
         }
         else if (req.target() == "/api/score/realtime" && req.method() == http::verb::get) {
-            handleGetRealtimeScore(req, *response);
+            handleGetRealtimeScore(response);
+        }
+        else if ((req.target().starts_with("/api/device/") || req.target().starts_with("/api/area/")) &&
+                 req.target().find("/percentiles") != std::string::npos) {
+            // 单个设备或整个区域的分位数，由聚合表中的草图合并得到
+            std::string path = std::string(req.target());
+            std::string prefix = path.compare(0, 12, "/api/device/") == 0 ? "/api/device/" : "/api/area/";
+            std::string label = urlDecode(path.substr(prefix.size(), path.find("/percentiles") - prefix.size()));
+            HistoryQuery query;
+            parseHistoryParams(path, query);
+            if (prefix == "/api/device/") {
+                query.device_ids.push_back(label);
+            } else {
+                for (const auto& device : DeviceManager::getInstance().getDevicesByLocation(label)) {
+                    query.device_ids.push_back(device->device_id);
+                }
+            }
+            handleGetPercentiles(query, label, response);
+        }
+        else if ((req.target().starts_with("/api/area/") && req.target().find("/export") != std::string::npos) ||
+                 req.target().starts_with("/api/export?")) {
+            // 批量导出：按区域或按 ids 列表，流式输出 CSV 或列式文件
+            std::string path = std::string(req.target());
+            HistoryQuery query;
+            parseHistoryParams(path, query);
+            
+            std::string label = "devices";
+            if (path.compare(0, 10, "/api/area/") == 0) {
+                label = urlDecode(path.substr(10, path.find("/export") - 10));
+                for (const auto& device : DeviceManager::getInstance().getDevicesByLocation(label)) {
+                    query.device_ids.push_back(device->device_id);
+                }
+            }
+            
+            DataTier tier;
+            if (!parseTier(query.type, tier) || (query.format != "csv" && query.format != "evmc")) {
+                response.result(http::status::bad_request);
+                response.set(http::field::content_type, "application/json");
+                response.body() = "{\"error\":\"Invalid type or format\"}";
+            } else {
+                handleExport(query, label, response, stream);
+                if (prepareStream(stream, response)) {
+                    return;
+                }
+            }
+        }
+        else if (req.target().starts_with("/api/percentiles?")) {
+            HistoryQuery query;
+            parseHistoryParams(std::string(req.target()), query);
+            handleGetPercentiles(query, "devices", response);
         }
         else if (req.target().starts_with("/api/device/") && req.target().find("/history") == std::string::npos) {
             // 处理单个设备的实时数据请求
             std::string device_id = std::string(req.target()).substr(12);  // 移除 "/api/device/"
-            handleGetDeviceData(device_id, *response);
+            handleGetDeviceData(device_id, response);
         }
         else if (req.target().starts_with("/api/device/") && req.target().find("/history") != std::string::npos) {
             // 处理历史数据请求
             std::string path = std::string(req.target());
             size_t historyPos = path.find("/history");
-            std::string device_id = path.substr(12, historyPos - 12);  // 提取设备ID
-            
-            // 解析数据类型参数
-            std::string dataType = "realtime";  // 默认类型
-            time_t start_time = 0, end_time = time(nullptr);
-            
-            if (path.find('?') != std::string::npos) {
-                std::string query = path.substr(path.find('?') + 1);
-                std::istringstream iss(query);
-                std::string param;
-                while (std::getline(iss, param, '&')) {
-                    if (param.substr(0, 6) == "start=") {
-                        start_time = std::stoll(param.substr(6));
-                    } else if (param.substr(0, 4) == "end=") {
-                        end_time = std::stoll(param.substr(4));
-                    } else if (param.substr(0, 5) == "type=") {
-                        dataType = param.substr(5);
-                    }
+            HistoryQuery query;
+            query.device_id = path.substr(12, historyPos - 12);  // 提取设备ID
+            parseHistoryParams(path, query);
+            
+            DownsamplingCursor::Mode mode;
+            double SensorData::*field;
+            if (!DownsamplingCursor::parseMode(query.mode, mode) ||
+                !DownsamplingCursor::parseField(query.field, field)) {
+                response.result(http::status::bad_request);
+                response.set(http::field::content_type, "application/json");
+                response.body() = "{\"error\":\"Invalid mode or field\"}";
+            } else if (query.max_points > 0 && !query.has_start) {
+                // 桶宽由时间范围均分得到，起点缺省为 0 时所有数据会落进最后一个桶
+                response.result(http::status::bad_request);
+                response.set(http::field::content_type, "application/json");
+                response.body() = "{\"error\":\"max_points requires start\"}";
+            } else if (query.max_points > 0 && query.max_points < DownsamplingCursor::MIN_POINTS) {
+                response.result(http::status::bad_request);
+                response.set(http::field::content_type, "application/json");
+                response.body() = "{\"error\":\"max_points must be at least 3\"}";
+            } else {
+                // 历史数据边查询边由会话以 chunked 编码写出，不经过 response 缓冲
+                handleGetDeviceHistory(query, stream);
+                if (prepareStream(stream, response)) {
+                    return;
+                }
+            }
+        }
+        else if (req.target() == "/api/areas/summary" && req.method() == http::verb::get) {
+            handleGetAreasSummary(response);
+        }
+        else if (req.target().starts_with("/api/area/") && req.target().find("/summary") != std::string::npos) {
+            // 单个区域的当前汇总和分钟级汇总，minutes 默认 60
+            std::string path = std::string(req.target());
+            std::string area = urlDecode(path.substr(10, path.find("/summary") - 10));
+            size_t minutes = 60;
+            size_t minutesPos = path.find("minutes=");
+            if (minutesPos != std::string::npos) {
+                minutes = std::stoul(path.substr(minutesPos + 8));
+            }
+            handleGetAreaSummary(area, minutes, response);
+        }
+        else if ((req.target().starts_with("/api/area/") && req.target().find("/history") != std::string::npos) ||
+                 req.target().starts_with("/api/history?")) {
+            // 多设备历史数据：按区域或按 ids 列表，一次查询返回
+            std::string path = std::string(req.target());
+            HistoryQuery query;
+            parseHistoryParams(path, query);
+            
+            std::string label = "devices";
+            if (path.compare(0, 10, "/api/area/") == 0) {
+                label = urlDecode(path.substr(10, path.find("/history") - 10));  // 提取区域名称
+                for (const auto& device : DeviceManager::getInstance().getDevicesByLocation(label)) {
+                    query.device_ids.push_back(device->device_id);
                 }
             }
             
-            handleGetDeviceHistory(device_id, dataType, start_time, end_time, *response);
+            DataTier tier;
+            AreaAggregateCursor::Mode mode;
+            if (!parseTier(query.type, tier) ||
+                (!query.aggregate.empty() && !AreaAggregateCursor::parseMode(query.aggregate, mode))) {
+                response.result(http::status::bad_request);
+                response.set(http::field::content_type, "application/json");
+                response.body() = "{\"error\":\"Invalid type or aggregate\"}";
+            } else {
+                handleGetMultiHistory(query, label, stream);
+                if (prepareStream(stream, response)) {
+                    return;
+                }
+            }
         }
         else {
-            response->result(http::status::not_found);
-            response->body() = "404 Not Found\n";
+            response.result(http::status::not_found);
+            response.body() = "404 Not Found\n";
         }
     }
     catch (const std::exception& e) {
-        response->result(http::status::internal_server_error);
-        Json::Value error;
-        error["error"] = e.what();
-        Json::FastWriter writer;
-        response->body() = writer.write(error);
-    }
-    
-    response->prepare_payload();
-    
-    // 使用异步写入
-    auto socket_ptr = std::make_shared<tcp::socket>(std::move(socket));
-    http::async_write(
-        *socket_ptr,
-        *response,
-        [response, socket_ptr](beast::error_code ec, std::size_t) {
-            if (ec) {
-                std::cerr << "[HTTP] Write error: " << ec.message() << std::endl;
-            }
-        });
+        response.result(http::status::internal_server_error);
+        response.body().clear();
+        JsonWriter(response.body()).beginObject().member("error", e.what()).endObject();
+        response.body() += '\n';
+    }
+    
+    response.prepare_payload();
+    if (response.result() == http::status::not_modified) {
+        // 304 不带响应体，也不应声明长度为 0
+        response.erase(http::field::content_length);
+    }
 }
 
 void HTTPServer::handleGetRealtimeData(const http::request<http::string_body>& req, http::response<http::string_body>& res) {
-    Json::Value root;
-    root["data"] = Json::Value(Json::arrayValue);
+    auto snapshot = realtimeSnapshot();
+    ContentEncoding encoding = ContentEncoding::IDENTITY;
+    const std::string& body = selectVariant(snapshot->content, req, res, &encoding);
+    std::string etag = HttpCompression::variantEtag(snapshot->etag, encoding);
     
-    auto& devices = DeviceManager::getInstance().getDevices();
-    std::cout << "[HTTP] GetRealtimeData: found " << devices.size() << " devices" << std::endl;
-    
-    for (const auto& device : devices) {
-        std::cout << "[HTTP] Processing device " << device.first << std::endl;
-        
-        if (!device.second->recent_data.empty()) {
-            const auto& latest_data = device.second->recent_data.back();
-            
-            Json::Value deviceData;
-            deviceData["device_id"] = device.first;
-            deviceData["area"] = latest_data.area;
-            deviceData["area_type"] = static_cast<int>(latest_data.area_type);
-            // 根据最后心跳时间判断设备状态
-            time_t now = time(nullptr);
-            bool isOnline = (now - device.second->last_heartbeat) <= 30;  // 30秒内有心跳就认为在线
-            deviceData["device_status"] = isOnline ? 1 : 0;  // 1表示在线，0表示离线
-            
-            deviceData["temperature"] = latest_data.temperature;
-            deviceData["humidity"] = latest_data.humidity;
-            deviceData["co2"] = latest_data.co2;
-            deviceData["pm25"] = latest_data.pm25;
-            deviceData["noise"] = latest_data.noise;
-            deviceData["light"] = latest_data.light;
-            deviceData["timestamp"] = static_cast<Json::Int64>(latest_data.timestamp);
-            
-            // 添加评分数据
-            deviceData["scores"] = Json::Value();
-            deviceData["scores"]["temperature"] = latest_data.scores.temperature;
-            deviceData["scores"]["humidity"] = latest_data.scores.humidity;
-            deviceData["scores"]["co2"] = latest_data.scores.co2;
-            deviceData["scores"]["pm25"] = latest_data.scores.pm25;
-            deviceData["scores"]["noise"] = latest_data.scores.noise;
-            deviceData["scores"]["light"] = latest_data.scores.light;
-            deviceData["scores"]["overall"] = latest_data.scores.overall;
-            
-            // 添加状态数据
-            deviceData["status"] = Json::Value();
-            deviceData["status"]["temperature"] = latest_data.status.temperature;
-            deviceData["status"]["humidity"] = latest_data.status.humidity;
-            deviceData["status"]["co2"] = latest_data.status.co2;
-            deviceData["status"]["pm25"] = latest_data.status.pm25;
-            deviceData["status"]["noise"] = latest_data.status.noise;
-            deviceData["status"]["light"] = latest_data.status.light;
-            
-            // 添加建议
-            Json::Value suggestionsArray(Json::arrayValue);
-            for (const auto& suggestion : latest_data.suggestions) {
-                suggestionsArray.append(suggestion);
-            }
-            deviceData["suggestions"] = suggestionsArray;
-            
-            root["data"].append(deviceData);
-            std::cout << "[HTTP] Added device data to response" << std::endl;
-        } else {
-            std::cout << "[HTTP] Device has no data" << std::endl;
-        }
+    res.set(http::field::etag, etag);
+    res.set(http::field::cache_control, "no-cache");
+    auto ifNoneMatch = req.find(http::field::if_none_match);
+    if (ifNoneMatch != req.end() && etagMatches(ifNoneMatch->value(), etag)) {
+        res.result(http::status::not_modified);
+        res.erase(http::field::content_encoding);
+        return;
     }
     
-    Json::FastWriter writer;
-    std::string jsonStr = writer.write(root);
-    
     res.result(http::status::ok);
-    res.set(http::field::content_type, "application/json");
-    res.body() = jsonStr;
+    res.body() = body;
 }
 
-void HTTPServer::handleGetRealtimeScore(const http::request<http::string_body>& req, http::response<http::string_body>& res) {
-    Json::Value root;
-    root["data"] = Json::Value(Json::arrayValue);
-    
-    auto& devices = DeviceManager::getInstance().getDevices();
+std::shared_ptr<const HTTPServer::RealtimeSnapshot> HTTPServer::realtimeSnapshot() {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
     
-    for (const auto& device : devices) {
-        if (!device.second->recent_data.empty()) {
-            const auto& latest_data = device.second->recent_data.back();
-            
-            Json::Value scoreData;
-            scoreData["device_id"] = device.first;
-            scoreData["scores"] = Json::Value();
-            scoreData["scores"]["temperature"] = latest_data.scores.temperature;
-            scoreData["scores"]["humidity"] = latest_data.scores.humidity;
-            scoreData["scores"]["co2"] = latest_data.scores.co2;
-            scoreData["scores"]["pm25"] = latest_data.scores.pm25;
-            scoreData["scores"]["noise"] = latest_data.scores.noise;
-            scoreData["scores"]["light"] = latest_data.scores.light;
-            scoreData["scores"]["overall"] = latest_data.scores.overall;
-            
-            // 添加各项指标的评分详情
-            Json::Value tempDetails;
-            tempDetails["value"] = latest_data.temperature;
-            tempDetails["score"] = latest_data.scores.temperature;
-            tempDetails["status"] = getTemperatureStatus(latest_data.temperature, latest_data.area_type);
-            scoreData["details"]["temperature"] = tempDetails;
-            
-            Json::Value humidityDetails;
-            humidityDetails["value"] = latest_data.humidity;
-            humidityDetails["score"] = calculateHumidityScore(latest_data.humidity);
-            humidityDetails["status"] = getHumidityStatus(latest_data.humidity);
-            scoreData["details"]["humidity"] = humidityDetails;
-            
-            Json::Value co2Details;
-            co2Details["value"] = latest_data.co2;
-            co2Details["score"] = calculateCO2Score(latest_data.co2);
-            co2Details["status"] = getCO2Status(latest_data.co2);
-            scoreData["details"]["co2"] = co2Details;
-            
-            Json::Value pm25Details;
-            pm25Details["value"] = latest_data.pm25;
-            pm25Details["score"] = calculatePM25Score(latest_data.pm25);
-            pm25Details["status"] = getPM25Status(latest_data.pm25);
-            scoreData["details"]["pm25"] = pm25Details;
-            
-            // 添加噪音评分
-            Json::Value noiseDetails;
-            noiseDetails["value"] = latest_data.noise;
-            noiseDetails["score"] = calculateNoiseScore(latest_data.noise, latest_data.area_type);
-            noiseDetails["status"] = getNoiseStatus(latest_data.noise, latest_data.area_type);
-            scoreData["details"]["noise"] = noiseDetails;
-            
-            // 添加光照评分
-            Json::Value lightDetails;
-            lightDetails["value"] = latest_data.light;
-            lightDetails["score"] = calculateLightScore(latest_data.light, latest_data.area_type);
-            lightDetails["status"] = getLightStatus(latest_data.light, latest_data.area_type);
-            scoreData["details"]["light"] = lightDetails;
-            
-            scoreData["timestamp"] = static_cast<Json::Int64>(latest_data.timestamp);
-            root["data"].append(scoreData);
+    // 先读版本再构建，构建期间的更新会在下一次请求时触发重建
+    uint64_t version = DeviceManager::getInstance().version();
+    if (realtime_snapshot_) {
+        bool throttled = std::chrono::steady_clock::now() - realtime_snapshot_->built_at < SNAPSHOT_MIN_INTERVAL;
+        bool fresh = version == realtime_snapshot_->version && time(nullptr) < realtime_snapshot_->status_expires;
+        if (throttled || fresh) {
+            return realtime_snapshot_;
         }
     }
     
-    Json::FastWriter writer;
-    res.body() = writer.write(root);
+    realtime_snapshot_ = buildRealtimeSnapshot(version);
+    return realtime_snapshot_;
 }
 
-double HTTPServer::calculateTemperatureScore(double temp, AreaType area_type) {
-    switch (area_type) {
-        case AreaType::LIVING:
-            // 生活区温度要求更舒适
-            if (temp >= 22 && temp <= 26) return 100;
-            if (temp < 22) return 100 - (22 - temp) * 12;
-            return 100 - (temp - 26) * 12;
-            
-        case AreaType::TEACHING:
-            // 教学区温度要求适中
-            if (temp >= 20 && temp <= 25) return 100;
-            if (temp < 20) return 100 - (20 - temp) * 10;
-            return 100 - (temp - 25) * 10;
-            
-        case AreaType::RECREATION:
-            // 娱乐区温度容许范围更大
-            if (temp >= 18 && temp <= 27) return 100;
-            if (temp < 18) return 100 - (18 - temp) * 8;
-            return 100 - (temp - 27) * 8;
+std::shared_ptr<const HTTPServer::RealtimeSnapshot> HTTPServer::buildRealtimeSnapshot(uint64_t version) {
+    time_t now = time(nullptr);
+    time_t status_expires = std::numeric_limits<time_t>::max();
+    std::string body = "{\"data\":[";
+    bool first = true;
+    for (const auto& device : DeviceManager::getInstance().getDevices()) {
+        auto fragments = std::atomic_load(&device.second->fragments);
+        if (!fragments || !fragments->hasData()) {
+            continue;
+        }
+        // 根据最后心跳时间判断设备状态，并记录最早转为离线的时刻
+        bool isOnline = (now - device.second->last_heartbeat) <= DeviceManager::ONLINE_TIMEOUT;
+        if (isOnline) {
+            status_expires = std::min(status_expires, device.second->last_heartbeat + DeviceManager::ONLINE_TIMEOUT + 1);
+        }
+        if (!first) {
+            body += ',';
+        }
+        first = false;
+        body += fragments->full;
+        body += isOnline ? "1}" : "0}";  // 1表示在线，0表示离线
     }
-    return 0;
-}
-
-double HTTPServer::calculateHumidityScore(double humidity) {
-    if (humidity >= 40 && humidity <= 60) return 100;
-    if (humidity < 40) return 100 - (40 - humidity) * 2;
-    return 100 - (humidity - 60) * 2;
+    body += "]}\n";
+    
+    // 强校验 ETag 由内容哈希和长度组成，内容不变的重建保持同一个 ETag
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%016zx-%zx\"", std::hash<std::string>{}(body), body.size());
+    
+    auto snapshot = std::make_shared<RealtimeSnapshot>(std::move(body));
+    snapshot->etag = etag;
+    snapshot->version = version;
+    snapshot->status_expires = status_expires;
+    snapshot->built_at = std::chrono::steady_clock::now();
+    return snapshot;
 }
 
-double HTTPServer::calculateCO2Score(double co2) {
-    if (co2 <= 800) return 100;
-    if (co2 <= 1000) return 80;
-    if (co2 <= 1500) return 60;
-    if (co2 <= 2000) return 40;
-    return 20;
+void HTTPServer::handleGetRealtimeScore(http::response<http::string_body>& res) {
+    std::string& body = res.body();
+    body += "{\"data\":[";
+    bool first = true;
+    for (const auto& device : DeviceManager::getInstance().getDevices()) {
+        auto fragments = std::atomic_load(&device.second->fragments);
+        if (!fragments || !fragments->hasData()) {
+            continue;
+        }
+        if (!first) {
+            body += ',';
+        }
+        first = false;
+        body += fragments->scores;
+    }
+    body += "]}\n";
 }
 
-double HTTPServer::calculatePM25Score(double pm25) {
-    if (pm25 <= 35) return 100;
-    if (pm25 <= 75) return 80;
-    if (pm25 <= 115) return 60;
-    if (pm25 <= 150) return 40;
-    return 20;
+void HTTPServer::handleGetDevices(http::response<http::string_body>& response) {
+    std::string& body = response.body();
+    body += '[';  // 直接返回数组
+    bool first = true;
+    for (const auto& device : DeviceManager::getInstance().getDevices()) {
+        auto fragments = std::atomic_load(&device.second->fragments);
+        if (!fragments) {
+            continue;
+        }
+        if (!first) {
+            body += ',';
+        }
+        first = false;
+        body += fragments->summary;
+        JsonWriter::appendNumber(body, static_cast<long long>(device.second->status));
+        body += ",\"last_update\":";
+        JsonWriter::appendNumber(body, static_cast<long long>(device.second->last_heartbeat));
+        body += '}';
+    }
+    body += "]\n";
+    
+    response.result(http::status::ok);
+    response.set(http::field::content_type, "application/json");
 }
 
-double HTTPServer::calculateNoiseScore(double noise, AreaType area_type) {
-    switch (area_type) {
-        case AreaType::LIVING:
-            // 生活区要求安静
-            if (noise <= 40) return 100;
-            if (noise <= 50) return 80;
-            if (noise <= 60) return 60;
-            if (noise <= 70) return 40;
-            return 20;
-            
-        case AreaType::TEACHING:
-            // 教学区要求较安静
-            if (noise <= 45) return 100;
-            if (noise <= 55) return 80;
-            if (noise <= 65) return 60;
-            if (noise <= 75) return 40;
-            return 20;
-            
-        case AreaType::RECREATION:
-            // 娱乐区允许较大噪音
-            if (noise <= 55) return 100;
-            if (noise <= 65) return 80;
-            if (noise <= 75) return 60;
-            if (noise <= 85) return 40;
-            return 20;
-    }
-    return 0;
+void HTTPServer::handleGetMetrics(http::response<http::string_body>& response) {
+    auto& storage = Storage::getInstance();
+    auto cache = storage.resultCache().stats();
+    uint64_t lookups = cache.hits + cache.misses;
+    
+    JsonWriter json(response.body());
+    json.beginObject();
+    json.key("result_cache").beginObject()
+        .member("hits", static_cast<unsigned long long>(cache.hits))
+        .member("misses", static_cast<unsigned long long>(cache.misses))
+        .member("hit_ratio", lookups ? static_cast<double>(cache.hits) / lookups : 0.0)
+        .member("evictions", static_cast<unsigned long long>(cache.evictions))
+        .member("bytes", static_cast<unsigned long long>(cache.bytes))
+        .member("entries", static_cast<unsigned long long>(cache.entries))
+        .endObject();
+    json.key("hot_tier").beginObject()
+        .member("bytes", static_cast<unsigned long long>(storage.hotTier().memoryUsage()))
+        .endObject();
+    json.endObject();
+    response.body() += '\n';
+    
+    response.result(http::status::ok);
+    response.set(http::field::content_type, "application/json");
 }
 
-double HTTPServer::calculateLightScore(double light, AreaType area_type) {
-    switch (area_type) {
-        case AreaType::LIVING:
-            // 生活区光照要求舒适
-            if (light >= 200 && light <= 500) return 100;
-            if (light < 200) return 60 + (light / 200) * 40;
-            if (light <= 750) return 80;
-            if (light <= 1000) return 60;
-            return 40;
-            
-        case AreaType::TEACHING:
-            // 教学区要求充足明亮
-            if (light >= 400 && light <= 750) return 100;
-            if (light < 400) return 60 + (light / 400) * 40;
-            if (light <= 1000) return 80;
-            if (light <= 1500) return 60;
-            return 40;
-            
-        case AreaType::RECREATION:
-            // 娱乐区光照要求灵活
-            if (light >= 300 && light <= 1000) return 100;
-            if (light < 300) return 60 + (light / 300) * 40;
-            if (light <= 1500) return 80;
-            if (light <= 2000) return 60;
-            return 40;
-    }
-    return 0;
-}
+namespace {
 
-std::string HTTPServer::getTemperatureStatus(double temp, AreaType type) {
-    switch (type) {
-        case AreaType::LIVING:
-            if (temp >= 22 && temp <= 26) return "适宜";
-            if (temp < 22) return "偏冷";
-            return "偏热";
-            
-        case AreaType::TEACHING:
-            if (temp >= 20 && temp <= 25) return "适宜";
-            if (temp < 20) return "偏冷";
-            return "偏热";
-            
-        case AreaType::RECREATION:
-            if (temp >= 18 && temp <= 27) return "适宜";
-            if (temp < 18) return "偏冷";
-            return "偏热";
+// 写出区域汇总的公共字段，调用方负责外层对象的开始和结束
+void writeSummary(JsonWriter& json, const AreaAggregator::Snapshot& snapshot) {
+    json.member("devices", static_cast<unsigned long long>(snapshot.devices))
+        .member("updated_at", static_cast<long long>(snapshot.updated_at));
+    for (int i = 0; i < AreaAggregator::CHANNELS; ++i) {
+        json.key(AreaAggregator::CHANNEL_NAMES[i]).beginObject()
+            .member("mean", snapshot.current[i].mean)
+            .member("min", snapshot.current[i].min)
+            .member("max", snapshot.current[i].max)
+            .endObject();
     }
-    return "异常";
-}
-
-std::string HTTPServer::getHumidityStatus(double humidity) {
-    if (humidity >= 40 && humidity <= 60) return "正常";
-    if (humidity < 40) return "偏干";
-    return "偏湿";
-}
-
-std::string HTTPServer::getCO2Status(double co2) {
-    if (co2 <= 800) return "优";
-    if (co2 <= 1000) return "良";
-    if (co2 <= 1500) return "中";
-    if (co2 <= 2000) return "差";
-    return "很差";
 }
 
-std::string HTTPServer::getPM25Status(double pm25) {
-    if (pm25 <= 35) return "优";
-    if (pm25 <= 75) return "良";
-    if (pm25 <= 115) return "中";
-    if (pm25 <= 150) return "差";
-    return "很差";
-}
+} // namespace
 
-std::string HTTPServer::getNoiseStatus(double noise, AreaType type) {
-    switch (type) {
-        case AreaType::LIVING:
-            if (noise <= 40) return "安静";
-            if (noise <= 50) return "适中";
-            if (noise <= 60) return "较吵";
-            return "很吵";
-            
-        case AreaType::TEACHING:
-            if (noise <= 45) return "安静";
-            if (noise <= 55) return "适中";
-            if (noise <= 65) return "较吵";
-            return "很吵";
-            
-        case AreaType::RECREATION:
-            if (noise <= 55) return "适中";
-            if (noise <= 65) return "正常";
-            if (noise <= 75) return "较吵";
-            return "很吵";
+void HTTPServer::handleGetPercentiles(const HistoryQuery& query, const std::string& label,
+                                      http::response<http::string_body>& response) {
+    response.set(http::field::content_type, "application/json");
+    for (double q : query.quantiles) {
+        if (q < 0 || q > 1) {
+            response.result(http::status::bad_request);
+            response.body() = "{\"error\":\"Quantiles must be within [0, 1]\"}";
+            return;
+        }
     }
-    return "异常";
+    
+    // 嵌入式后端的聚合层不保存草图，分位数查询明确返回不支持
+    auto& storage = Storage::getInstance();
+    if (!storage.hasSketches()) {
+        response.result(http::status::not_implemented);
+        response.body() = "{\"error\":\"Percentiles are not supported by this storage backend\"}";
+        return;
+    }
+    
+    ChannelSketches sketches;
+    if (!storage.queryPercentiles(query.device_ids, query.start_time,
+                                  query.end_time, sketches)) {
+        response.result(http::status::internal_server_error);
+        response.body() = "{\"error\":\"Percentiles unavailable\"}";
+        return;
+    }
+    
+    JsonWriter json(response.body());
+    json.beginObject()
+        .member("label", label)
+        .member("start", static_cast<long long>(query.start_time))
+        .member("end", static_cast<long long>(query.end_time))
+        .member("count", static_cast<unsigned long long>(sketches.channels[0].count()));
+    json.key("channels").beginObject();
+    for (int i = 0; i < ChannelSketches::CHANNELS; ++i) {
+        json.key(ChannelSketches::CHANNEL_NAMES[i]).beginObject();
+        for (double q : query.quantiles) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "p%g", q * 100);
+            json.member(key, sketches.channels[i].quantile(q));
+        }
+        json.endObject();
+    }
+    json.endObject().endObject();
+    response.body() += '\n';
+    
+    response.result(http::status::ok);
 }
 
-std::string HTTPServer::getLightStatus(double light, AreaType type) {
-    switch (type) {
-        case AreaType::LIVING:
-            if (light >= 200 && light <= 500) return "适宜";
-            if (light < 200) return "偏暗";
-            return "偏亮";
-            
-        case AreaType::TEACHING:
-            if (light >= 400 && light <= 750) return "适宜";
-            if (light < 400) return "偏暗";
-            return "偏亮";
-            
-        case AreaType::RECREATION:
-            if (light >= 300 && light <= 1000) return "适宜";
-            if (light < 300) return "偏暗";
-            return "偏亮";
+void HTTPServer::handleGetAreasSummary(http::response<http::string_body>& response) {
+    auto& aggregator = AreaAggregator::getInstance();
+    
+    JsonWriter json(response.body());
+    json.beginObject();
+    json.key("areas").beginObject();
+    for (const auto& snapshot : aggregator.areaSnapshots()) {
+        json.key(snapshot.key).beginObject();
+        writeSummary(json, snapshot);
+        json.endObject();
+    }
+    json.endObject();
+    json.key("area_types").beginObject();
+    for (const auto& snapshot : aggregator.areaTypeSnapshots()) {
+        json.key(snapshot.key).beginObject();
+        writeSummary(json, snapshot);
+        json.endObject();
     }
-    return "异常";
+    json.endObject().endObject();
+    response.body() += '\n';
+    
+    response.result(http::status::ok);
+    response.set(http::field::content_type, "application/json");
 }
 
-void HTTPServer::handleGetDevices(http::response<http::string_body>& response) {
-    Json::Value devices(Json::arrayValue);  // 直接返回数组
-    
-    auto& deviceMap = DeviceManager::getInstance().getDevices();
-    for (const auto& device : deviceMap) {
-        Json::Value deviceJson;
-        deviceJson["device_id"] = device.first;
-        if (!device.second->recent_data.empty()) {
-            const auto& latest_data = device.second->recent_data.back();
-            deviceJson["area"] = latest_data.area;
-            deviceJson["area_type"] = static_cast<int>(latest_data.area_type);
-        } else {
-            deviceJson["area"] = "";
-            deviceJson["area_type"] = 0;
+void HTTPServer::handleGetAreaSummary(const std::string& area, size_t minutes,
+                                      http::response<http::string_body>& response) {
+    AreaAggregator::Snapshot snapshot;
+    std::vector<AreaAggregator::MinuteRollup> rollups;
+    response.set(http::field::content_type, "application/json");
+    if (!AreaAggregator::getInstance().areaSnapshot(area, minutes, snapshot, rollups)) {
+        response.result(http::status::not_found);
+        response.body() = "{\"error\":\"Area not found\"}";
+        return;
+    }
+    
+    JsonWriter json(response.body());
+    json.beginObject().member("area", area);
+    writeSummary(json, snapshot);
+    json.key("minutes").beginArray();
+    for (const auto& rollup : rollups) {
+        json.beginObject()
+            .member("minute", static_cast<long long>(rollup.minute))
+            .member("count", rollup.count);
+        for (int i = 0; i < AreaAggregator::CHANNELS; ++i) {
+            json.key(AreaAggregator::CHANNEL_NAMES[i]).beginObject()
+                .member("mean", rollup.sum[i] / rollup.count)
+                .member("min", rollup.min[i])
+                .member("max", rollup.max[i])
+                .endObject();
         }
-        deviceJson["status"] = static_cast<int>(device.second->status);
-        deviceJson["last_update"] = static_cast<Json::Int64>(device.second->last_heartbeat);
-        
-        devices.append(deviceJson);  // 直接添加到数组
+        json.endObject();
     }
+    json.endArray().endObject();
+    response.body() += '\n';
     
     response.result(http::status::ok);
-    response.set(http::field::content_type, "application/json");
-    response.body() = devices.toStyledString();
 }
 
 void HTTPServer::handleGetDeviceData(const std::string& device_id,
                                    http::response<http::string_body>& response) {
-    Json::Value root;
-    root["code"] = 0;
-    root["message"] = "success";
-    root["data"] = Json::Value(Json::arrayValue);
+    std::string& body = response.body();
+    body += "{\"code\":0,\"message\":\"success\",\"data\":[";
     
     auto& devices = DeviceManager::getInstance().getDevices();
     auto it = devices.find(device_id);
     if (it != devices.end() && it->second) {
-        const auto& device = it->second;
-        if (!device->recent_data.empty()) {
-            const auto& latest_data = device->recent_data.back();
-            
-            Json::Value dataJson;
-            dataJson["device_id"] = device_id;
-            dataJson["area"] = latest_data.area;
-            dataJson["area_type"] = static_cast<int>(latest_data.area_type);
-            dataJson["device_status"] = (time(nullptr) - device->last_heartbeat) <= 30 ? 1 : 0;  // 30秒内有心跳就认为在线
-            dataJson["temperature"] = latest_data.temperature;
-            dataJson["humidity"] = latest_data.humidity;
-            dataJson["co2"] = latest_data.co2;
-            dataJson["pm25"] = latest_data.pm25;
-            dataJson["noise"] = latest_data.noise;
-            dataJson["light"] = latest_data.light;
-            dataJson["timestamp"] = static_cast<Json::Int64>(latest_data.timestamp);
-            
-            // 添加评分数据
-            dataJson["scores"] = Json::Value();
-            dataJson["scores"]["temperature"] = latest_data.scores.temperature;
-            dataJson["scores"]["humidity"] = latest_data.scores.humidity;
-            dataJson["scores"]["co2"] = latest_data.scores.co2;
-            dataJson["scores"]["pm25"] = latest_data.scores.pm25;
-            dataJson["scores"]["noise"] = latest_data.scores.noise;
-            dataJson["scores"]["light"] = latest_data.scores.light;
-            dataJson["scores"]["overall"] = latest_data.scores.overall;
-            
-            // 添加状态数据
-            dataJson["status"] = Json::Value();
-            dataJson["status"]["temperature"] = latest_data.status.temperature;
-            dataJson["status"]["humidity"] = latest_data.status.humidity;
-            dataJson["status"]["co2"] = latest_data.status.co2;
-            dataJson["status"]["pm25"] = latest_data.status.pm25;
-            dataJson["status"]["noise"] = latest_data.status.noise;
-            dataJson["status"]["light"] = latest_data.status.light;
-            
-            // 添加建议
-            Json::Value suggestionsArray(Json::arrayValue);
-            for (const auto& suggestion : latest_data.suggestions) {
-                suggestionsArray.append(suggestion);
-            }
-            dataJson["suggestions"] = suggestionsArray;
-            
-            root["data"].append(dataJson);
+        auto fragments = std::atomic_load(&it->second->fragments);
+        if (fragments && fragments->hasData()) {
+            body += fragments->full;
+            // 30秒内有心跳就认为在线
+            body += (time(nullptr) - it->second->last_heartbeat) <= DeviceManager::ONLINE_TIMEOUT ? "1}" : "0}";
         }
     }
+    body += "]}\n";
     
     response.result(http::status::ok);
     response.set(http::field::content_type, "application/json");
-    response.body() = root.toStyledString();
 }
 
-void HTTPServer::handleGetDeviceHistory(const std::string& device_id,
-                                       const std::string& dataType,
-                                       time_t start_time,
-                                       time_t end_time,
-                                       http::response<http::string_body>& response) {
-    std::cout << "[HTTP] Handling history request - Device: " << device_id 
-              << ", Type: " << dataType << std::endl;
-    
-    std::vector<SensorData> history_data;
-    
-    // 根据数据类型选择不同的查询方法
-    if (dataType == "realtime") {
-        history_data = Database::getInstance().queryRealtimeData(device_id, start_time, end_time);
-    } else if (dataType == "hourly") {
-        history_data = Database::getInstance().queryHourlyData(device_id, start_time, end_time);
-    } else if (dataType == "daily") {
-        history_data = Database::getInstance().queryDailyData(device_id, start_time, end_time);
-    }
-    
-    // 如果没有数据，返回空数组
-    if (history_data.empty()) {
-        Json::Value root;
-        root["data"] = Json::Value(Json::arrayValue);
-        response.result(http::status::ok);
-        response.set(http::field::content_type, "application/json");
-        response.set(http::field::access_control_allow_origin, "*");
-        response.body() = root.toStyledString();
-        return;
+void HTTPServer::handleGetDeviceHistory(const HistoryQuery& query,
+                                        std::unique_ptr<ChunkWriter>& stream) {
+#ifdef DEBUG_MODE
+    std::cout << "[HTTP] Handling history request - Device: " << query.device_id 
+              << ", Type: " << query.type << std::endl;
+#endif
+    
+    // 根据数据类型选择不同的查询游标，auto 按时间范围跨层拼接，未知类型返回空数组
+    auto& storage = Storage::getInstance();
+    std::unique_ptr<RowCursor> cursor;
+    if (query.type == "auto") {
+        cursor = storage.openHistoryCursor(query.device_id, query.start_time, query.end_time);
+    } else if (query.type == "realtime") {
+        cursor = storage.openRawCursor(query.device_id, query.start_time, query.end_time);
+    } else if (query.type == "hourly") {
+        cursor = storage.openCachedCursor(ResultCache::HOURLY, query.device_id,
+                                          query.start_time, query.end_time);
+    } else if (query.type == "daily") {
+        cursor = storage.openCachedCursor(ResultCache::DAILY, query.device_id,
+                                          query.start_time, query.end_time);
+    } else {
+        cursor = std::make_unique<VectorCursor>();
+    }
+    
+    // 点数超过图表像素没有意义，在数据流出数据库时降采样
+    if (query.max_points > 0) {
+        DownsamplingCursor::Mode mode;
+        double SensorData::*field;
+        DownsamplingCursor::parseMode(query.mode, mode);
+        DownsamplingCursor::parseField(query.field, field);
+        cursor = std::make_unique<DownsamplingCursor>(std::move(cursor), query.start_time,
+                                                      query.end_time, query.max_points,
+                                                      mode, field);
     }
     
-    // 构建JSON响应
-    Json::Value root;
-    Json::Value data_array(Json::arrayValue);
+    stream = std::make_unique<HistoryChunkWriter>(std::move(cursor));
+}
+
+void HTTPServer::handleGetMultiHistory(const HistoryQuery& query,
+                                      const std::string& label,
+                                      std::unique_ptr<ChunkWriter>& stream) {
+#ifdef DEBUG_MODE
+    std::cout << "[HTTP] Handling multi-device history request - " << label << ": "
+              << query.device_ids.size() << " devices, Type: " << query.type << std::endl;
+#endif
+    
+    DataTier tier;
+    parseTier(query.type, tier);
+    std::unique_ptr<RowCursor> cursor = Storage::getInstance().openMultiHistoryCursor(
+        tier, query.device_ids, query.start_time, query.end_time);
     
-    for (const auto& data : history_data) {
-        Json::Value dataJson;
-        dataJson["timestamp"] = Json::Int64(data.timestamp);
-        dataJson["temperature"] = data.temperature;
-        dataJson["humidity"] = data.humidity;
-        dataJson["co2"] = data.co2;
-        dataJson["pm25"] = data.pm25;
-        dataJson["noise"] = data.noise;
-        dataJson["light"] = data.light;
-        data_array.append(dataJson);
+    // 跨设备聚合，桶宽默认与数据层粒度一致（实时数据为一分钟）
+    bool aggregated = !query.aggregate.empty();
+    if (aggregated) {
+        AreaAggregateCursor::Mode mode;
+        AreaAggregateCursor::parseMode(query.aggregate, mode);
+        time_t bucket = query.bucket_seconds;
+        if (bucket <= 0) {
+            bucket = tier == DataTier::REALTIME ? 60 : (tier == DataTier::HOURLY ? 3600 : 24 * 3600);
+        }
+        cursor = std::make_unique<AreaAggregateCursor>(std::move(cursor), label, bucket, mode);
     }
     
-    root["data"] = data_array;
+    stream = std::make_unique<HistoryChunkWriter>(std::move(cursor), !aggregated);
+}
+
+void HTTPServer::handleExport(const HistoryQuery& query,
+                              const std::string& label,
+                              http::response<http::string_body>& response,
+                              std::unique_ptr<ChunkWriter>& stream) {
+#ifdef DEBUG_MODE
+    std::cout << "[HTTP] Export " << label << ": " << query.device_ids.size() << " devices, "
+              << query.type << ", " << query.format << std::endl;
+#endif
     
-    std::cout << "[HTTP] Returning " << history_data.size() << " records" << std::endl;
+    // 绕过热层和结果缓存，逐块编码写出，内存占用与范围无关。
+    // 导出游标使用专用连接，下载再慢也不占用在线查询和入库的连接
+    DataTier tier;
+    parseTier(query.type, tier);
+    auto cursor = Storage::getInstance().openExportCursor(tier, query.device_ids,
+                                                         query.start_time, query.end_time);
+    if (!cursor) {
+        setUnavailable(response, "Too many concurrent exports");
+        return;
+    }
+    if (query.format == "evmc") {
+        stream = std::make_unique<ColumnChunkWriter>(std::move(cursor));
+    } else {
+        stream = std::make_unique<CsvChunkWriter>(std::move(cursor));
+    }
     
-    response.result(http::status::ok);
-    response.set(http::field::content_type, "application/json");
-    response.set(http::field::access_control_allow_origin, "*");
-    response.body() = root.toStyledString();
-}
\ No newline at end of file
+    std::string filename = label + "_" + query.type + "_" + std::to_string(query.start_time) + "_" +
+                           std::to_string(query.end_time) + "." + query.format;
+    for (char& c : filename) {
+        if (c == '"' || c == '/' || c == '\\' || static_cast<unsigned char>(c) < 0x20) {
+            c = '_';
+        }
+    }
+    response.set(http::field::content_disposition, "attachment; filename=\"" + filename + "\"");
+}
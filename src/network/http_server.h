@@ -3,73 +3,124 @@
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
 #include <boost/asio.hpp>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "../models/sensor_data.h"
 #include "../device/device_manager.h"
 #include "../scoring/environment_scorer.h"
-#include "../database/database.h"
+#include "../database/storage.h"
+#include "compression.h"
+#include "history_stream.h"
+#include "push_hub.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
+// 历史数据请求参数
+struct HistoryQuery {
+    std::string device_id;
+    std::vector<std::string> device_ids;  // 多设备查询
+    std::string aggregate;                // 多设备查询的跨设备聚合：mean、min 或 max
+    time_t bucket_seconds = 0;            // 跨设备聚合的桶宽，0 表示按数据层默认
+    std::string type = "realtime";
+    time_t start_time = 0;
+    time_t end_time = 0;
+    bool has_start = false;          // 请求中显式给出了 start
+    size_t max_points = 0;           // 大于 0 时在服务端降采样，要求显式给出 start
+    std::string mode = "lttb";       // lttb 或 minmax
+    std::string field = "temperature";  // 降采样依据的字段
+    std::vector<double> quantiles = {0.5, 0.95, 0.99};  // 分位数查询
+    std::string format = "csv";      // 批量导出格式：csv 或 evmc（列式）
+};
+
 class HTTPServer {
 public:
     HTTPServer(int port);
     void start();
+    
+    // 可由多个线程同时调用，各线程共同处理所有会话
     void run();
     void stop();
+    
+    // 工作线程数：环境变量 EVM_HTTP_THREADS，默认为 CPU 核数
+    static size_t threadsFromEnv();
 
 private:
+    friend class HttpSession;
+    
     void do_accept();
-    void handle_request(http::request<http::string_body>&& req, tcp::socket& socket);
+    
+    // 填写 response 由会话异步写出。stream 非空时 response 只作为响应头，
+    // 响应体由会话从 stream 逐块生成并以 chunked 编码写出。
+    // keep_alive 为 false 时响应带 Connection: close
+    void handle_request(const http::request<http::string_body>& req, bool keep_alive,
+                        http::response<http::string_body>& response,
+                        std::unique_ptr<ChunkWriter>& stream);
+    
+    // GET /api/stream?devices=a,b&area=X 返回 true 并填写过滤条件，会话随后转为 SSE 推送连接
+    static bool parseStreamRequest(const http::request<http::string_body>& req, PushHub::Filter& filter);
     
     // 设备管理接口
     void handleRegisterDevice(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handleUnregisterDevice(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handleGetDevices(http::response<http::string_body>& response);
     void handleGetDeviceData(const std::string& device_id, http::response<http::string_body>& response);
-    void handleGetDeviceHistory(const std::string& device_id,
-                               const std::string& dataType,
-                               time_t start_time,
-                               time_t end_time,
-                               http::response<http::string_body>& response);
+    void handleGetDeviceHistory(const HistoryQuery& query,
+                                std::unique_ptr<ChunkWriter>& stream);
+    void handleGetMultiHistory(const HistoryQuery& query,
+                               const std::string& label,
+                               std::unique_ptr<ChunkWriter>& stream);
+    void handleExport(const HistoryQuery& query,
+                      const std::string& label,
+                      http::response<http::string_body>& response,
+                      std::unique_ptr<ChunkWriter>& stream);
     void handleGetDeviceStatus(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handleUpdateDeviceConfig(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     
     // 数据查询接口
     void handleGetRealtimeData(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handleGetHistoryData(const http::request<http::string_body>& req, http::response<http::string_body>& res);
+    void handleGetMetrics(http::response<http::string_body>& response);
+    void handleGetPercentiles(const HistoryQuery& query, const std::string& label,
+                              http::response<http::string_body>& response);
+    void handleGetAreasSummary(http::response<http::string_body>& response);
+    void handleGetAreaSummary(const std::string& area, size_t minutes,
+                              http::response<http::string_body>& response);
     void handleGetStatistics(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handlePostData(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     
     // 评分和建议接口
-    void handleGetRealtimeScore(const http::request<http::string_body>& req, http::response<http::string_body>& res);
+    void handleGetRealtimeScore(http::response<http::string_body>& res);
     void handleGetHistoryScores(const http::request<http::string_body>& req, http::response<http::string_body>& res);
     void handleGetSuggestions(const http::request<http::string_body>& req, http::response<http::string_body>& res);
 
-    // 添加评分辅助函数声明
-    double calculateTemperatureScore(double temp, AreaType area_type);
-    double calculateHumidityScore(double humidity);
-    double calculateCO2Score(double co2);
-    double calculatePM25Score(double pm25);
+    // 预先序列化的实时数据响应，轮询请求直接复制这份字节（或其缓存的压缩版本）
+    struct RealtimeSnapshot {
+        explicit RealtimeSnapshot(std::string body) : content(std::move(body)) {}
+        
+        CompressedVariants content;
+        std::string etag;              // 原始内容的 ETag，压缩版本在其后附加编码名
+        uint64_t version = 0;          // 构建时的设备版本
+        time_t status_expires = 0;     // 最早有在线设备因心跳超时转为离线的时刻
+        std::chrono::steady_clock::time_point built_at;
+    };
     
-    std::string getTemperatureStatus(double temp, AreaType type);
-    std::string getHumidityStatus(double humidity);
-    std::string getCO2Status(double co2);
-    std::string getPM25Status(double pm25);
-
-    double calculateNoiseScore(double noise, AreaType area_type);
-    std::string getNoiseStatus(double noise, AreaType type);
-
-    double calculateLightScore(double light, AreaType area_type);
-    std::string getLightStatus(double light, AreaType type);
+    // 设备版本变化或在线状态到期时重建，两次重建至少间隔 SNAPSHOT_MIN_INTERVAL
+    std::shared_ptr<const RealtimeSnapshot> realtimeSnapshot();
+    static std::shared_ptr<const RealtimeSnapshot> buildRealtimeSnapshot(uint64_t version);
 
     // 成员变量按照初始化顺序声明
     net::io_context ioc_;
     tcp::acceptor acceptor_;
-    beast::flat_buffer buffer_;
     int port_;
+    
+    std::mutex snapshot_mutex_;
+    std::shared_ptr<const RealtimeSnapshot> realtime_snapshot_;
+    
+    static constexpr std::chrono::seconds SNAPSHOT_MIN_INTERVAL{1};
 }; 
\ No newline at end of file
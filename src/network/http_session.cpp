@@ -0,0 +1,205 @@
+#include "http_session.h"
+#include <iostream>
+#include "compression.h"
+#include "http_server.h"
+#include "sse_session.h"
+
+HttpSession::HttpSession(HTTPServer& server, tcp::socket&& socket)
+    : server_(server)
+    , stream_(std::move(socket)) {
+}
+
+void HttpSession::start() {
+    // 接受连接的回调不在本会话的 strand 上，第一次读取切换到 strand 中发起
+    net::dispatch(stream_.get_executor(),
+        [self = shared_from_this()]() {
+            self->doRead();
+        });
+}
+
+void HttpSession::doRead() {
+    // 每个请求使用新的解析器，限制头部和请求体大小
+    parser_.emplace();
+    parser_->header_limit(MAX_HEADER_BYTES);
+    parser_->body_limit(MAX_BODY_BYTES);
+
+    stream_.expires_after(IDLE_TIMEOUT);
+    http::async_read(stream_, buffer_, *parser_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+            self->onRead(ec, bytes);
+        });
+}
+
+void HttpSession::onRead(beast::error_code ec, std::size_t) {
+    if (ec == http::error::end_of_stream || ec == beast::error::timeout) {
+        close();
+        return;
+    }
+    if (ec) {
+        if (ec != net::error::operation_aborted && ec != net::error::connection_reset) {
+            std::cerr << "[HTTP] Read error: " << ec.message() << std::endl;
+        }
+        close();
+        return;
+    }
+
+    http::request<http::string_body> req = parser_->release();
+    keep_alive_ = req.keep_alive() && ++requests_ < MAX_REQUESTS_PER_CONNECTION;
+
+    // 订阅请求把套接字交给推送会话，本会话随之结束
+    PushHub::Filter filter;
+    if (HTTPServer::parseStreamRequest(req, filter)) {
+        std::make_shared<SseSession>(std::move(stream_), std::move(filter), req.version())->start();
+        return;
+    }
+
+    // 响应体缓冲区在同一连接的请求间复用，处理函数直接向其中追加
+    std::string buffer = std::move(response_.body());
+    response_ = {};
+    if (buffer.capacity() <= MAX_REUSED_BODY_BYTES) {
+        buffer.clear();
+        response_.body() = std::move(buffer);
+    }
+    body_.reset();
+    server_.handle_request(req, keep_alive_, response_, body_);
+    compressResponse(req);
+    if (body_) {
+        startStream();
+        return;
+    }
+
+    stream_.expires_after(WRITE_TIMEOUT);
+    http::async_write(stream_, response_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+            self->onWrite(ec, bytes);
+        });
+}
+
+void HttpSession::onWrite(beast::error_code ec, std::size_t) {
+    body_.reset();
+    if (ec) {
+        std::cerr << "[HTTP] Write error: " << ec.message() << std::endl;
+        close();
+        return;
+    }
+    if (!keep_alive_) {
+        close();
+        return;
+    }
+    doRead();
+}
+
+void HttpSession::compressResponse(const http::request<http::string_body>& req) {
+    // 已由处理函数选择了缓存的压缩版本，或不是成功响应
+    if (response_.result() != http::status::ok || response_.count(http::field::content_encoding)) {
+        return;
+    }
+    auto header = response_[http::field::content_type];
+    std::string_view content_type = body_ ? std::string_view(body_->contentType())
+                                          : std::string_view(header.data(), header.size());
+    if (!HttpCompression::compressible(content_type)) {
+        return;
+    }
+    response_.set(http::field::vary, "Accept-Encoding");
+
+    auto accept = req[http::field::accept_encoding];
+    ContentEncoding encoding = HttpCompression::negotiate(std::string_view(accept.data(), accept.size()));
+    if (encoding == ContentEncoding::IDENTITY) {
+        return;
+    }
+    if (body_) {
+        body_ = std::make_unique<CompressingChunkWriter>(std::move(body_), encoding);
+        response_.set(http::field::content_encoding, HttpCompression::name(encoding));
+        return;
+    }
+
+    auto& body = response_.body();
+    if (body.size() < HttpCompression::settings().min_bytes) {
+        return;
+    }
+    compressed_.clear();
+    if (!HttpCompression::compress(encoding, body, compressed_) || compressed_.size() >= body.size()) {
+        return;
+    }
+    body.swap(compressed_);
+    if (compressed_.capacity() > MAX_REUSED_BODY_BYTES) {
+        compressed_ = std::string();
+    }
+    response_.set(http::field::content_encoding, HttpCompression::name(encoding));
+    response_.prepare_payload();
+}
+
+void HttpSession::startStream() {
+    // HTTP/1.0 不支持 chunked，退化为一次性生成完整响应体
+    if (response_.version() < 11) {
+        response_.set(http::field::content_type, body_->contentType());
+        while (body_->nextChunk(chunk_)) {
+            response_.body() += chunk_;
+        }
+        response_.prepare_payload();
+        stream_.expires_after(WRITE_TIMEOUT);
+        http::async_write(stream_, response_,
+            [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+                self->onWrite(ec, bytes);
+            });
+        return;
+    }
+
+    stream_header_.emplace(http::status::ok, response_.version());
+    for (const auto& field : response_) {
+        stream_header_->set(field.name_string(), field.value());
+    }
+    stream_header_->set(http::field::content_type, body_->contentType());
+    stream_header_->keep_alive(keep_alive_);
+    stream_header_->chunked(true);
+    serializer_.emplace(*stream_header_);
+
+    stream_.expires_after(WRITE_TIMEOUT);
+    http::async_write_header(stream_, *serializer_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+            self->onChunkWritten(ec, bytes);
+        });
+}
+
+void HttpSession::writeNextChunk() {
+    stream_.expires_after(WRITE_TIMEOUT);
+    if (body_->nextChunk(chunk_)) {
+        net::async_write(stream_, http::make_chunk(net::buffer(chunk_)),
+            [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+                self->onChunkWritten(ec, bytes);
+            });
+        return;
+    }
+
+    if (body_->failed()) {
+        // 游标中途出错时不写结束块，关闭连接让客户端知道响应不完整
+        std::cerr << "[HTTP] Stream aborted after " << body_->rowCount() << " rows" << std::endl;
+        close();
+        return;
+    }
+#ifdef DEBUG_MODE
+    std::cout << "[HTTP] Streamed " << body_->rowCount() << " records" << std::endl;
+#endif
+    net::async_write(stream_, http::make_chunk_last(),
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+            self->serializer_.reset();
+            self->stream_header_.reset();
+            self->onWrite(ec, bytes);
+        });
+}
+
+void HttpSession::onChunkWritten(beast::error_code ec, std::size_t) {
+    if (ec) {
+        std::cerr << "[HTTP] Write error: " << ec.message() << std::endl;
+        close();
+        return;
+    }
+    writeNextChunk();
+}
+
+void HttpSession::close() {
+    body_.reset();
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    stream_.close();
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include "history_stream.h"
+
+class HTTPServer;
+
+// 一个 HTTP 连接：独立的读缓冲区，按 keep-alive 循环读取请求，
+// 空闲超时或达到单连接请求上限后关闭。
+// 套接字绑定在独立的 strand 上，同一连接同时只有一个读或写操作，所有写出均为异步；
+// 流式响应每写完一块才生成下一块，慢客户端不会占用工作线程
+class HttpSession : public std::enable_shared_from_this<HttpSession> {
+public:
+    HttpSession(HTTPServer& server, boost::asio::ip::tcp::socket&& socket);
+
+    void start();
+
+private:
+    void doRead();
+    void onRead(boost::beast::error_code ec, std::size_t bytes);
+    void onWrite(boost::beast::error_code ec, std::size_t bytes);
+    void close();
+
+    // 按 Accept-Encoding 压缩尚未编码的文本响应，流式响应改为逐块压缩
+    void compressResponse(const boost::beast::http::request<boost::beast::http::string_body>& req);
+
+    // chunked 流式响应
+    void startStream();
+    void writeNextChunk();
+    void onChunkWritten(boost::beast::error_code ec, std::size_t bytes);
+
+    HTTPServer& server_;
+    boost::beast::tcp_stream stream_;
+    boost::beast::flat_buffer buffer_;
+    std::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser_;
+    size_t requests_ = 0;
+    bool keep_alive_ = false;
+
+    // 当前请求的响应；body_ 非空时 response_ 只作为响应头
+    boost::beast::http::response<boost::beast::http::string_body> response_;
+    std::unique_ptr<ChunkWriter> body_;
+    std::optional<boost::beast::http::response<boost::beast::http::empty_body>> stream_header_;
+    std::optional<boost::beast::http::response_serializer<boost::beast::http::empty_body>> serializer_;
+    std::string chunk_;
+    std::string compressed_;  // 压缩输出缓冲区，与响应体交换后复用
+
+    static constexpr std::chrono::seconds IDLE_TIMEOUT{30};      // 两个请求之间的最长空闲时间
+    static constexpr std::chrono::seconds WRITE_TIMEOUT{60};     // 单次写出的最长时间
+    static constexpr size_t MAX_REQUESTS_PER_CONNECTION = 1000;  // 之后响应带 Connection: close
+    static constexpr size_t MAX_HEADER_BYTES = 8 * 1024;
+    static constexpr size_t MAX_BODY_BYTES = 1 << 20;
+    static constexpr size_t MAX_REUSED_BODY_BYTES = 256 * 1024;  // 超过该容量的响应体缓冲区不再复用
+};
@@ -0,0 +1,76 @@
+#include "push_hub.h"
+#include <ctime>
+#include "../device/device_manager.h"
+
+bool PushHub::Filter::matches(const std::string& device_id, const std::string& device_area) const {
+    if (!device_ids.empty() && device_ids.count(device_id) == 0) {
+        return false;
+    }
+    return area.empty() || area == device_area;
+}
+
+void PushHub::subscribe(const std::shared_ptr<Subscriber>& subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.push_back(subscriber);
+}
+
+void PushHub::publish(const std::string& device_id, const std::string& area, const DeviceFragments& fragments) {
+    if (!fragments.hasData()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Subscriber>> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = subscribers_.begin();
+        while (it != subscribers_.end()) {
+            auto subscriber = it->lock();
+            if (!subscriber) {
+                it = subscribers_.erase(it);
+                continue;
+            }
+            if (subscriber->filter().matches(device_id, area)) {
+                targets.push_back(std::move(subscriber));
+            }
+            ++it;
+        }
+    }
+    if (targets.empty()) {
+        return;
+    }
+
+    // 所有订阅者共享同一个帧
+    auto frame = std::make_shared<std::string>();
+    frame->reserve(fragments.full.size() + 32);
+    *frame += "event: reading\ndata: ";
+    *frame += fragments.full;
+    *frame += "1}\n\n";
+    for (const auto& subscriber : targets) {
+        subscriber->deliver(device_id, frame);
+    }
+}
+
+std::string PushHub::snapshotFrame(const Filter& filter) {
+    time_t now = time(nullptr);
+    std::string frame = "event: snapshot\ndata: {\"data\":[";
+    bool first = true;
+    for (const auto& device : DeviceManager::getInstance().getAllDevices()) {
+        auto fragments = std::atomic_load(&device->fragments);
+        if (!fragments || !fragments->hasData() || !filter.matches(device->device_id, device->location_id)) {
+            continue;
+        }
+        if (!first) {
+            frame += ',';
+        }
+        first = false;
+        frame += fragments->full;
+        frame += (now - device->last_heartbeat) <= DeviceManager::ONLINE_TIMEOUT ? "1}" : "0}";
+    }
+    frame += "]}\n\n";
+    return frame;
+}
+
+size_t PushHub::subscriberCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return subscribers_.size();
+}
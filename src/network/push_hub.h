@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "../device/device_fragments.h"
+
+// 实时数据推送中心。每条新读数只序列化一次成 SSE 帧，
+// 同一个帧对象分发给所有过滤条件匹配的订阅者；没有订阅者匹配时不做序列化。
+class PushHub {
+public:
+    static PushHub& getInstance() {
+        static PushHub instance;
+        return instance;
+    }
+
+    // 订阅过滤条件，两个条件都为空时接收所有设备
+    struct Filter {
+        std::set<std::string> device_ids;  // 为空表示不按设备过滤
+        std::string area;                  // 为空表示不按区域过滤
+
+        bool matches(const std::string& device_id, const std::string& device_area) const;
+    };
+
+    class Subscriber {
+    public:
+        virtual ~Subscriber() = default;
+        virtual const Filter& filter() const = 0;
+
+        // 在发布线程上调用，不得阻塞。同一设备尚未写出的帧应被新帧替换，慢客户端只收到最新状态
+        virtual void deliver(const std::string& device_id, std::shared_ptr<const std::string> frame) = 0;
+    };
+
+    // 只保存弱引用，订阅者销毁后在下一次发布时移除
+    void subscribe(const std::shared_ptr<Subscriber>& subscriber);
+
+    // 新读数到达时由接收线程调用，推送的设备状态总是在线
+    void publish(const std::string& device_id, const std::string& area, const DeviceFragments& fragments);
+
+    // 当前所有匹配设备的最新状态，作为新订阅者的第一个事件
+    static std::string snapshotFrame(const Filter& filter);
+
+    size_t subscriberCount();
+
+private:
+    PushHub() = default;
+    ~PushHub() = default;
+    PushHub(const PushHub&) = delete;
+    PushHub& operator=(const PushHub&) = delete;
+
+    std::mutex mutex_;
+    std::vector<std::weak_ptr<Subscriber>> subscribers_;
+};
@@ -0,0 +1,151 @@
+#include "sse_session.h"
+#include <iostream>
+#include <sstream>
+#include <boost/beast/http.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+namespace {
+
+// SSE 注释行，客户端忽略，用于保持连接和及时发现断开的客户端
+const auto PING_FRAME = std::make_shared<const std::string>(": ping\n\n");
+
+} // namespace
+
+SseSession::SseSession(beast::tcp_stream&& stream, PushHub::Filter filter, unsigned http_version)
+    : stream_(std::move(stream))
+    , filter_(std::move(filter))
+    , http_version_(http_version)
+    , ping_timer_(stream_.get_executor()) {
+}
+
+void SseSession::start() {
+    net::dispatch(stream_.get_executor(),
+        [self = shared_from_this()]() {
+            // 先订阅再生成快照，两者之间到达的读数会在快照之后再推送一次，不会丢失
+            PushHub::getInstance().subscribe(self);
+
+            // 限制内核发送缓冲区，慢客户端的积压留在 pending_ 中合并，而不是在内核里排队过期数据
+            beast::error_code ec;
+            self->stream_.socket().set_option(net::socket_base::send_buffer_size(SEND_BUFFER_BYTES), ec);
+
+            // 不带 Content-Length 也不用 chunked，响应体一直延续到连接关闭
+            http::response<http::empty_body> header{http::status::ok, self->http_version_};
+            header.set(http::field::server, "EVM Monitor");
+            header.set(http::field::content_type, "text/event-stream");
+            header.set(http::field::cache_control, "no-cache");
+            header.set(http::field::access_control_allow_origin, "*");
+            header.keep_alive(false);
+            std::ostringstream os;
+            os << header.base();
+
+            self->in_flight_.push_back(std::make_shared<const std::string>(os.str()));
+            self->in_flight_.push_back(std::make_shared<const std::string>(PushHub::snapshotFrame(self->filter_)));
+            self->write();
+            self->waitForClose();
+            self->schedulePing();
+            std::cout << "[Push] Subscriber connected (" << PushHub::getInstance().subscriberCount()
+                      << " active)" << std::endl;
+        });
+}
+
+void SseSession::deliver(const std::string& device_id, std::shared_ptr<const std::string> frame) {
+    if (closed_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[device_id] = std::move(frame);
+        if (flush_posted_) {
+            return;
+        }
+        flush_posted_ = true;
+    }
+    net::post(stream_.get_executor(),
+        [self = shared_from_this()]() {
+            self->flush();
+        });
+}
+
+void SseSession::waitForClose() {
+    // 订阅后客户端不再发送数据，套接字可读即表示对端关闭了连接
+    stream_.socket().async_wait(tcp::socket::wait_read,
+        [self = shared_from_this()](beast::error_code) {
+            self->close();
+        });
+}
+
+void SseSession::schedulePing() {
+    ping_timer_.expires_after(PING_INTERVAL);
+    ping_timer_.async_wait(
+        [self = shared_from_this()](beast::error_code ec) {
+            if (ec || self->closed_) {
+                return;
+            }
+            self->deliver("", PING_FRAME);
+            self->schedulePing();
+        });
+}
+
+void SseSession::flush() {
+    // 正在写出时由 onWrite 继续调用，期间到达的帧留在 pending_ 中合并
+    if (writing_ || closed_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_posted_ = false;
+        for (auto& entry : pending_) {
+            in_flight_.push_back(std::move(entry.second));
+        }
+        pending_.clear();
+    }
+    if (!in_flight_.empty()) {
+        write();
+    }
+}
+
+void SseSession::write() {
+    buffers_.clear();
+    for (const auto& frame : in_flight_) {
+        buffers_.push_back(net::buffer(*frame));
+    }
+    writing_ = true;
+    stream_.expires_after(WRITE_TIMEOUT);
+    net::async_write(stream_, buffers_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+            self->onWrite(ec, bytes);
+        });
+}
+
+void SseSession::onWrite(beast::error_code ec, std::size_t) {
+    writing_ = false;
+    in_flight_.clear();
+    if (ec) {
+        if (ec == beast::error::timeout) {
+            std::cerr << "[Push] Subscriber write timed out" << std::endl;
+        }
+        close();
+        return;
+    }
+    stream_.expires_never();
+    flush();
+}
+
+void SseSession::close() {
+    if (closed_.exchange(true)) {
+        return;
+    }
+    ping_timer_.cancel();
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    stream_.close();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+    }
+    std::cout << "[Push] Subscriber disconnected" << std::endl;
+}
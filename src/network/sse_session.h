@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include "push_hub.h"
+
+// 一个 Server-Sent Events 订阅连接，由 HttpSession 在收到 /api/stream 请求后接管套接字。
+// 先写出响应头和匹配设备的快照，之后推送 PushHub 分发的读数帧，连接关闭即响应结束。
+// 写出期间到达的帧按设备合并，同一设备只保留最新一帧，慢客户端不会积压过期数据
+class SseSession : public PushHub::Subscriber, public std::enable_shared_from_this<SseSession> {
+public:
+    SseSession(boost::beast::tcp_stream&& stream, PushHub::Filter filter, unsigned http_version);
+
+    void start();
+
+    const PushHub::Filter& filter() const override { return filter_; }
+    void deliver(const std::string& device_id, std::shared_ptr<const std::string> frame) override;
+
+private:
+    void waitForClose();
+    void schedulePing();
+    void flush();
+    void write();
+    void onWrite(boost::beast::error_code ec, std::size_t bytes);
+    void close();
+
+    boost::beast::tcp_stream stream_;
+    PushHub::Filter filter_;
+    unsigned http_version_;
+    boost::asio::steady_timer ping_timer_;
+    std::atomic<bool> closed_{false};
+
+    // 由发布线程写入，mutex_ 保护；flush_posted_ 为 true 时已有 flush 排队或写出尚未完成
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<const std::string>> pending_;
+    bool flush_posted_ = false;
+
+    // 以下只在 strand 上访问
+    std::vector<std::shared_ptr<const std::string>> in_flight_;
+    std::vector<boost::asio::const_buffer> buffers_;
+    bool writing_ = false;
+
+    static constexpr std::chrono::seconds WRITE_TIMEOUT{30};   // 单次写出的最长时间，超时视为客户端失联
+    static constexpr std::chrono::seconds PING_INTERVAL{15};   // 没有数据时的保活注释间隔
+    static constexpr int SEND_BUFFER_BYTES = 32 * 1024;
+};
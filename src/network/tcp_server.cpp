@@ -1,14 +1,21 @@
 #include "tcp_server.h"
 #include <jsoncpp/json/json.h>
 #include <iostream>
+#include <cmath>
 #include <ctime>
+#include <stdexcept>
 #include "../scoring/environment_scorer.h"
 #include "../utils/json_helper.h"
 #include "../device/device_manager.h"
+#include "../services/area_aggregator.h"
+#include "push_hub.h"
 
-TCPServer::TCPServer(boost::asio::io_context& io_context, short port, Database& db)
+TCPServer::TCPServer(boost::asio::io_context& io_context, short port, Storage& storage,
+                     AsyncDatabase* async_db, IngestSpool* spool)
     : acceptor_(io_context, tcp::endpoint(tcp::v4(), port))
-    , database_(db)
+    , storage_(storage)
+    , async_db_(async_db)
+    , spool_(spool)
 {
     start_accept();
 }
@@ -74,6 +81,14 @@ void TCPServer::handle_read(std::shared_ptr<tcp::socket> socket,
                 sensor_data.light = root["light"].asDouble();
                 sensor_data.area = root["area"].asString();
                 
+                // 超出范围的数字（如 1e999）解析为 inf，这样的读数无法入库，也会污染评分和聚合
+                for (double value : {sensor_data.temperature, sensor_data.humidity, sensor_data.co2,
+                                     sensor_data.pm25, sensor_data.noise, sensor_data.light}) {
+                    if (!std::isfinite(value)) {
+                        throw std::invalid_argument("non-finite reading from " + sensor_data.device_id);
+                    }
+                }
+                
                 // 将字符串转换为 AreaType
                 std::string area_type = root["area_type"].asString();
                 if (area_type == "living") {
@@ -133,18 +148,21 @@ void TCPServer::handle_read(std::shared_ptr<tcp::socket> socket,
                     device->last_heartbeat = time(nullptr);
                     device->status = DeviceStatus::ONLINE;  // 更新设备状态
                     device->location_id = sensor_data.area; // 更新位置信息
-                    device->recent_data.push_back(sensor_data);
-                    // 保持最近数据的数量限制
-                    if (device->recent_data.size() > 100) {  // 保留最近100条数据
-                        device->recent_data.erase(device->recent_data.begin());
-                    }
                     
-                    // 调用设备管理器的数据添加方法
+                    // 由设备管理器缓存最近数据并生成 JSON 片段
                     deviceManager.addSensorData(sensor_data.device_id, sensor_data);
+                    
+                    // 推送给订阅了该设备或区域的客户端
+                    if (auto fragments = std::atomic_load(&device->fragments)) {
+                        PushHub::getInstance().publish(sensor_data.device_id, sensor_data.area, *fragments);
+                    }
                 }
                 
+                // 更新区域和区域类型的持续聚合
+                AreaAggregator::getInstance().update(sensor_data);
+                
                 // 保存数据到数据库
-                Database::getInstance().insertSensorData(sensor_data);
+                storeSensorData(sensor_data);
                 
                 // 发送响应
                 std::string response = "OK\n";
@@ -167,6 +185,43 @@ void TCPServer::handle_read(std::shared_ptr<tcp::socket> socket,
     }
 }
 
+void TCPServer::storeSensorData(const SensorData& data) {
+    // 先进入内存热层，最近的历史查询无需等待入库
+    storage_.hotTier().append(data);
+    storage_.noteIngested(data.timestamp);
+    
+    // 数据库不健康或积压过多时直接写入本地 spool，保证入库延迟有界
+    if (spool_ && (!spool_->databaseHealthy() ||
+                   (async_db_ && async_db_->inFlight() > MAX_ASYNC_IN_FLIGHT))) {
+        spool_->append(data);
+        return;
+    }
+    
+    // 异步写入不阻塞 I/O 线程
+    if (async_db_) {
+        async_db_->asyncInsertSensorData(data, [this, data](bool ok) {
+            if (ok) {
+                if (spool_) {
+                    spool_->reportSuccess();
+                }
+            } else {
+                spoolSensorData(data);
+            }
+        });
+    } else if (!storage_.insertSensorData(data)) {
+        spoolSensorData(data);
+    }
+}
+
+void TCPServer::spoolSensorData(const SensorData& data) {
+    if (!spool_) {
+        std::cerr << "[TCP] Failed to store data for " << data.device_id << std::endl;
+        return;
+    }
+    spool_->reportFailure();
+    spool_->append(data);
+}
+
 EnvironmentScorer::TimeSlot TCPServer::determineTimeSlot(time_t timestamp) {
     // 将时间戳转换为本地时间
     struct tm* lt = localtime(&timestamp);
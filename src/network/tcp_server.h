@@ -4,14 +4,17 @@
 #include <functional>
 #include "../models/sensor_data.h"
 #include "../scoring/environment_scorer.h"
-#include "../database/database.h"
+#include "../database/storage.h"
+#include "../database/async_database.h"
+#include "../database/ingest_spool.h"
 #include "../services/environment_service.h"
 
 using boost::asio::ip::tcp;
 
 class TCPServer {
 public:
-    TCPServer(boost::asio::io_context& io_context, short port, Database& db);
+    TCPServer(boost::asio::io_context& io_context, short port, Storage& storage,
+              AsyncDatabase* async_db = nullptr, IngestSpool* spool = nullptr);
     void start();
 
 private:
@@ -24,10 +27,17 @@ private:
                     const boost::system::error_code& error,
                     size_t bytes_transferred);
     
+    void storeSensorData(const SensorData& data);
+    void spoolSensorData(const SensorData& data);
+    
     EnvironmentScorer::TimeSlot determineTimeSlot(time_t timestamp);
 
     tcp::acceptor acceptor_;
     std::function<void(const SensorData&)> data_callback_;
     EnvironmentService environment_service_;
-    Database& database_;
+    Storage& storage_;
+    AsyncDatabase* async_db_;  // 为空时退回同步写入
+    IngestSpool* spool_;       // 为空时写入失败的数据直接丢弃
+    
+    static constexpr size_t MAX_ASYNC_IN_FLIGHT = 10000;  // 超过后视为数据库过慢，转入 spool
 }; 
\ No newline at end of file
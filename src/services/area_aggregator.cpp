@@ -0,0 +1,151 @@
+#include "area_aggregator.h"
+#include <algorithm>
+
+AreaAggregator& AreaAggregator::getInstance() {
+    static AreaAggregator instance;
+    return instance;
+}
+
+const char* AreaAggregator::areaTypeName(AreaType type) {
+    switch (type) {
+        case AreaType::LIVING:
+            return "living";
+        case AreaType::TEACHING:
+            return "teaching";
+        case AreaType::RECREATION:
+            return "recreation";
+    }
+    return "unknown";
+}
+
+void AreaAggregator::update(const SensorData& data) {
+    Values values = {data.temperature, data.humidity, data.co2, data.pm25,
+                     data.noise, data.light, data.scores.overall};
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 设备换了区域时先从原来的分组中移除
+    auto membership = memberships_.find(data.device_id);
+    if (membership != memberships_.end()) {
+        if (membership->second.area != data.area) {
+            remove(areas_[membership->second.area], data.device_id);
+        }
+        if (membership->second.area_type != data.area_type) {
+            remove(area_types_[areaTypeName(membership->second.area_type)], data.device_id);
+        }
+    }
+    memberships_[data.device_id] = {data.area, data.area_type};
+
+    apply(areas_[data.area], data.device_id, values, data.timestamp);
+    apply(area_types_[areaTypeName(data.area_type)], data.device_id, values, data.timestamp);
+}
+
+void AreaAggregator::remove(Group& group, const std::string& device_id) {
+    auto it = group.latest.find(device_id);
+    if (it == group.latest.end()) {
+        return;
+    }
+    for (int i = 0; i < CHANNELS; ++i) {
+        group.sums[i] -= it->second[i];
+        group.ordered[i].erase(group.ordered[i].find(it->second[i]));
+    }
+    group.latest.erase(it);
+}
+
+void AreaAggregator::apply(Group& group, const std::string& device_id, const Values& values,
+                           time_t timestamp) {
+    // 用新读数替换该设备的旧读数
+    remove(group, device_id);
+    for (int i = 0; i < CHANNELS; ++i) {
+        group.sums[i] += values[i];
+        group.ordered[i].insert(values[i]);
+    }
+    group.latest.emplace(device_id, values);
+    group.updated_at = std::max(group.updated_at, timestamp);
+
+    // 分钟汇总：槽位对应的分钟不同时说明是一天前的旧数据，直接覆盖
+    if (group.minutes.empty()) {
+        group.minutes.resize(MINUTE_SLOTS);
+    }
+    time_t minute = timestamp - timestamp % 60;
+    MinuteRollup& slot = group.minutes[static_cast<size_t>(minute / 60) % MINUTE_SLOTS];
+    if (slot.minute != minute) {
+        if (slot.minute > minute) {
+            return;  // 迟到超过一天的读数不计入分钟汇总
+        }
+        slot.minute = minute;
+        slot.count = 0;
+        for (int i = 0; i < CHANNELS; ++i) {
+            slot.sum[i] = 0;
+            slot.min[i] = values[i];
+            slot.max[i] = values[i];
+        }
+    }
+    ++slot.count;
+    for (int i = 0; i < CHANNELS; ++i) {
+        slot.sum[i] += values[i];
+        slot.min[i] = std::min(slot.min[i], values[i]);
+        slot.max[i] = std::max(slot.max[i], values[i]);
+    }
+}
+
+AreaAggregator::Snapshot AreaAggregator::snapshot(const std::string& key, const Group& group) {
+    Snapshot result;
+    result.key = key;
+    result.devices = group.latest.size();
+    result.updated_at = group.updated_at;
+    for (int i = 0; i < CHANNELS; ++i) {
+        if (group.latest.empty()) {
+            result.current[i] = {0, 0, 0};
+            continue;
+        }
+        result.current[i] = {group.sums[i] / static_cast<double>(group.latest.size()),
+                             *group.ordered[i].begin(), *group.ordered[i].rbegin()};
+    }
+    return result;
+}
+
+bool AreaAggregator::areaSnapshot(const std::string& area, size_t minutes, Snapshot& result,
+                                  std::vector<MinuteRollup>& rollups) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = areas_.find(area);
+    if (it == areas_.end()) {
+        return false;
+    }
+    result = snapshot(area, it->second);
+
+    // 从最近一次更新所在的分钟往前取
+    rollups.clear();
+    minutes = std::min(minutes, MINUTE_SLOTS);
+    time_t last = it->second.updated_at - it->second.updated_at % 60;
+    for (size_t i = minutes; i-- > 0;) {
+        time_t minute = last - static_cast<time_t>(i) * 60;
+        const MinuteRollup& slot = it->second.minutes[static_cast<size_t>(minute / 60) % MINUTE_SLOTS];
+        if (slot.minute == minute) {
+            rollups.push_back(slot);
+        }
+    }
+    return true;
+}
+
+std::vector<AreaAggregator::Snapshot> AreaAggregator::areaSnapshots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Snapshot> result;
+    for (const auto& [area, group] : areas_) {
+        if (!group.latest.empty()) {
+            result.push_back(snapshot(area, group));
+        }
+    }
+    return result;
+}
+
+std::vector<AreaAggregator::Snapshot> AreaAggregator::areaTypeSnapshots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Snapshot> result;
+    for (const auto& [type, group] : area_types_) {
+        if (!group.latest.empty()) {
+            result.push_back(snapshot(type, group));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../models/sensor_data.h"
+
+// 按区域和区域类型持续维护的聚合：
+// - 当前值：每个设备最新读数在各通道上的均值/最小/最大，均值用累加和增量更新，
+//   最小/最大用有序多重集合维护
+// - 分钟汇总：固定大小的环形数组，每分钟一个槽，记录计数、总和、最小和最大
+// 每条读数只更新所属区域和区域类型两组，与设备总数无关
+class AreaAggregator {
+public:
+    static AreaAggregator& getInstance();
+
+    static constexpr int CHANNELS = 7;  // 6 个传感器通道 + 总体评分
+    static constexpr const char* CHANNEL_NAMES[CHANNELS] = {
+        "temperature", "humidity", "co2", "pm25", "noise", "light", "overall"};
+    static constexpr size_t MINUTE_SLOTS = 24 * 60;
+
+    // 读数需已完成评分
+    void update(const SensorData& data);
+
+    struct ChannelStats {
+        double mean;
+        double min;
+        double max;
+    };
+
+    struct Snapshot {
+        std::string key;
+        size_t devices = 0;
+        time_t updated_at = 0;
+        ChannelStats current[CHANNELS];
+    };
+
+    struct MinuteRollup {
+        time_t minute = -1;
+        uint32_t count = 0;
+        double sum[CHANNELS];
+        double min[CHANNELS];
+        double max[CHANNELS];
+    };
+
+    // 单个区域的当前值和最近 minutes 分钟的汇总（按时间升序），区域不存在时返回 false
+    bool areaSnapshot(const std::string& area, size_t minutes, Snapshot& snapshot,
+                      std::vector<MinuteRollup>& rollups) const;
+
+    std::vector<Snapshot> areaSnapshots() const;
+    std::vector<Snapshot> areaTypeSnapshots() const;
+
+    static const char* areaTypeName(AreaType type);
+
+private:
+    AreaAggregator() = default;
+    AreaAggregator(const AreaAggregator&) = delete;
+    AreaAggregator& operator=(const AreaAggregator&) = delete;
+
+    using Values = std::array<double, CHANNELS>;
+
+    struct Group {
+        std::unordered_map<std::string, Values> latest;  // 每个设备的最新读数
+        double sums[CHANNELS] = {};
+        std::multiset<double> ordered[CHANNELS];
+        time_t updated_at = 0;
+        std::vector<MinuteRollup> minutes;
+    };
+
+    static void apply(Group& group, const std::string& device_id, const Values& values,
+                      time_t timestamp);
+    static void remove(Group& group, const std::string& device_id);
+    static Snapshot snapshot(const std::string& key, const Group& group);
+
+    struct Membership {
+        std::string area;
+        AreaType area_type;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Group> areas_;
+    std::map<std::string, Group> area_types_;
+    std::unordered_map<std::string, Membership> memberships_;  // 设备当前所属的区域
+};
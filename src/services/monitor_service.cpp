@@ -1,7 +1,7 @@
 #include "monitor_service.h"
 
-MonitorService::MonitorService(Database& db)
-    : database_(db)
+MonitorService::MonitorService(Storage& storage)
+    : storage_(storage)
 {
 }
 
@@ -10,5 +10,5 @@ void MonitorService::processSensorData(SensorData& data) {
     environment_service_.processEnvironmentData(data);
     
     // 存储数据
-    database_.insertSensorData(data);
+    storage_.insertSensorData(data);
 } 
\ No newline at end of file
@@ -1,14 +1,14 @@
 #pragma once
 #include "../models/sensor_data.h"
-#include "../database/database.h"
+#include "../database/storage.h"
 #include "environment_service.h"
 
 class MonitorService {
 public:
-    MonitorService(Database& db);
+    MonitorService(Storage& storage);
     void processSensorData(SensorData& data);
     
 private:
-    Database& database_;
+    Storage& storage_;
     EnvironmentService environment_service_;
 };
\ No newline at end of file
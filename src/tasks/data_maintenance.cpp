@@ -1,4 +1,41 @@
 #include "data_maintenance.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <vector>
+
+namespace {
+
+const char* HOURLY_TASK = "hourly_aggregate";
+const char* DAILY_TASK = "daily_aggregate";
+
+time_t hourStart(time_t timestamp) {
+    return timestamp - timestamp % 3600;
+}
+
+// 本地自然日的起点，用 mktime 处理夏令时切换
+time_t localDayStart(time_t timestamp) {
+    struct tm tm;
+    localtime_r(&timestamp, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+time_t nextLocalDayStart(time_t day_start) {
+    struct tm tm;
+    localtime_r(&day_start, &tm);
+    tm.tm_mday += 1;
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+} // namespace
 
 DataMaintenanceTask& DataMaintenanceTask::getInstance() {
     static DataMaintenanceTask instance;
@@ -11,33 +48,181 @@ DataMaintenanceTask::~DataMaintenanceTask() {
 
 void DataMaintenanceTask::start() {
     running_ = true;
-    worker_ = std::thread(&DataMaintenanceTask::run, this);
+    // 启动时立即运行一次，补做停机期间错过的窗口
+    boost::asio::post(io_context_, [this]() { runOnce(); });
+    worker_ = std::thread([this]() { io_context_.run(); });
 }
 
 void DataMaintenanceTask::stop() {
     running_ = false;
+    io_context_.stop();
     if (worker_.joinable()) {
         worker_.join();
     }
 }
 
-void DataMaintenanceTask::run() {
-    while (running_) {
-        time_t now = time(nullptr);
-        struct tm* tm = localtime(&now);
-        
-        // 每小时执行一次数据聚合
-        if (tm->tm_min == 0) {
-            Database::getInstance().aggregateHourlyData();
+void DataMaintenanceTask::scheduleAfter(time_t seconds) {
+    timer_.expires_after(std::chrono::seconds(seconds));
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec && running_) {
+            runOnce();
+        }
+    });
+}
+
+void DataMaintenanceTask::runOnce() {
+    Storage& storage = Storage::getInstance();
+    time_t now = time(nullptr);
+    
+    time_t hourly_watermark = 0;
+    bool success = catchUpHourly(storage, now, hourly_watermark) &&
+                   catchUpDaily(storage, now, hourly_watermark) &&
+                   reaggregateLateHours(storage, now);
+    success = storage.sealRawBlocks() && success;
+    success = storage.cleanupOldData() && success;
+    
+    if (!running_) {
+        return;
+    }
+    if (!success) {
+        std::cerr << "[Maintenance] Run failed, retrying in " << RETRY_SECONDS << "s" << std::endl;
+        scheduleAfter(RETRY_SECONDS);
+        return;
+    }
+    
+    // 下一个整点之后再等待 SETTLE_SECONDS
+    now = time(nullptr);
+    time_t next_run = hourStart(now) + 3600 + SETTLE_SECONDS;
+    if (next_run - 3600 > now) {
+        next_run -= 3600;
+    }
+    scheduleAfter(next_run - now);
+}
+
+bool DataMaintenanceTask::catchUpHourly(Storage& storage, time_t now, time_t& hourly_watermark) {
+    time_t watermark = 0;
+    if (!storage.loadWatermark(HOURLY_TASK, watermark)) {
+        return false;
+    }
+    if (watermark == 0) {
+        // 首次运行从上一个完整小时开始
+        watermark = hourStart(now) - 3600;
+    }
+    
+    // 超出实时表保留期的窗口已没有原始数据可聚合
+    time_t earliest = hourStart(now - Storage::REALTIME_DATA_RETENTION_HOURS * 3600) + 3600;
+    if (watermark < earliest) {
+        std::cerr << "[Maintenance] Skipping hourly windows before " << earliest
+                  << ", raw data already expired" << std::endl;
+        watermark = earliest;
+    }
+    
+    storage.setAggregatedUntil(watermark);
+    
+    size_t windows = 0;
+    bool success = true;
+    while (running_ && watermark + 3600 + SETTLE_SECONDS <= now) {
+        // 先推进迟到判定的边界，聚合过程中到达的读数会被标记为脏并在下次运行时补上
+        storage.setAggregatedUntil(watermark + 3600);
+        if (!storage.aggregateHourlyData(watermark, watermark + 3600)) {
+            std::cerr << "[Maintenance] Hourly aggregation failed for window " << watermark << std::endl;
+            success = false;
+            break;
+        }
+        watermark += 3600;
+        ++windows;
+        if (!storage.saveWatermark(HOURLY_TASK, watermark)) {
+            success = false;
+            break;
+        }
+    }
+    if (windows > 1) {
+        std::cout << "[Maintenance] Caught up " << windows << " hourly windows" << std::endl;
+    }
+    
+    hourly_watermark = watermark;
+    return success;
+}
+
+bool DataMaintenanceTask::catchUpDaily(Storage& storage, time_t now, time_t hourly_watermark) {
+    time_t watermark = 0;
+    if (!storage.loadWatermark(DAILY_TASK, watermark)) {
+        return false;
+    }
+    if (watermark == 0) {
+        // 首次运行从昨天开始
+        watermark = localDayStart(localDayStart(now) - 1);
+    }
+    
+    time_t earliest = localDayStart(now - Storage::HOURLY_DATA_RETENTION_DAYS * 24 * 3600);
+    if (watermark < earliest) {
+        std::cerr << "[Maintenance] Skipping daily windows before " << earliest
+                  << ", hourly data already expired" << std::endl;
+        watermark = nextLocalDayStart(earliest);
+    }
+    
+    // 当天的所有小时窗口都聚合完成后才聚合这一天
+    size_t windows = 0;
+    for (time_t day_end = nextLocalDayStart(watermark);
+         running_ && day_end <= hourly_watermark;
+         day_end = nextLocalDayStart(watermark)) {
+        if (!storage.aggregateDailyData(watermark, day_end)) {
+            std::cerr << "[Maintenance] Daily aggregation failed for window " << watermark << std::endl;
+            return false;
+        }
+        watermark = day_end;
+        ++windows;
+        if (!storage.saveWatermark(DAILY_TASK, watermark)) {
+            return false;
+        }
+    }
+    if (windows > 1) {
+        std::cout << "[Maintenance] Caught up " << windows << " daily windows" << std::endl;
+    }
+    return true;
+}
+
+bool DataMaintenanceTask::reaggregateLateHours(Storage& storage, time_t now) {
+    time_t daily_watermark = 0;
+    if (!storage.loadWatermark(DAILY_TASK, daily_watermark)) {
+        return false;
+    }
+    
+    std::vector<time_t> hours = storage.takeDirtyHours(now - SETTLE_SECONDS);
+    time_t earliest = hourStart(now - Storage::REALTIME_DATA_RETENTION_HOURS * 3600);
+    std::set<time_t> days;
+    size_t reaggregated = 0;
+    for (size_t i = 0; i < hours.size(); ++i) {
+        time_t hour = hours[i];
+        // 原始数据已过期的小时无法重新聚合，只重做所在日期
+        if (hour >= earliest) {
+            if (!running_ || !storage.aggregateHourlyData(hour, hour + 3600)) {
+                for (; i < hours.size(); ++i) {
+                    storage.markDirtyHour(hours[i]);
+                }
+                return false;
+            }
+            ++reaggregated;
+        }
+        time_t day = localDayStart(hour);
+        if (day < daily_watermark) {
+            days.insert(day);
         }
-        
-        // 每天凌晨执行一次数据聚合和清理
-        if (tm->tm_hour == 0 && tm->tm_min == 0) {
-            Database::getInstance().aggregateDailyData();
-            Database::getInstance().cleanupOldData();
+    }
+    
+    // 已聚合过的日期用修正后的小时数据重新聚合
+    for (auto it = days.begin(); it != days.end(); ++it) {
+        if (!running_ || !storage.aggregateDailyData(*it, nextLocalDayStart(*it))) {
+            // 标记各日期的第一个小时，下次运行时连同这些日期一起重做
+            for (; it != days.end(); ++it) {
+                storage.markDirtyHour(*it);
+            }
+            return false;
         }
-        
-        // 休眠到下一分钟
-        std::this_thread::sleep_for(std::chrono::seconds(60));
     }
-} 
\ No newline at end of file
+    if (reaggregated > 0) {
+        std::cout << "[Maintenance] Re-aggregated " << reaggregated << " hours and "
+                  << days.size() << " days with late data" << std::endl;
+    }
+    return true;
+}
@@ -1,8 +1,14 @@
 #pragma once
-#include <thread>
 #include <atomic>
-#include "../database/database.h"
+#include <ctime>
+#include <thread>
+#include <boost/asio.hpp>
+#include "../database/storage.h"
 
+// 数据维护任务：在独立线程的 io_context 上用 steady_timer 调度，
+// 每个整点过后等待迟到数据沉淀再执行。小时/每日聚合按持久化的水位逐窗口推进，
+// 进程停机期间错过的窗口在下次运行时补做；已聚合窗口收到迟到数据时只重新聚合受影响的小时和日期。
+// 聚合以 (设备, 桶) 覆盖写入，同一窗口重复执行是幂等的。每次运行还会封存压缩块并清理过期数据。
 class DataMaintenanceTask {
 public:
     static DataMaintenanceTask& getInstance();
@@ -12,8 +18,18 @@ public:
 private:
     DataMaintenanceTask() = default;
     ~DataMaintenanceTask();
-    void run();
     
+    void scheduleAfter(time_t seconds);
+    void runOnce();
+    bool catchUpHourly(Storage& storage, time_t now, time_t& hourly_watermark);
+    bool catchUpDaily(Storage& storage, time_t now, time_t hourly_watermark);
+    bool reaggregateLateHours(Storage& storage, time_t now);
+    
+    boost::asio::io_context io_context_;
+    boost::asio::steady_timer timer_{io_context_};
     std::atomic<bool> running_{false};
     std::thread worker_;
-}; 
\ No newline at end of file
+    
+    static constexpr time_t SETTLE_SECONDS = 300;   // 窗口结束后等待迟到数据的时间
+    static constexpr time_t RETRY_SECONDS = 60;     // 运行失败后的重试间隔
+};
@@ -0,0 +1,224 @@
+#include "ddsketch.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint8_t FORMAT_VERSION = 1;
+constexpr double MIN_INDEXABLE = 1e-9;  // 绝对值更小的数计入零桶
+
+const double GAMMA = (1 + DDSketch::RELATIVE_ACCURACY) / (1 - DDSketch::RELATIVE_ACCURACY);
+const double LOG_GAMMA = std::log(GAMMA);
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool getVarint(const char*& p, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace
+
+int32_t DDSketch::indexOf(double value) {
+    return static_cast<int32_t>(std::ceil(std::log(value) / LOG_GAMMA));
+}
+
+double DDSketch::valueOf(int32_t index) {
+    // 桶 (gamma^(i-1), gamma^i] 的代表值，保证相对误差不超过 alpha
+    return 2 * std::pow(GAMMA, index) / (GAMMA + 1);
+}
+
+void DDSketch::Store::add(int32_t index, uint64_t count) {
+    if (bins.empty()) {
+        offset = index;
+        bins.assign(1, 0);
+    } else if (index < offset) {
+        if (static_cast<size_t>(offset + static_cast<int32_t>(bins.size()) - index) > MAX_BINS) {
+            // 桶数超限：低于保留范围的值计入最低的桶
+            index = std::max(index, offset + static_cast<int32_t>(bins.size()) - static_cast<int32_t>(MAX_BINS));
+        }
+        if (index < offset) {
+            bins.insert(bins.begin(), static_cast<size_t>(offset - index), 0);
+            offset = index;
+        }
+    } else if (index >= offset + static_cast<int32_t>(bins.size())) {
+        size_t size = static_cast<size_t>(index - offset) + 1;
+        if (size > MAX_BINS) {
+            // 向高处扩展时把最低的桶折叠进新的最低桶
+            size_t drop = size - MAX_BINS;
+            uint64_t folded = 0;
+            for (size_t i = 0; i < std::min(drop, bins.size()); ++i) {
+                folded += bins[i];
+            }
+            bins.erase(bins.begin(), bins.begin() + static_cast<long>(std::min(drop, bins.size())));
+            offset += static_cast<int32_t>(drop);
+            if (bins.empty()) {
+                bins.assign(1, 0);
+            }
+            bins[0] += folded;
+            size = MAX_BINS;
+        }
+        bins.resize(size, 0);
+    }
+    bins[static_cast<size_t>(index - offset)] += count;
+    total += count;
+}
+
+void DDSketch::Store::merge(const Store& other) {
+    for (size_t i = 0; i < other.bins.size(); ++i) {
+        if (other.bins[i]) {
+            add(other.offset + static_cast<int32_t>(i), other.bins[i]);
+        }
+    }
+}
+
+int32_t DDSketch::Store::indexOfRank(uint64_t rank, bool ascending) const {
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bins.size(); ++i) {
+        size_t pos = ascending ? i : bins.size() - 1 - i;
+        seen += bins[pos];
+        if (seen > rank) {
+            return offset + static_cast<int32_t>(pos);
+        }
+    }
+    return offset + static_cast<int32_t>(ascending ? bins.size() - 1 : 0);
+}
+
+void DDSketch::add(double value, uint64_t count) {
+    if (std::isnan(value) || count == 0) {
+        return;
+    }
+    if (value > MIN_INDEXABLE) {
+        positive_.add(indexOf(value), count);
+    } else if (value < -MIN_INDEXABLE) {
+        negative_.add(indexOf(-value), count);
+    } else {
+        zero_count_ += count;
+    }
+}
+
+void DDSketch::merge(const DDSketch& other) {
+    positive_.merge(other.positive_);
+    negative_.merge(other.negative_);
+    zero_count_ += other.zero_count_;
+}
+
+double DDSketch::quantile(double q) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    q = std::min(1.0, std::max(0.0, q));
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1));
+
+    // 负值从绝对值最大的桶开始计数
+    if (rank < negative_.total) {
+        return -valueOf(negative_.indexOfRank(rank, false));
+    }
+    rank -= negative_.total;
+    if (rank < zero_count_) {
+        return 0;
+    }
+    return valueOf(positive_.indexOfRank(rank - zero_count_, true));
+}
+
+// 格式：varint 零桶计数，随后正负两个存储各为
+// [varint 非空桶数][每个非空桶：zigzag varint 索引差值, varint 计数]
+void DDSketch::serialize(std::string& out) const {
+    putVarint(out, zero_count_);
+    for (const Store* store : {&positive_, &negative_}) {
+        size_t nonzero = static_cast<size_t>(std::count_if(store->bins.begin(), store->bins.end(),
+                                                           [](uint64_t n) { return n != 0; }));
+        putVarint(out, nonzero);
+        int64_t prev = 0;
+        for (size_t i = 0; i < store->bins.size(); ++i) {
+            if (!store->bins[i]) {
+                continue;
+            }
+            int64_t index = store->offset + static_cast<int64_t>(i);
+            putVarint(out, zigzag(index - prev));
+            putVarint(out, store->bins[i]);
+            prev = index;
+        }
+    }
+}
+
+bool DDSketch::deserialize(const char*& data, const char* end) {
+    *this = DDSketch();
+    if (!getVarint(data, end, zero_count_)) {
+        return false;
+    }
+    for (Store* store : {&positive_, &negative_}) {
+        uint64_t nonzero;
+        if (!getVarint(data, end, nonzero)) {
+            return false;
+        }
+        int64_t index = 0;
+        for (uint64_t i = 0; i < nonzero; ++i) {
+            uint64_t delta, count;
+            if (!getVarint(data, end, delta) || !getVarint(data, end, count)) {
+                return false;
+            }
+            index += unzigzag(delta);
+            store->add(static_cast<int32_t>(index), count);
+        }
+    }
+    return true;
+}
+
+void ChannelSketches::add(const SensorData& data) {
+    double values[CHANNELS] = {data.temperature, data.humidity, data.co2,
+                               data.pm25, data.noise, data.light};
+    for (int i = 0; i < CHANNELS; ++i) {
+        channels[i].add(values[i]);
+    }
+}
+
+void ChannelSketches::merge(const ChannelSketches& other) {
+    for (int i = 0; i < CHANNELS; ++i) {
+        channels[i].merge(other.channels[i]);
+    }
+}
+
+std::string ChannelSketches::serialize() const {
+    std::string out;
+    out += static_cast<char>(FORMAT_VERSION);
+    for (const auto& sketch : channels) {
+        sketch.serialize(out);
+    }
+    return out;
+}
+
+bool ChannelSketches::deserialize(const char* data, size_t size) {
+    const char* end = data + size;
+    if (size == 0 || static_cast<uint8_t>(*data++) != FORMAT_VERSION) {
+        return false;
+    }
+    for (auto& sketch : channels) {
+        if (!sketch.deserialize(data, end)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../models/sensor_data.h"
+
+// DDSketch 分位数草图：按对数间隔分桶，分位数估计的相对误差不超过 RELATIVE_ACCURACY。
+// 两个草图相加即为合并，因此小时草图可以直接合并为每日草图或任意时间范围的草图。
+class DDSketch {
+public:
+    static constexpr double RELATIVE_ACCURACY = 0.01;
+    static constexpr size_t MAX_BINS = 2048;  // 超出时合并最低的桶，只影响极小分位数
+
+    void add(double value, uint64_t count = 1);
+    void merge(const DDSketch& other);
+
+    // q 取值 [0, 1]，空草图返回 0
+    double quantile(double q) const;
+
+    uint64_t count() const { return zero_count_ + positive_.total + negative_.total; }
+    bool empty() const { return count() == 0; }
+
+    void serialize(std::string& out) const;
+    // 从 data 读取一个草图并前移 data，数据损坏时返回 false
+    bool deserialize(const char*& data, const char* end);
+
+private:
+    // 连续桶存储：bins[i] 对应索引 offset + i
+    struct Store {
+        std::vector<uint64_t> bins;
+        int32_t offset = 0;
+        uint64_t total = 0;
+
+        void add(int32_t index, uint64_t count);
+        void merge(const Store& other);
+        // 第 rank 个值（从 0 开始）所在的桶索引，ascending 为 false 时从高到低计数
+        int32_t indexOfRank(uint64_t rank, bool ascending) const;
+    };
+
+    static int32_t indexOf(double value);
+    static double valueOf(int32_t index);
+
+    Store positive_;
+    Store negative_;       // 负值按绝对值存储
+    uint64_t zero_count_ = 0;
+};
+
+// 6 个传感器通道各一个草图，序列化后存入聚合表的 sketches 列
+struct ChannelSketches {
+    static constexpr int CHANNELS = 6;
+    static constexpr const char* CHANNEL_NAMES[CHANNELS] = {
+        "temperature", "humidity", "co2", "pm25", "noise", "light"};
+
+    DDSketch channels[CHANNELS];
+
+    void add(const SensorData& data);
+    void merge(const ChannelSketches& other);
+    bool empty() const { return channels[0].empty(); }
+
+    std::string serialize() const;
+    bool deserialize(const char* data, size_t size);
+};
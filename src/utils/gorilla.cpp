@@ -0,0 +1,239 @@
+#include "gorilla.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 4;  // u32 行数
+
+uint64_t toBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// 截取有符号数的低 nbits 位补码
+uint64_t truncateBits(int64_t value, int nbits) {
+    return static_cast<uint64_t>(value) & ((nbits == 64) ? ~0ULL : ((1ULL << nbits) - 1));
+}
+
+int64_t signExtend(uint64_t value, int nbits) {
+    if (nbits == 64) {
+        return static_cast<int64_t>(value);
+    }
+    uint64_t sign = 1ULL << (nbits - 1);
+    return static_cast<int64_t>((value ^ sign) - sign);
+}
+
+} // namespace
+
+void GorillaEncoder::writeBits(uint64_t value, int nbits) {
+    // 按高位在前逐字节写出
+    while (nbits > 0) {
+        int take = std::min(nbits, 8 - acc_bits_);
+        uint64_t chunk = (value >> (nbits - take)) & ((1ULL << take) - 1);
+        acc_ = (acc_ << take) | chunk;
+        acc_bits_ += take;
+        nbits -= take;
+        if (acc_bits_ == 8) {
+            bits_ += static_cast<char>(acc_);
+            acc_ = 0;
+            acc_bits_ = 0;
+        }
+    }
+}
+
+void GorillaEncoder::append(int64_t timestamp, const double values[CHANNELS]) {
+    if (count_ == 0) {
+        first_ts_ = timestamp;
+        writeBits(static_cast<uint64_t>(timestamp), 64);
+        for (int i = 0; i < CHANNELS; ++i) {
+            prev_values_[i] = toBits(values[i]);
+            prev_leading_[i] = -1;
+            writeBits(prev_values_[i], 64);
+        }
+    } else {
+        int64_t delta = timestamp - prev_ts_;
+        int64_t dod = delta - prev_delta_;
+        if (dod == 0) {
+            writeBits(0b0, 1);
+        } else if (dod >= -64 && dod <= 63) {
+            writeBits(0b10, 2);
+            writeBits(truncateBits(dod, 7), 7);
+        } else if (dod >= -256 && dod <= 255) {
+            writeBits(0b110, 3);
+            writeBits(truncateBits(dod, 9), 9);
+        } else if (dod >= -2048 && dod <= 2047) {
+            writeBits(0b1110, 4);
+            writeBits(truncateBits(dod, 12), 12);
+        } else {
+            writeBits(0b1111, 4);
+            writeBits(static_cast<uint64_t>(dod), 64);
+        }
+        prev_delta_ = delta;
+        for (int i = 0; i < CHANNELS; ++i) {
+            writeValue(i, values[i]);
+        }
+    }
+    prev_ts_ = timestamp;
+    ++count_;
+}
+
+void GorillaEncoder::writeValue(int channel, double value) {
+    uint64_t bits = toBits(value);
+    uint64_t x = bits ^ prev_values_[channel];
+    prev_values_[channel] = bits;
+
+    if (x == 0) {
+        writeBits(0b0, 1);
+        return;
+    }
+
+    int leading = __builtin_clzll(x);
+    int trailing = __builtin_ctzll(x);
+    if (leading > 31) {
+        leading = 31;  // 前导零个数用 5 位保存
+    }
+
+    // 有效位落在上一个窗口内时复用窗口，省去窗口描述
+    if (prev_leading_[channel] >= 0 && leading >= prev_leading_[channel] &&
+        trailing >= prev_trailing_[channel]) {
+        int meaningful = 64 - prev_leading_[channel] - prev_trailing_[channel];
+        writeBits(0b10, 2);
+        writeBits(x >> prev_trailing_[channel], meaningful);
+        return;
+    }
+
+    int meaningful = 64 - leading - trailing;
+    writeBits(0b11, 2);
+    writeBits(static_cast<uint64_t>(leading), 5);
+    writeBits(static_cast<uint64_t>(meaningful - 1), 6);
+    writeBits(x >> trailing, meaningful);
+    prev_leading_[channel] = leading;
+    prev_trailing_[channel] = trailing;
+}
+
+std::string GorillaEncoder::finish() {
+    std::string out(HEADER_SIZE, '\0');
+    std::memcpy(out.data(), &count_, sizeof(count_));
+    out += bits_;
+    // 最后不足一个字节的部分低位补零
+    if (acc_bits_ > 0) {
+        out += static_cast<char>(acc_ << (8 - acc_bits_));
+    }
+
+    *this = GorillaEncoder();
+    return out;
+}
+
+GorillaDecoder::GorillaDecoder(const char* data, size_t size)
+    : data_(reinterpret_cast<const unsigned char*>(data))
+    , size_(size) {
+    if (size_ >= HEADER_SIZE) {
+        std::memcpy(&count_, data_, sizeof(count_));
+        bit_pos_ = HEADER_SIZE * 8;
+    }
+}
+
+bool GorillaDecoder::readBits(int nbits, uint64_t& value) {
+    if (bit_pos_ + nbits > size_ * 8) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < nbits; ++i) {
+        unsigned char byte = data_[bit_pos_ >> 3];
+        value = (value << 1) | ((byte >> (7 - (bit_pos_ & 7))) & 1);
+        ++bit_pos_;
+    }
+    return true;
+}
+
+bool GorillaDecoder::readValue(int channel, double& value) {
+    uint64_t control;
+    if (!readBits(1, control)) {
+        return false;
+    }
+    if (control == 0) {
+        value = fromBits(prev_values_[channel]);
+        return true;
+    }
+
+    if (!readBits(1, control)) {
+        return false;
+    }
+    if (control == 1) {
+        uint64_t leading, meaningful_minus_one;
+        if (!readBits(5, leading) || !readBits(6, meaningful_minus_one)) {
+            return false;
+        }
+        prev_leading_[channel] = static_cast<int>(leading);
+        prev_trailing_[channel] = 64 - static_cast<int>(leading) - static_cast<int>(meaningful_minus_one + 1);
+    }
+
+    int meaningful = 64 - prev_leading_[channel] - prev_trailing_[channel];
+    uint64_t x;
+    if (meaningful <= 0 || !readBits(meaningful, x)) {
+        return false;
+    }
+    prev_values_[channel] ^= x << prev_trailing_[channel];
+    value = fromBits(prev_values_[channel]);
+    return true;
+}
+
+bool GorillaDecoder::next(int64_t& timestamp, double values[CHANNELS]) {
+    if (index_ >= count_) {
+        return false;
+    }
+
+    uint64_t raw;
+    if (index_ == 0) {
+        if (!readBits(64, raw)) {
+            return false;
+        }
+        prev_ts_ = static_cast<int64_t>(raw);
+        for (int i = 0; i < CHANNELS; ++i) {
+            if (!readBits(64, prev_values_[i])) {
+                return false;
+            }
+            values[i] = fromBits(prev_values_[i]);
+        }
+    } else {
+        // 按前缀 0 / 10 / 110 / 1110 / 1111 解析 delta-of-delta
+        int ones = 0;
+        uint64_t bit;
+        while (ones < 4) {
+            if (!readBits(1, bit)) {
+                return false;
+            }
+            if (bit == 0) {
+                break;
+            }
+            ++ones;
+        }
+        static const int WIDTHS[] = {0, 7, 9, 12, 64};
+        int64_t dod = 0;
+        if (ones > 0) {
+            if (!readBits(WIDTHS[ones], raw)) {
+                return false;
+            }
+            dod = signExtend(raw, WIDTHS[ones]);
+        }
+        prev_delta_ += dod;
+        prev_ts_ += prev_delta_;
+        for (int i = 0; i < CHANNELS; ++i) {
+            if (!readValue(i, values[i])) {
+                return false;
+            }
+        }
+    }
+
+    timestamp = prev_ts_;
+    ++index_;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Gorilla 风格的时间序列块压缩：
+// 时间戳使用 delta-of-delta 编码，6 个通道的浮点值分别与上一值异或后只保存有效位。
+// 逐行交错写入同一个位流，解码时可以逐行读取，无需展开整个块。
+class GorillaEncoder {
+public:
+    static constexpr int CHANNELS = 6;
+
+    void append(int64_t timestamp, const double values[CHANNELS]);
+
+    // 结束编码并返回块内容，编码器随后可复用
+    std::string finish();
+
+    uint32_t count() const { return count_; }
+    int64_t firstTimestamp() const { return first_ts_; }
+    int64_t lastTimestamp() const { return prev_ts_; }
+
+private:
+    void writeBits(uint64_t value, int nbits);
+    void writeValue(int channel, double value);
+
+    std::string bits_;
+    uint64_t acc_ = 0;
+    int acc_bits_ = 0;
+
+    uint32_t count_ = 0;
+    int64_t first_ts_ = 0;
+    int64_t prev_ts_ = 0;
+    int64_t prev_delta_ = 0;
+    uint64_t prev_values_[CHANNELS] = {};
+    int prev_leading_[CHANNELS] = {};
+    int prev_trailing_[CHANNELS] = {};
+};
+
+class GorillaDecoder {
+public:
+    static constexpr int CHANNELS = GorillaEncoder::CHANNELS;
+
+    // data 在解码期间必须保持有效
+    GorillaDecoder(const char* data, size_t size);
+
+    // 读取下一行，块结束或数据损坏时返回 false
+    bool next(int64_t& timestamp, double values[CHANNELS]);
+
+    uint32_t count() const { return count_; }
+
+private:
+    bool readBits(int nbits, uint64_t& value);
+    bool readValue(int channel, double& value);
+
+    const unsigned char* data_;
+    size_t size_;
+    size_t bit_pos_ = 0;
+
+    uint32_t count_ = 0;
+    uint32_t index_ = 0;
+    int64_t prev_ts_ = 0;
+    int64_t prev_delta_ = 0;
+    uint64_t prev_values_[CHANNELS] = {};
+    int prev_leading_[CHANNELS] = {};
+    int prev_trailing_[CHANNELS] = {};
+};
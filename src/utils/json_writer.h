@@ -0,0 +1,136 @@
+#pragma once
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// 流式 JSON 写入器，直接追加到调用方提供的缓冲区（通常是复用的响应体），
+// 不构建中间的 JSON 树。逗号由写入器根据嵌套层次自动插入；
+// 数字用 std::to_chars 格式化（最短可往返表示），非有限浮点数输出 null；
+// 字符串按 UTF-8 原样输出，只转义引号、反斜杠和控制字符。
+//
+//   JsonWriter json(response.body());
+//   json.beginObject();
+//   json.member("device_id", id).member("temperature", 22.5);
+//   json.key("scores").beginObject() ... .endObject();
+//   json.endObject();
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    JsonWriter& beginObject() { return open('{'); }
+    JsonWriter& endObject() { return close('}'); }
+    JsonWriter& beginArray() { return open('['); }
+    JsonWriter& endArray() { return close(']'); }
+
+    JsonWriter& key(std::string_view name) {
+        separate();
+        appendString(out_, name);
+        out_ += ':';
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter& value(double number) { separate(); appendNumber(out_, number); return *this; }
+    JsonWriter& value(int number) { return value(static_cast<long long>(number)); }
+    JsonWriter& value(long number) { return value(static_cast<long long>(number)); }
+    JsonWriter& value(long long number) { separate(); appendNumber(out_, number); return *this; }
+    JsonWriter& value(unsigned number) { return value(static_cast<unsigned long long>(number)); }
+    JsonWriter& value(unsigned long number) { return value(static_cast<unsigned long long>(number)); }
+    JsonWriter& value(unsigned long long number) { separate(); appendNumber(out_, number); return *this; }
+    JsonWriter& value(bool flag) { separate(); out_ += flag ? "true" : "false"; return *this; }
+    JsonWriter& value(std::string_view text) { separate(); appendString(out_, text); return *this; }
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(const std::string& text) { return value(std::string_view(text)); }
+    JsonWriter& null() { separate(); out_ += "null"; return *this; }
+
+    // 写入已经序列化好的 JSON 片段，作为一个值处理
+    JsonWriter& raw(std::string_view json) { separate(); out_ += json; return *this; }
+
+    template <typename T>
+    JsonWriter& member(std::string_view name, const T& v) {
+        key(name);
+        return value(v);
+    }
+
+    static void appendNumber(std::string& out, double value) {
+        if (!std::isfinite(value)) {
+            out += "null";
+            return;
+        }
+        char buf[32];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr);
+    }
+
+    static void appendNumber(std::string& out, long long value) {
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr);
+    }
+
+    static void appendNumber(std::string& out, unsigned long long value) {
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr);
+    }
+
+    static void appendString(std::string& out, std::string_view value) {
+        out += '"';
+        size_t plain = 0;  // 连续无需转义的字节整段追加
+        for (size_t i = 0; i < value.size(); ++i) {
+            char c = value[i];
+            if (c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20) {
+                continue;
+            }
+            out.append(value.data() + plain, i - plain);
+            plain = i + 1;
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+        }
+        out.append(value.data() + plain, value.size() - plain);
+        out += '"';
+    }
+
+private:
+    // 同一容器中第二个及以后的元素前插入逗号，紧跟在键之后的值除外
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ > 0 && (has_items_ >> (depth_ - 1) & 1)) {
+            out_ += ',';
+        }
+        if (depth_ > 0) {
+            has_items_ |= uint64_t(1) << (depth_ - 1);
+        }
+    }
+
+    JsonWriter& open(char bracket) {
+        separate();
+        out_ += bracket;
+        ++depth_;
+        has_items_ &= ~(uint64_t(1) << (depth_ - 1));
+        return *this;
+    }
+
+    JsonWriter& close(char bracket) {
+        out_ += bracket;
+        --depth_;
+        return *this;
+    }
+
+    std::string& out_;
+    uint64_t has_items_ = 0;  // 每层容器是否已有元素，按位记录，最多 64 层嵌套
+    int depth_ = 0;
+    bool after_key_ = false;
+};
@@ -0,0 +1,920 @@
+// 历史数据批量导入工具
+//
+// 读取 JSON Lines 或 CSV 文件，多线程并行解析，自行计算小时和每日聚合（含分位数草图）后
+// 用多行预处理语句批量写入，不经过 8888 端口，也不依赖服务端的 aggregateHourlyData 重新扫描：
+// - 实时表保留期内的原始数据写入 sensor_data_realtime，更早的按设备每小时编码为压缩块
+// - 小时数据写入 sensor_data_hourly，每日数据由小时数据合并后写入 sensor_data_daily
+//
+// 输入需大致按时间排序：一个小时在读到的最大时间戳超过其结束时间 --lateness 秒后封闭并写入，
+// 之后到达的该小时数据视为迟到数据丢弃并计数。聚合表按 (设备, 桶) 唯一，
+// 与服务端已聚合的桶重叠时以导入结果覆盖。
+// 每批写入成功后更新检查点，中断后以相同参数重新运行即从检查点继续；
+// 压缩块和聚合行重复写入是幂等的，实时表的原始数据每批在一个事务内写入，
+// 只有在该事务提交后、检查点更新前被中断时才会重复写入。
+// 导入完成后需重启 monitor 以清空其结果缓存中的旧数据。
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <jsoncpp/json/json.h>
+#include "../src/database/mysql_connection.h"
+#include "../src/utils/ddsketch.h"
+#include "../src/utils/gorilla.h"
+
+namespace {
+
+constexpr size_t CHUNK_BYTES = 4 << 20;          // 每个解析任务读取的字节数
+constexpr size_t INSERT_BATCH_ROWS = 500;        // 多行 INSERT 每条语句的最大行数
+constexpr size_t BATCH_SIZES[] = {INSERT_BATCH_ROWS, 100, 20, 5, 1};
+constexpr time_t HOUR_SECONDS = 3600;
+constexpr int REALTIME_RETENTION_HOURS = 24;     // 与 Storage::REALTIME_DATA_RETENTION_HOURS 一致
+constexpr time_t NEVER = std::numeric_limits<time_t>::max();
+
+struct Options {
+    ConnectionInfo db{"localhost", "monitor", "123456", "evm_db"};
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    time_t lateness = HOUR_SECONDS;
+    std::string checkpoint = "bulk_import.checkpoint";
+    std::string format = "auto";
+    std::vector<std::string> files;
+};
+
+// 解析后的一行输入
+struct InputRow {
+    std::string device_id;
+    int64_t timestamp = 0;
+    double values[6] = {};  // temperature, humidity, co2, pm25, noise, light
+    std::string area;
+    int area_type = 1;
+};
+
+// ---------- 解析 ----------
+
+enum class Format { JSONL, CSV };
+
+const char* CHANNEL_COLUMNS[6] = {"temperature", "humidity", "co2", "pm25", "noise", "light"};
+
+int parseAreaType(const std::string& value) {
+    if (value == "living" || value == "0") {
+        return 0;
+    }
+    if (value == "recreation" || value == "2") {
+        return 2;
+    }
+    return 1;  // teaching，与 TCP 接收端的默认值一致
+}
+
+// CSV 表头中各列的位置，缺失的列为 -1
+struct CsvColumns {
+    int device_id = -1;
+    int timestamp = -1;
+    int values[6] = {-1, -1, -1, -1, -1, -1};
+    int area = -1;
+    int area_type = -1;
+
+    bool parse(const std::string& header) {
+        std::istringstream iss(header);
+        std::string name;
+        for (int index = 0; std::getline(iss, name, ','); ++index) {
+            if (!name.empty() && name.back() == '\r') {
+                name.pop_back();
+            }
+            if (name == "device_id") {
+                device_id = index;
+            } else if (name == "timestamp") {
+                timestamp = index;
+            } else if (name == "area") {
+                area = index;
+            } else if (name == "area_type") {
+                area_type = index;
+            }
+            for (int i = 0; i < 6; ++i) {
+                if (name == CHANNEL_COLUMNS[i]) {
+                    values[i] = index;
+                }
+            }
+        }
+        return device_id >= 0 && timestamp >= 0;
+    }
+};
+
+bool parseCsvLine(const std::string& line, const CsvColumns& columns, std::vector<std::string>& fields,
+                  InputRow& row) {
+    fields.clear();
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(line.substr(start, comma - start));
+        if (comma == std::string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    if (!fields.empty() && !fields.back().empty() && fields.back().back() == '\r') {
+        fields.back().pop_back();
+    }
+
+    auto field = [&](int index) -> const std::string* {
+        return index >= 0 && static_cast<size_t>(index) < fields.size() ? &fields[index] : nullptr;
+    };
+    // 字段数少于表头的截断行计为解析错误
+    const std::string* device_id = field(columns.device_id);
+    const std::string* timestamp = field(columns.timestamp);
+    if (!device_id || !timestamp) {
+        return false;
+    }
+    try {
+        row.device_id = *device_id;
+        row.timestamp = std::stoll(*timestamp);
+        for (int i = 0; i < 6; ++i) {
+            const std::string* value = field(columns.values[i]);
+            row.values[i] = value && !value->empty() ? std::stod(*value) : 0.0;
+        }
+        const std::string* area = field(columns.area);
+        row.area = area ? *area : "";
+        const std::string* area_type = field(columns.area_type);
+        row.area_type = parseAreaType(area_type ? *area_type : "");
+    } catch (const std::exception&) {
+        return false;
+    }
+    return !row.device_id.empty();
+}
+
+bool parseJsonLine(const std::string& line, Json::CharReader& reader, InputRow& row) {
+    Json::Value root;
+    if (!reader.parse(line.data(), line.data() + line.size(), &root, nullptr) || !root.isObject()) {
+        return false;
+    }
+    row.device_id = root["device_id"].asString();
+    row.timestamp = root["timestamp"].asInt64();
+    for (int i = 0; i < 6; ++i) {
+        row.values[i] = root[CHANNEL_COLUMNS[i]].asDouble();
+    }
+    row.area = root["area"].asString();
+    const Json::Value& area_type = root["area_type"];
+    row.area_type = parseAreaType(area_type.isNumeric() ? std::to_string(area_type.asInt())
+                                                        : area_type.asString());
+    return !row.device_id.empty();
+}
+
+struct ParsedChunk {
+    std::vector<InputRow> rows;
+    size_t errors = 0;
+};
+
+ParsedChunk parseChunk(const std::string& text, Format format, const CsvColumns& columns) {
+    ParsedChunk result;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::vector<std::string> fields;
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+        if (line.empty() || line == "\r") {
+            continue;
+        }
+
+        InputRow row;
+        bool ok = format == Format::CSV ? parseCsvLine(line, columns, fields, row)
+                                        : parseJsonLine(line, *reader, row);
+        // stod 接受 nan/inf，JSON 中超出范围的数字解析为 inf，这样的读数无法入库也无法计入草图
+        ok = ok && std::all_of(std::begin(row.values), std::end(row.values),
+                               [](double value) { return std::isfinite(value); });
+        if (ok) {
+            result.rows.push_back(std::move(row));
+        } else {
+            ++result.errors;
+        }
+    }
+    return result;
+}
+
+// ---------- 聚合 ----------
+
+time_t localDayStart(time_t timestamp) {
+    struct tm tm;
+    localtime_r(&timestamp, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+time_t nextLocalMidnight(time_t day_start) {
+    struct tm tm;
+    localtime_r(&day_start, &tm);
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_mday += 1;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+struct Reading {
+    int64_t timestamp;
+    double values[6];
+};
+
+// 某设备某小时尚未封闭的原始数据
+struct HourBucket {
+    std::string area;
+    int area_type = 1;
+    std::vector<Reading> readings;
+};
+
+// 某设备某天已封闭小时的聚合，计算方式与服务端的每日聚合一致（小时均值的均值）
+struct DayAccumulator {
+    std::string area;
+    int area_type = 1;
+    double sum_of_hourly_avg[6] = {};
+    int hours = 0;
+    double max_temperature = -std::numeric_limits<double>::infinity();
+    double min_temperature = std::numeric_limits<double>::infinity();
+    int samples = 0;
+    ChannelSketches sketches;
+};
+
+// ---------- 写入 ----------
+
+struct RawRow {
+    std::string device_id;
+    long long timestamp;
+    double values[6];
+    std::string area;
+    int area_type;
+
+    static constexpr int COLUMNS = 10;
+
+    void bind(MYSQL_BIND* binds) {
+        bindString(binds[0], device_id);
+        bindLongLong(binds[1], &timestamp);
+        for (int i = 0; i < 6; ++i) {
+            bindDouble(binds[2 + i], &values[i]);
+        }
+        bindString(binds[8], area);
+        bindInt(binds[9], &area_type);
+    }
+};
+
+struct BlockRow {
+    std::string device_id;
+    long long start_timestamp;
+    long long end_timestamp;
+    int samples_count;
+    std::string area;
+    int area_type;
+    std::string payload;
+
+    static constexpr int COLUMNS = 7;
+
+    void bind(MYSQL_BIND* binds) {
+        bindString(binds[0], device_id);
+        bindLongLong(binds[1], &start_timestamp);
+        bindLongLong(binds[2], &end_timestamp);
+        bindInt(binds[3], &samples_count);
+        bindString(binds[4], area);
+        bindInt(binds[5], &area_type);
+        bindString(binds[6], payload);
+        binds[6].buffer_type = MYSQL_TYPE_BLOB;
+    }
+};
+
+struct AggregateRow {
+    std::string device_id;
+    long long bucket;
+    double averages[6];
+    double max_temperature;
+    double min_temperature;
+    int samples_count;
+    std::string area;
+    int area_type;
+    std::string sketches;
+
+    static constexpr int COLUMNS = 14;
+
+    void bind(MYSQL_BIND* binds) {
+        bindString(binds[0], device_id);
+        bindLongLong(binds[1], &bucket);
+        for (int i = 0; i < 6; ++i) {
+            bindDouble(binds[2 + i], &averages[i]);
+        }
+        bindDouble(binds[8], &max_temperature);
+        bindDouble(binds[9], &min_temperature);
+        bindInt(binds[10], &samples_count);
+        bindString(binds[11], area);
+        bindInt(binds[12], &area_type);
+        bindString(binds[13], sketches);
+        binds[13].buffer_type = MYSQL_TYPE_BLOB;
+    }
+};
+
+const char* INSERT_REALTIME_PREFIX =
+    "INSERT INTO sensor_data_realtime "
+    "(device_id, timestamp, temperature, humidity, co2, pm25, noise, light, area, area_type) VALUES ";
+const char* REALTIME_VALUES = "(?, FROM_UNIXTIME(?), ?, ?, ?, ?, ?, ?, ?, ?)";
+
+// 已有同一设备同一小时的块（例如服务端已封存）时保留原有的块
+const char* INSERT_BLOCK_PREFIX =
+    "INSERT IGNORE INTO sensor_data_blocks "
+    "(device_id, start_timestamp, end_timestamp, samples_count, area, area_type, payload) VALUES ";
+const char* BLOCK_VALUES = "(?, ?, ?, ?, ?, ?, ?)";
+
+const char* INSERT_HOURLY_PREFIX =
+    "INSERT INTO sensor_data_hourly "
+    "(device_id, hour_timestamp, avg_temperature, avg_humidity, avg_co2, avg_pm25, avg_noise, "
+    "avg_light, max_temperature, min_temperature, samples_count, area, area_type, sketches) VALUES ";
+const char* INSERT_DAILY_PREFIX =
+    "INSERT INTO sensor_data_daily "
+    "(device_id, date_timestamp, avg_temperature, avg_humidity, avg_co2, avg_pm25, avg_noise, "
+    "avg_light, max_temperature, min_temperature, samples_count, area, area_type, sketches) VALUES ";
+const char* AGGREGATE_VALUES = "(?, FROM_UNIXTIME(?), ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+// 聚合表按 (设备, 桶) 唯一，服务端已聚合过的桶以导入结果为准
+const char* AGGREGATE_UPSERT =
+    " ON DUPLICATE KEY UPDATE "
+    "avg_temperature = VALUES(avg_temperature), avg_humidity = VALUES(avg_humidity), "
+    "avg_co2 = VALUES(avg_co2), avg_pm25 = VALUES(avg_pm25), "
+    "avg_noise = VALUES(avg_noise), avg_light = VALUES(avg_light), "
+    "max_temperature = VALUES(max_temperature), min_temperature = VALUES(min_temperature), "
+    "samples_count = VALUES(samples_count), area = VALUES(area), area_type = VALUES(area_type), "
+    "sketches = VALUES(sketches)";
+
+std::string multiRowSql(const char* prefix, const char* values, size_t rows, const char* suffix) {
+    std::string sql(prefix);
+    for (size_t i = 0; i < rows; ++i) {
+        if (i > 0) {
+            sql += ", ";
+        }
+        sql += values;
+    }
+    return sql + suffix;
+}
+
+// 多行 INSERT 只使用这几种行数，剩余不足一批的部分按从大到小拆分，
+// 每个连接上每种语句最多缓存 5 条。affected 累加受影响的行数
+template <typename Row>
+bool insertRows(MySQLConnection& conn, const char* prefix, const char* values,
+                std::vector<Row*>& rows, size_t& affected, const char* suffix = "") {
+    std::vector<MYSQL_BIND> binds(INSERT_BATCH_ROWS * Row::COLUMNS);
+    size_t offset = 0;
+    while (offset < rows.size()) {
+        size_t count = 1;
+        for (size_t size : BATCH_SIZES) {
+            if (rows.size() - offset >= size) {
+                count = size;
+                break;
+            }
+        }
+        MYSQL_STMT* stmt = conn.statement(multiRowSql(prefix, values, count, suffix));
+        if (!stmt) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            rows[offset + i]->bind(&binds[i * Row::COLUMNS]);
+        }
+        if (mysql_stmt_bind_param(stmt, binds.data()) || mysql_stmt_execute(stmt)) {
+            conn.checkError(stmt);
+            return false;
+        }
+        // 覆盖已有行时受影响行数按 2 计，统计按实际写入的行数
+        affected += std::min<size_t>(mysql_stmt_affected_rows(stmt), count);
+        offset += count;
+    }
+    return true;
+}
+
+// 一次封闭产生的全部写入
+struct WriteSet {
+    std::vector<RawRow> realtime;
+    std::vector<BlockRow> blocks;
+    std::vector<AggregateRow> hourly;
+    std::vector<AggregateRow> daily;
+
+    bool empty() const {
+        return realtime.empty() && blocks.empty() && hourly.empty() && daily.empty();
+    }
+};
+
+struct Stats {
+    size_t parsed = 0;
+    size_t parse_errors = 0;
+    size_t late = 0;            // 所属小时已封闭而丢弃
+    size_t already_imported = 0;  // 从检查点恢复时跳过的已写入数据
+    size_t realtime_rows = 0;
+    size_t block_rows = 0;
+    size_t blocks_skipped = 0;  // 已存在同一设备同一小时的块
+    size_t hourly_rows = 0;
+    size_t daily_rows = 0;
+};
+
+// ---------- 检查点 ----------
+
+// 文本格式：<文件序号> <字节偏移> <已封闭截止时间>
+struct Checkpoint {
+    size_t file_index = 0;
+    long long offset = 0;
+    time_t closed_until = 0;
+
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        return static_cast<bool>(in >> file_index >> offset >> closed_until);
+    }
+
+    bool save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            out << file_index << ' ' << offset << ' ' << closed_until << '\n';
+            if (!out.flush()) {
+                return false;
+            }
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
+
+class Importer {
+public:
+    explicit Importer(const Options& options)
+        : options_(options)
+        , pool_(options.db.host, options.db.user, options.db.password, options.db.database,
+                options.threads) {
+        time_t now = time(nullptr);
+        realtime_from_ = now - REALTIME_RETENTION_HOURS * HOUR_SECONDS;
+        realtime_from_ -= realtime_from_ % HOUR_SECONDS;
+    }
+
+    bool run() {
+        Checkpoint checkpoint;
+        if (checkpoint.load(options_.checkpoint)) {
+            std::cout << "[Import] Resuming from " << options_.checkpoint << ": file "
+                      << checkpoint.file_index << " offset " << checkpoint.offset << std::endl;
+            replay_until_ = checkpoint.closed_until;
+        }
+
+        started_ = std::chrono::steady_clock::now();
+        for (size_t i = checkpoint.file_index; i < options_.files.size(); ++i) {
+            if (!importFile(i, i == checkpoint.file_index ? checkpoint.offset : 0)) {
+                return false;
+            }
+        }
+
+        // 输入结束，封闭所有剩余的小时和天
+        if (!flush(NEVER, options_.files.size(), 0)) {
+            return false;
+        }
+        std::remove(options_.checkpoint.c_str());
+        report(true);
+        return true;
+    }
+
+private:
+    // 已读入、但其中可能仍有数据属于未封闭的天的一批输入
+    struct PendingBatch {
+        size_t file_index;
+        long long offset;
+        time_t max_timestamp;
+    };
+
+    bool importFile(size_t file_index, long long offset) {
+        const std::string& path = options_.files[file_index];
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "[Import] Cannot open " << path << std::endl;
+            return false;
+        }
+
+        Format format = Format::JSONL;
+        CsvColumns columns;
+        bool csv = options_.format == "csv" ||
+                   (options_.format == "auto" && path.size() >= 4 &&
+                    path.compare(path.size() - 4, 4, ".csv") == 0);
+        if (csv) {
+            format = Format::CSV;
+            std::string header;
+            if (!std::getline(file, header) || !columns.parse(header)) {
+                std::cerr << "[Import] " << path << ": CSV header must contain device_id and timestamp"
+                          << std::endl;
+                return false;
+            }
+        }
+        if (offset > 0) {
+            file.seekg(offset);
+        }
+        std::cout << "[Import] Reading " << path << std::endl;
+
+        while (file) {
+            // 读取一批分块，每块在行边界处截断，各块并行解析
+            long long batch_offset = file.tellg();
+            std::vector<std::string> chunks;
+            while (chunks.size() < options_.threads && file) {
+                std::string chunk(CHUNK_BYTES, '\0');
+                file.read(chunk.data(), CHUNK_BYTES);
+                chunk.resize(static_cast<size_t>(file.gcount()));
+                std::string rest;
+                if (file && std::getline(file, rest)) {
+                    chunk += rest;
+                    chunk += '\n';
+                }
+                if (!chunk.empty()) {
+                    chunks.push_back(std::move(chunk));
+                }
+            }
+            if (chunks.empty()) {
+                break;
+            }
+
+            std::vector<std::future<ParsedChunk>> parsed;
+            for (const auto& chunk : chunks) {
+                parsed.push_back(std::async(std::launch::async, parseChunk, std::cref(chunk),
+                                            format, std::cref(columns)));
+            }
+
+            time_t batch_max = 0;
+            for (auto& future : parsed) {
+                ParsedChunk result = future.get();
+                stats_.parse_errors += result.errors;
+                for (auto& row : result.rows) {
+                    batch_max = std::max<time_t>(batch_max, row.timestamp);
+                    accept(std::move(row));
+                }
+            }
+            pending_.push_back({file_index, batch_offset, batch_max});
+            max_timestamp_ = std::max(max_timestamp_, batch_max);
+
+            long long next_offset = file ? static_cast<long long>(file.tellg()) : -1;
+            if (!flush(max_timestamp_ - options_.lateness, file_index, next_offset)) {
+                return false;
+            }
+            report(false);
+        }
+        return true;
+    }
+
+    void accept(InputRow&& row) {
+        ++stats_.parsed;
+        time_t timestamp = static_cast<time_t>(row.timestamp);
+        time_t hour = timestamp - timestamp % HOUR_SECONDS;
+
+        if (hour + HOUR_SECONDS <= closed_until_) {
+            // 所属小时在本次运行中已封闭
+            ++(timestamp < replay_until_ ? stats_.already_imported : stats_.late);
+            return;
+        }
+        if (timestamp < replay_until_ && nextLocalMidnight(localDayStart(timestamp)) <= replay_until_) {
+            // 检查点之前已完整写入的天；其余检查点之前的数据只重新计入每日聚合
+            ++stats_.already_imported;
+            return;
+        }
+
+        HourBucket& bucket = hours_[hour][row.device_id];
+        bucket.area = row.area;
+        bucket.area_type = row.area_type;
+        Reading reading{row.timestamp, {}};
+        std::copy(std::begin(row.values), std::end(row.values), reading.values);
+        bucket.readings.push_back(reading);
+    }
+
+    // 封闭所有结束时间不晚于 limit 的小时和天并写入，成功后更新检查点
+    bool flush(time_t limit, size_t file_index, long long next_offset) {
+        WriteSet writes;
+        while (!hours_.empty() && hours_.begin()->first + HOUR_SECONDS <= limit) {
+            closeHour(hours_.begin()->first, hours_.begin()->second, writes);
+            hours_.erase(hours_.begin());
+        }
+        while (!days_.empty() && nextLocalMidnight(days_.begin()->first) <= limit) {
+            closeDay(days_.begin()->first, days_.begin()->second, writes);
+            days_.erase(days_.begin());
+        }
+        if (limit != NEVER && limit > 0) {
+            closed_until_ = std::max(closed_until_, limit - limit % HOUR_SECONDS);
+        }
+
+        if (!writes.empty() && !write(writes)) {
+            return false;
+        }
+
+        // 检查点指向仍含未封闭的天的数据的最早一批输入
+        time_t needed = NEVER;
+        if (!hours_.empty()) {
+            needed = localDayStart(hours_.begin()->first);
+        }
+        if (!days_.empty()) {
+            needed = std::min(needed, days_.begin()->first);
+        }
+        while (!pending_.empty() && pending_.front().max_timestamp < needed) {
+            pending_.pop_front();
+        }
+        if (limit == NEVER) {
+            return true;
+        }
+
+        Checkpoint checkpoint;
+        checkpoint.closed_until = std::max(replay_until_, closed_until_);
+        if (!pending_.empty()) {
+            checkpoint.file_index = pending_.front().file_index;
+            checkpoint.offset = pending_.front().offset;
+        } else if (next_offset >= 0) {
+            checkpoint.file_index = file_index;
+            checkpoint.offset = next_offset;
+        } else {
+            checkpoint.file_index = file_index + 1;
+        }
+        if (!checkpoint.save(options_.checkpoint)) {
+            std::cerr << "[Import] Cannot write checkpoint " << options_.checkpoint << std::endl;
+        }
+        return true;
+    }
+
+    void closeHour(time_t hour, std::unordered_map<std::string, HourBucket>& devices, WriteSet& writes) {
+        bool replay = hour < replay_until_;
+        GorillaEncoder encoder;
+        for (auto& [device_id, bucket] : devices) {
+            auto& readings = bucket.readings;
+            std::stable_sort(readings.begin(), readings.end(), [](const Reading& a, const Reading& b) {
+                return a.timestamp < b.timestamp;
+            });
+
+            AggregateRow row;
+            row.device_id = device_id;
+            row.bucket = hour;
+            row.area = bucket.area;
+            row.area_type = bucket.area_type;
+            row.samples_count = static_cast<int>(readings.size());
+            row.max_temperature = -std::numeric_limits<double>::infinity();
+            row.min_temperature = std::numeric_limits<double>::infinity();
+            std::fill(std::begin(row.averages), std::end(row.averages), 0.0);
+            ChannelSketches sketches;
+            for (const auto& reading : readings) {
+                for (int i = 0; i < 6; ++i) {
+                    row.averages[i] += reading.values[i];
+                    sketches.channels[i].add(reading.values[i]);
+                }
+                row.max_temperature = std::max(row.max_temperature, reading.values[0]);
+                row.min_temperature = std::min(row.min_temperature, reading.values[0]);
+            }
+            for (double& average : row.averages) {
+                average /= static_cast<double>(readings.size());
+            }
+
+            // 计入当天的每日聚合
+            DayAccumulator& day = days_[localDayStart(hour)][device_id];
+            day.area = bucket.area;
+            day.area_type = bucket.area_type;
+            for (int i = 0; i < 6; ++i) {
+                day.sum_of_hourly_avg[i] += row.averages[i];
+            }
+            ++day.hours;
+            day.max_temperature = std::max(day.max_temperature, row.max_temperature);
+            day.min_temperature = std::min(day.min_temperature, row.min_temperature);
+            day.samples += row.samples_count;
+            day.sketches.merge(sketches);
+
+            if (replay) {
+                continue;  // 原始数据和小时数据在检查点之前已写入
+            }
+
+            // 原始数据：实时表保留期内写入实时表，更早的编码为压缩块
+            if (hour >= realtime_from_) {
+                for (const auto& reading : readings) {
+                    RawRow raw{device_id, reading.timestamp, {}, bucket.area, bucket.area_type};
+                    std::copy(std::begin(reading.values), std::end(reading.values), raw.values);
+                    writes.realtime.push_back(std::move(raw));
+                }
+            } else {
+                for (const auto& reading : readings) {
+                    encoder.append(reading.timestamp, reading.values);
+                }
+                BlockRow block{device_id, hour, encoder.lastTimestamp(),
+                               static_cast<int>(encoder.count()), bucket.area, bucket.area_type, {}};
+                block.payload = encoder.finish();
+                writes.blocks.push_back(std::move(block));
+            }
+
+            row.sketches = sketches.serialize();
+            writes.hourly.push_back(std::move(row));
+        }
+    }
+
+    void closeDay(time_t day_start, std::unordered_map<std::string, DayAccumulator>& devices,
+                  WriteSet& writes) {
+        for (auto& [device_id, day] : devices) {
+            AggregateRow row;
+            row.device_id = device_id;
+            row.bucket = day_start;
+            for (int i = 0; i < 6; ++i) {
+                row.averages[i] = day.sum_of_hourly_avg[i] / day.hours;
+            }
+            row.max_temperature = day.max_temperature;
+            row.min_temperature = day.min_temperature;
+            row.samples_count = day.samples;
+            row.area = day.area;
+            row.area_type = day.area_type;
+            row.sketches = day.sketches.serialize();
+            writes.daily.push_back(std::move(row));
+        }
+    }
+
+    // 压缩块和聚合行按连接数切片，每个切片在自己的连接上用一个事务写入，重复写入是幂等的。
+    // 实时表没有唯一键，其原始数据在所有切片成功后再用单独一个事务写入，
+    // 失败的一批重新运行时不会留下部分已提交的原始数据
+    bool write(WriteSet& writes) {
+        size_t slices = options_.threads;
+        std::vector<std::future<bool>> futures;
+        std::vector<Stats> slice_stats(slices);
+        for (size_t slice = 0; slice < slices; ++slice) {
+            futures.push_back(std::async(std::launch::async, [this, &writes, &slice_stats, slice, slices]() {
+                auto pick = [slice, slices](auto& rows) {
+                    std::vector<std::remove_reference_t<decltype(rows[0])>*> result;
+                    for (size_t i = slice; i < rows.size(); i += slices) {
+                        result.push_back(&rows[i]);
+                    }
+                    return result;
+                };
+                auto blocks = pick(writes.blocks);
+                auto hourly = pick(writes.hourly);
+                auto daily = pick(writes.daily);
+                if (blocks.empty() && hourly.empty() && daily.empty()) {
+                    return true;
+                }
+
+                Stats& stats = slice_stats[slice];
+                size_t inserted_blocks = 0;
+                auto conn = pool_.acquire();
+                if (!conn || !conn->query("START TRANSACTION")) {
+                    return false;
+                }
+                bool ok = insertRows(*conn, INSERT_BLOCK_PREFIX, BLOCK_VALUES, blocks, inserted_blocks) &&
+                          insertRows(*conn, INSERT_HOURLY_PREFIX, AGGREGATE_VALUES, hourly, stats.hourly_rows, AGGREGATE_UPSERT) &&
+                          insertRows(*conn, INSERT_DAILY_PREFIX, AGGREGATE_VALUES, daily, stats.daily_rows, AGGREGATE_UPSERT);
+                if (!ok) {
+                    conn->query("ROLLBACK");
+                    return false;
+                }
+                stats.block_rows = inserted_blocks;
+                stats.blocks_skipped = blocks.size() - inserted_blocks;
+                return conn->query("COMMIT");
+            }));
+        }
+
+        bool ok = true;
+        for (auto& future : futures) {
+            ok = future.get() && ok;
+        }
+        if (ok && !writes.realtime.empty()) {
+            ok = writeRealtime(writes.realtime);
+        }
+        if (!ok) {
+            std::cerr << "[Import] Write failed, rerun to resume from " << options_.checkpoint << std::endl;
+            return false;
+        }
+        for (const auto& stats : slice_stats) {
+            stats_.block_rows += stats.block_rows;
+            stats_.blocks_skipped += stats.blocks_skipped;
+            stats_.hourly_rows += stats.hourly_rows;
+            stats_.daily_rows += stats.daily_rows;
+        }
+        return true;
+    }
+
+    // 原始数据只覆盖实时表保留期内的一天，单个连接写入
+    bool writeRealtime(std::vector<RawRow>& realtime) {
+        std::vector<RawRow*> rows;
+        rows.reserve(realtime.size());
+        for (auto& row : realtime) {
+            rows.push_back(&row);
+        }
+
+        size_t inserted = 0;
+        auto conn = pool_.acquire();
+        if (!conn || !conn->query("START TRANSACTION")) {
+            return false;
+        }
+        if (!insertRows(*conn, INSERT_REALTIME_PREFIX, REALTIME_VALUES, rows, inserted)) {
+            conn->query("ROLLBACK");
+            return false;
+        }
+        if (!conn->query("COMMIT")) {
+            return false;
+        }
+        stats_.realtime_rows += inserted;
+        return true;
+    }
+
+    void report(bool final) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+        double rate = seconds > 0 ? stats_.parsed / seconds : 0;
+        std::cout << (final ? "[Import] Done: " : "[Import] ") << stats_.parsed << " rows in "
+                  << static_cast<long long>(seconds) << "s (" << static_cast<long long>(rate)
+                  << " rows/s), realtime " << stats_.realtime_rows << ", blocks " << stats_.block_rows
+                  << ", hourly " << stats_.hourly_rows << ", daily " << stats_.daily_rows;
+        if (stats_.parse_errors || stats_.late || stats_.already_imported || stats_.blocks_skipped) {
+            std::cout << ", errors " << stats_.parse_errors << ", late " << stats_.late
+                      << ", already imported " << stats_.already_imported
+                      << ", existing blocks kept " << stats_.blocks_skipped;
+        }
+        std::cout << std::endl;
+    }
+
+    Options options_;
+    ConnectionPool pool_;
+    Stats stats_;
+    std::chrono::steady_clock::time_point started_;
+
+    time_t realtime_from_;             // 此时间之后的原始数据写入实时表
+    time_t replay_until_ = 0;          // 检查点之前已写入原始和小时数据的截止时间
+    time_t closed_until_ = 0;          // 本次运行中此时间之前的小时已封闭
+    time_t max_timestamp_ = 0;
+
+    std::map<time_t, std::unordered_map<std::string, HourBucket>> hours_;
+    std::map<time_t, std::unordered_map<std::string, DayAccumulator>> days_;
+    std::deque<PendingBatch> pending_;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <file>...\n"
+              << "  Files ending in .csv are read as CSV with a header row, others as JSON lines.\n"
+              << "  Columns/keys: device_id, timestamp, temperature, humidity, co2, pm25, noise,\n"
+              << "  light, area, area_type\n"
+              << "Options:\n"
+              << "  --host <host>          MySQL host (default localhost)\n"
+              << "  --user <user>          MySQL user (default monitor)\n"
+              << "  --password <password>  MySQL password\n"
+              << "  --database <name>      database (default evm_db)\n"
+              << "  --threads <n>          parser threads and connections (default: CPU count)\n"
+              << "  --lateness <seconds>   how long an hour stays open for out-of-order rows (default 3600)\n"
+              << "  --format <auto|jsonl|csv>\n"
+              << "  --checkpoint <path>    resume file (default bulk_import.checkpoint)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--host") {
+            options.db.host = value();
+        } else if (arg == "--user") {
+            options.db.user = value();
+        } else if (arg == "--password") {
+            options.db.password = value();
+        } else if (arg == "--database") {
+            options.db.database = value();
+        } else if (arg == "--threads") {
+            options.threads = std::max(1, std::stoi(value()));
+        } else if (arg == "--lateness") {
+            options.lateness = std::stoll(value());
+        } else if (arg == "--format") {
+            options.format = value();
+        } else if (arg == "--checkpoint") {
+            options.checkpoint = value();
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+    if (options.files.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        Importer importer(options);
+        return importer.run() ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "[Import] " << e.what() << std::endl;
+        return 1;
+    }
+}
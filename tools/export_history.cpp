@@ -0,0 +1,133 @@
+// 历史数据批量导出工具
+//
+// 直接使用存储后端的非缓冲游标按时间顺序读取一组设备的数据，逐块编码后写出，
+// 内存占用与导出范围无关。输出 CSV 或列式 EVMC 格式（格式说明见 src/network/export_stream.h）。
+// 数据库连接参数与 monitor 相同，EVM_STORAGE=embedded 时读取嵌入式存储。
+// 存储以只读方式打开，不会对旧库执行 monitor 启动时的分区和唯一键迁移。
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/database/storage.h"
+#include "../src/network/export_stream.h"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " --ids <id,id,...> [options]\n"
+              << "Options:\n"
+              << "  --start <unix>        range start (default: 24 hours ago)\n"
+              << "  --end <unix>          range end (default: now)\n"
+              << "  --type <realtime|hourly|daily>  data tier (default realtime)\n"
+              << "  --format <csv|evmc>   output format (default csv)\n"
+              << "  --output <path>       output file (default stdout)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> device_ids;
+    time_t end_time = time(nullptr);
+    time_t start_time = end_time - 24 * 3600;
+    std::string type = "realtime";
+    std::string format = "csv";
+    std::string output;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--ids") {
+            std::istringstream ids(value);
+            std::string id;
+            while (std::getline(ids, id, ',')) {
+                if (!id.empty()) {
+                    device_ids.push_back(id);
+                }
+            }
+        } else if (arg == "--start") {
+            start_time = std::stoll(value);
+        } else if (arg == "--end") {
+            end_time = std::stoll(value);
+        } else if (arg == "--type") {
+            type = value;
+        } else if (arg == "--format") {
+            format = value;
+        } else if (arg == "--output") {
+            output = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    DataTier tier;
+    if (type == "realtime") {
+        tier = DataTier::REALTIME;
+    } else if (type == "hourly") {
+        tier = DataTier::HOURLY;
+    } else if (type == "daily") {
+        tier = DataTier::DAILY;
+    } else {
+        std::cerr << "[Export] Unknown type: " << type << std::endl;
+        return 1;
+    }
+    if (device_ids.empty() || (format != "csv" && format != "evmc")) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "[Export] Cannot open " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output.empty() ? std::cout : file;
+
+    try {
+        auto started = std::chrono::steady_clock::now();
+        // 只读打开，不在线上库执行建表和结构迁移
+        Storage::setReadOnly();
+        auto cursor = Storage::getInstance().openDevicesCursor(tier, device_ids, start_time, end_time);
+        std::unique_ptr<ChunkWriter> writer;
+        if (format == "evmc") {
+            writer = std::make_unique<ColumnChunkWriter>(std::move(cursor));
+        } else {
+            writer = std::make_unique<CsvChunkWriter>(std::move(cursor));
+        }
+
+        std::string chunk;
+        size_t bytes = 0;
+        while (writer->nextChunk(chunk)) {
+            out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            bytes += chunk.size();
+        }
+        out.flush();
+        bool failed = !out || writer->failed();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::cerr << "[Export] " << writer->rowCount() << " rows, " << bytes << " bytes in "
+                  << seconds << "s (" << static_cast<long long>(seconds > 0 ? writer->rowCount() / seconds : 0)
+                  << " rows/s)" << std::endl;
+        return failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "[Export] " << e.what() << std::endl;
+        return 1;
+    }
+}
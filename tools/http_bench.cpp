@@ -0,0 +1,249 @@
+// HTTP 查询吞吐量测试工具
+//
+// 打开若干条 keep-alive 连接，每条连接循环发送 GET 请求（多个 --path 轮流使用），
+// 在指定时长内统计完成的请求数、吞吐量和延迟分位数。
+// 测试服务端线程扩展性时，用不同的 EVM_HTTP_THREADS 启动 monitor，
+// 以足够多的连接（远大于服务端线程数）分别运行本工具，比较各次的 req/s：
+//   EVM_HTTP_THREADS=4 ./monitor
+//   ./http_bench --connections 64 --duration 10 --path "/api/device/dev1/history?type=hourly"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::vector<std::string> paths;
+    size_t connections = 16;
+    size_t threads = 1;
+    int duration = 10;
+};
+
+// 所有连接共享的统计，延迟按线程分别收集后合并
+struct Results {
+    std::atomic<size_t> requests{0};
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> bytes{0};
+    std::mutex mutex;
+    std::vector<double> latencies_ms;
+};
+
+// 一条 keep-alive 连接：写请求、读响应，直到测试结束
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+    Connection(net::io_context& ioc, const Options& options, const tcp::resolver::results_type& endpoints,
+               Results& results, Clock::time_point deadline, size_t index)
+        : stream_(net::make_strand(ioc))
+        , options_(options)
+        , endpoints_(endpoints)
+        , results_(results)
+        , deadline_(deadline)
+        , next_path_(index) {
+    }
+
+    ~Connection() {
+        std::lock_guard<std::mutex> lock(results_.mutex);
+        results_.latencies_ms.insert(results_.latencies_ms.end(), latencies_.begin(), latencies_.end());
+    }
+
+    void start() {
+        stream_.async_connect(endpoints_,
+            [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&) {
+                if (ec) {
+                    std::cerr << "[Bench] Connect error: " << ec.message() << std::endl;
+                    ++self->results_.errors;
+                    return;
+                }
+                self->sendRequest();
+            });
+    }
+
+private:
+    void sendRequest() {
+        if (Clock::now() >= deadline_) {
+            beast::error_code ec;
+            stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+            return;
+        }
+
+        request_ = {};
+        request_.method(http::verb::get);
+        request_.target(options_.paths[next_path_++ % options_.paths.size()]);
+        request_.version(11);
+        request_.set(http::field::host, options_.host);
+        request_.keep_alive(true);
+
+        started_ = Clock::now();
+        http::async_write(stream_, request_,
+            [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                if (ec) {
+                    self->fail(ec);
+                    return;
+                }
+                self->response_ = {};
+                http::async_read(self->stream_, self->buffer_, self->response_,
+                    [self](beast::error_code ec, std::size_t bytes) {
+                        self->onResponse(ec, bytes);
+                    });
+            });
+    }
+
+    void onResponse(beast::error_code ec, std::size_t bytes) {
+        if (ec) {
+            fail(ec);
+            return;
+        }
+        if (response_.result() != http::status::ok) {
+            ++results_.errors;
+        } else {
+            ++results_.requests;
+            results_.bytes += bytes;
+            latencies_.push_back(std::chrono::duration<double, std::milli>(Clock::now() - started_).count());
+        }
+
+        // 服务端达到单连接请求上限时会关闭连接，重新连接后继续
+        if (!response_.keep_alive()) {
+            stream_.close();
+            start();
+            return;
+        }
+        sendRequest();
+    }
+
+    void fail(beast::error_code ec) {
+        ++results_.errors;
+        if (Clock::now() < deadline_) {
+            std::cerr << "[Bench] " << ec.message() << ", reconnecting" << std::endl;
+            stream_.close();
+            buffer_.clear();
+            start();
+        }
+    }
+
+    beast::tcp_stream stream_;
+    const Options& options_;
+    const tcp::resolver::results_type& endpoints_;
+    Results& results_;
+    Clock::time_point deadline_;
+    size_t next_path_;
+
+    beast::flat_buffer buffer_;
+    http::request<http::empty_body> request_;
+    http::response<http::string_body> response_;
+    Clock::time_point started_;
+    std::vector<double> latencies_;
+};
+
+double percentile(std::vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()));
+    return sorted[index];
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --host <host>         server host (default 127.0.0.1)\n"
+              << "  --port <port>         server port (default 8080)\n"
+              << "  --path <target>       request target, repeatable (default /api/devices)\n"
+              << "  --connections <n>     concurrent keep-alive connections (default 16)\n"
+              << "  --threads <n>         client I/O threads (default 1)\n"
+              << "  --duration <seconds>  test duration (default 10)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--host") {
+            options.host = value;
+        } else if (arg == "--port") {
+            options.port = value;
+        } else if (arg == "--path") {
+            options.paths.push_back(value);
+        } else if (arg == "--connections") {
+            options.connections = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--threads") {
+            options.threads = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--duration") {
+            options.duration = std::max(1, std::atoi(value.c_str()));
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.paths.empty()) {
+        options.paths.push_back("/api/devices");
+    }
+
+    net::io_context ioc;
+    tcp::resolver resolver(ioc);
+    beast::error_code ec;
+    auto endpoints = resolver.resolve(options.host, options.port, ec);
+    if (ec) {
+        std::cerr << "[Bench] Cannot resolve " << options.host << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    Results results;
+    auto started = Clock::now();
+    auto deadline = started + std::chrono::seconds(options.duration);
+    for (size_t i = 0; i < options.connections; ++i) {
+        std::make_shared<Connection>(ioc, options, endpoints, results, deadline, i)->start();
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < options.threads; ++i) {
+        threads.emplace_back([&ioc]() { ioc.run(); });
+    }
+    ioc.run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+    std::sort(results.latencies_ms.begin(), results.latencies_ms.end());
+    std::cout << std::fixed << std::setprecision(2)
+              << "connections " << options.connections << ", " << elapsed << " s\n"
+              << "requests    " << results.requests << " (" << results.requests / elapsed << " req/s), "
+              << "errors " << results.errors << "\n"
+              << "throughput  " << results.bytes / elapsed / (1 << 20) << " MB/s\n"
+              << "latency ms  p50 " << percentile(results.latencies_ms, 0.5)
+              << "  p90 " << percentile(results.latencies_ms, 0.9)
+              << "  p99 " << percentile(results.latencies_ms, 0.99)
+              << "  max " << (results.latencies_ms.empty() ? 0 : results.latencies_ms.back()) << std::endl;
+    return results.requests > 0 ? 0 : 1;
+}
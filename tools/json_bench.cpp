@@ -0,0 +1,270 @@
+// 实时数据 JSON 序列化基准测试
+//
+// 生成若干台设备的最新读数，按 /api/data/realtime 的响应格式分别用三种方式序列化，
+// 比较每次序列化的耗时、吞吐量和堆分配次数：
+//   dom        构建 Json::Value 树后用 Json::FastWriter 输出（原先每个请求的做法）
+//   writer     用 JsonWriter 直接追加到复用的缓冲区
+//   fragments  拼接入库时生成的 DeviceFragments（服务端快照重建的做法）
+// 开始前会解析三种输出并比较，确认内容一致。
+//   ./json_bench --devices 1000 --iterations 200
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <jsoncpp/json/json.h>
+#include "../src/device/device_fragments.h"
+#include "../src/models/sensor_data.h"
+#include "../src/utils/json_writer.h"
+
+namespace {
+
+std::atomic<size_t> g_allocations{0};
+
+} // namespace
+
+// 统计堆分配次数。delete 不允许内联，否则 GCC 会误报 new 与 free 不匹配
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Device {
+    SensorData data;
+    std::shared_ptr<const DeviceFragments> fragments;
+    bool online;
+};
+
+std::vector<Device> makeDevices(size_t count) {
+    static const char* AREAS[] = {"教学楼A", "宿舍区", "图书馆", "体育馆"};
+    static const char* STATUS[] = {"适宜", "偏热", "正常", "优", "安静", "偏暗"};
+    std::vector<Device> devices(count);
+    for (size_t i = 0; i < count; ++i) {
+        SensorData& d = devices[i].data;
+        d.device_id = "device-" + std::to_string(i);
+        d.timestamp = 1760000000 + static_cast<time_t>(i);
+        d.area = AREAS[i % 4];
+        d.area_type = static_cast<AreaType>(i % 3);
+        d.temperature = 18 + (i % 97) * 0.137;
+        d.humidity = 30 + (i % 53) * 0.71;
+        d.co2 = 400 + (i % 211) * 7.3;
+        d.pm25 = (i % 89) * 1.9;
+        d.noise = 30 + (i % 41) * 0.93;
+        d.light = 100 + (i % 131) * 11.7;
+        d.scores = {92.5, 88.0, 75.0, 100.0, 96.25, 81.0, 89.37};
+        d.status = {STATUS[i % 6], STATUS[(i + 1) % 6], STATUS[(i + 2) % 6],
+                    STATUS[(i + 3) % 6], STATUS[(i + 4) % 6], STATUS[(i + 5) % 6]};
+        d.suggestions = {"CO2浓度偏高，建议开窗通风15-20分钟",
+                         "空气偏干燥，建议使用加湿器提高湿度至40-60%"};
+        devices[i].fragments = DeviceFragments::build(d);
+        devices[i].online = i % 5 != 0;
+    }
+    return devices;
+}
+
+void serializeDom(const std::vector<Device>& devices, std::string& out) {
+    Json::Value root;
+    root["data"] = Json::Value(Json::arrayValue);
+    for (const auto& device : devices) {
+        const SensorData& d = device.data;
+        Json::Value item;
+        item["device_id"] = d.device_id;
+        item["area"] = d.area;
+        item["area_type"] = static_cast<int>(d.area_type);
+        item["device_status"] = device.online ? 1 : 0;
+        item["temperature"] = d.temperature;
+        item["humidity"] = d.humidity;
+        item["co2"] = d.co2;
+        item["pm25"] = d.pm25;
+        item["noise"] = d.noise;
+        item["light"] = d.light;
+        item["timestamp"] = static_cast<Json::Int64>(d.timestamp);
+        item["scores"]["temperature"] = d.scores.temperature;
+        item["scores"]["humidity"] = d.scores.humidity;
+        item["scores"]["co2"] = d.scores.co2;
+        item["scores"]["pm25"] = d.scores.pm25;
+        item["scores"]["noise"] = d.scores.noise;
+        item["scores"]["light"] = d.scores.light;
+        item["scores"]["overall"] = d.scores.overall;
+        item["status"]["temperature"] = d.status.temperature;
+        item["status"]["humidity"] = d.status.humidity;
+        item["status"]["co2"] = d.status.co2;
+        item["status"]["pm25"] = d.status.pm25;
+        item["status"]["noise"] = d.status.noise;
+        item["status"]["light"] = d.status.light;
+        Json::Value suggestions(Json::arrayValue);
+        for (const auto& suggestion : d.suggestions) {
+            suggestions.append(suggestion);
+        }
+        item["suggestions"] = suggestions;
+        root["data"].append(item);
+    }
+    Json::FastWriter writer;
+    out = writer.write(root);
+}
+
+void serializeWriter(const std::vector<Device>& devices, std::string& out) {
+    out.clear();
+    JsonWriter json(out);
+    json.beginObject().key("data").beginArray();
+    for (const auto& device : devices) {
+        const SensorData& d = device.data;
+        json.beginObject()
+            .member("device_id", d.device_id)
+            .member("area", d.area)
+            .member("area_type", static_cast<int>(d.area_type))
+            .member("device_status", device.online ? 1 : 0)
+            .member("temperature", d.temperature)
+            .member("humidity", d.humidity)
+            .member("co2", d.co2)
+            .member("pm25", d.pm25)
+            .member("noise", d.noise)
+            .member("light", d.light)
+            .member("timestamp", static_cast<long long>(d.timestamp));
+        json.key("scores").beginObject()
+            .member("temperature", d.scores.temperature)
+            .member("humidity", d.scores.humidity)
+            .member("co2", d.scores.co2)
+            .member("pm25", d.scores.pm25)
+            .member("noise", d.scores.noise)
+            .member("light", d.scores.light)
+            .member("overall", d.scores.overall)
+            .endObject();
+        json.key("status").beginObject()
+            .member("temperature", d.status.temperature)
+            .member("humidity", d.status.humidity)
+            .member("co2", d.status.co2)
+            .member("pm25", d.status.pm25)
+            .member("noise", d.status.noise)
+            .member("light", d.status.light)
+            .endObject();
+        json.key("suggestions").beginArray();
+        for (const auto& suggestion : d.suggestions) {
+            json.value(suggestion);
+        }
+        json.endArray().endObject();
+    }
+    json.endArray().endObject();
+    out += '\n';
+}
+
+void serializeFragments(const std::vector<Device>& devices, std::string& out) {
+    out = "{\"data\":[";
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += devices[i].fragments->full;
+        out += devices[i].online ? "1}" : "0}";
+    }
+    out += "]}\n";
+}
+
+// 数字按数值比较：FastWriter 把整数值的浮点数写成 600.0，JsonWriter 写成 600
+bool equalJson(const Json::Value& a, const Json::Value& b) {
+    if (a.isNumeric() && b.isNumeric()) {
+        return a.asDouble() == b.asDouble();
+    }
+    if (a.type() != b.type() || a.size() != b.size()) {
+        return false;
+    }
+    if (a.isArray()) {
+        for (Json::ArrayIndex i = 0; i < a.size(); ++i) {
+            if (!equalJson(a[i], b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (a.isObject()) {
+        for (const auto& name : a.getMemberNames()) {
+            if (!b.isMember(name) || !equalJson(a[name], b[name])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return a == b;
+}
+
+bool sameContent(const std::string& a, const std::string& b) {
+    Json::Reader reader;
+    Json::Value left, right;
+    return reader.parse(a, left) && reader.parse(b, right) && equalJson(left, right);
+}
+
+void run(const char* name, void (*serialize)(const std::vector<Device>&, std::string&),
+         const std::vector<Device>& devices, size_t iterations) {
+    std::string out;
+    serialize(devices, out);  // 预热，使复用的缓冲区达到所需容量
+
+    size_t allocations = g_allocations.load();
+    auto started = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        serialize(devices, out);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    allocations = g_allocations.load() - allocations;
+
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << seconds / iterations * 1e6 << " us/op"
+              << std::setw(10) << out.size() * iterations / seconds / (1 << 20) << " MB/s"
+              << std::setw(12) << allocations / iterations << " allocs/op"
+              << std::setw(10) << out.size() << " bytes" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t device_count = 1000;
+    size_t iterations = 200;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--devices") {
+            device_count = std::max(1ul, std::strtoul(argv[i + 1], nullptr, 10));
+        } else if (arg == "--iterations") {
+            iterations = std::max(1ul, std::strtoul(argv[i + 1], nullptr, 10));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--devices N] [--iterations N]" << std::endl;
+            return 1;
+        }
+    }
+
+    auto devices = makeDevices(device_count);
+
+    std::string dom, writer, fragments;
+    serializeDom(devices, dom);
+    serializeWriter(devices, writer);
+    serializeFragments(devices, fragments);
+    if (!sameContent(dom, writer) || !sameContent(dom, fragments)) {
+        std::cerr << "[Bench] Serialized outputs differ" << std::endl;
+        return 1;
+    }
+
+    std::cout << device_count << " devices, " << iterations << " iterations" << std::endl;
+    run("dom", serializeDom, devices, iterations);
+    run("writer", serializeWriter, devices, iterations);
+    run("fragments", serializeFragments, devices, iterations);
+    return 0;
+}